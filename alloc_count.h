@@ -0,0 +1,8 @@
+#ifndef ALLOC_COUNT_H
+#define ALLOC_COUNT_H
+
+// Counts heap allocations made anywhere in the process, SDL included.
+// Linked into the bench, and into the game when built with PROFILE=1; both interpose malloc (glibc).
+unsigned long alloc_count(void);
+
+#endif
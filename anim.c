@@ -0,0 +1,166 @@
+#include "anim.h"
+#include "log.h"
+#include "pack.h"
+#include "loader.h"
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int find_clip(const anim_library *lib, const char *name) {
+    for (int i = 0; i < lib->clip_count; i++) {
+        if (strcmp(lib->clips[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static int add_frame(anim_clip *c, int x, int y, int w, int h, int ms) {
+    if (c->frame_count == MAX_CLIP_FRAMES) return -1;
+    SDL_Rect r = {x, y, w, h};
+    c->frames[c->frame_count] = r;
+    c->durations[c->frame_count] = ms > 0 ? ms : 1;
+    c->events[c->frame_count] = 0;
+    memset(&c->hitboxes[c->frame_count], 0, sizeof(SDL_Rect));
+    c->frame_count++;
+    return 0;
+}
+
+anim_library *load_anim_library(const char *path) {
+    FILE *f = open_asset_file(path);
+    if (!f) {
+        LOG_ERROR(LOG_ANIM, "Failed to open animation file %s\n", path);
+        return NULL;
+    }
+
+    anim_library *lib = calloc(1, sizeof(anim_library));
+    if (!lib) {
+        fclose(f);
+        return NULL;
+    }
+
+    // Names of each clip's follow-up, resolved once every clip is known
+    char next_names[MAX_CLIPS][16];
+    char line[256];
+    int line_number = 0;
+    int bad_line = 0;
+    int ok = 1;
+    anim_clip *c = NULL;
+
+    while (ok && fgets(line, sizeof(line), f)) {
+        line_number++;
+        char word[16], sheet[64], mode[16], next[16], event[16];
+        int n, x, y, w, h, ms, frame;
+
+        if (line[0] == '#' || sscanf(line, "%15s", word) != 1) continue;
+
+        if (strcmp(word, "clip") == 0) {
+            int fields = sscanf(line, "clip %15s %63s %15s %15s", word, sheet, mode, next);
+            if (fields < 3 || lib->clip_count == MAX_CLIPS) {
+                ok = 0;
+                break;
+            }
+            c = &lib->clips[lib->clip_count];
+            strcpy(c->name, word);
+            strcpy(next_names[lib->clip_count], fields == 4 ? next : "");
+            c->loop = strcmp(mode, "loop") == 0;
+            // Clips listed first are drawn first, so their sheets load first
+            c->sheet = request_asset(sheet, LOAD_PRIORITY_NORMAL + MAX_CLIPS - lib->clip_count);
+            lib->clip_count++;
+            if (!c->sheet) ok = 0;
+        } else if (!c) {
+            ok = 0;
+        } else if (strcmp(word, "strip") == 0 && sscanf(line, "strip %d %d %d %d", &n, &w, &h, &ms) == 4) {
+            for (int i = 0; i < n && ok; i++) {
+                ok = add_frame(c, i * w, 0, w, h, ms) == 0;
+            }
+        } else if (strcmp(word, "frame") == 0 && sscanf(line, "frame %d %d %d %d %d", &x, &y, &w, &h, &ms) == 5) {
+            ok = add_frame(c, x, y, w, h, ms) == 0;
+        } else if (strcmp(word, "event") == 0 && sscanf(line, "event %d %15s", &frame, event) == 2 &&
+                   frame >= 0 && frame < c->frame_count && strcmp(event, "hit") == 0) {
+            c->events[frame] |= ANIM_EVENT_HIT;
+        } else if (strcmp(word, "hurtbox") == 0 && sscanf(line, "hurtbox %d %d %d %d", &x, &y, &w, &h) == 4 &&
+                   w > 0 && h > 0 && w <= MAX_BOX_SIZE && h <= MAX_BOX_SIZE) {
+            SDL_Rect box = {x, y, w, h};
+            c->hurtbox = box;
+        } else if (strcmp(word, "hitbox") == 0 && sscanf(line, "hitbox %d %d %d %d %d", &frame, &x, &y, &w, &h) == 5 &&
+                   frame >= 0 && frame < c->frame_count && w > 0 && h > 0 && w <= MAX_BOX_SIZE && h <= MAX_BOX_SIZE) {
+            SDL_Rect box = {x, y, w, h};
+            c->hitboxes[frame] = box;
+        } else {
+            ok = 0;
+        }
+    }
+    fclose(f);
+    if (!ok) {
+        bad_line = line_number;
+    }
+
+    for (int i = 0; ok && i < lib->clip_count; i++) {
+        anim_clip *clip = &lib->clips[i];
+        clip->next = next_names[i][0] ? find_clip(lib, next_names[i]) : -1;
+        if (clip->frame_count == 0 || (next_names[i][0] && clip->next < 0)) {
+            LOG_ERROR(LOG_ANIM, "%s: clip %s has no frames or an unknown next clip\n", path, clip->name);
+            ok = 0;
+            break;
+        }
+        for (int j = 0; ok && j < clip->frame_count; j++) {
+            int index = add_asset_frame(clip->sheet, &clip->frames[j]);
+            clip->sheet_frames[j] = (Uint8)index;
+            ok = index >= 0;
+        }
+    }
+
+    if (!ok) {
+        if (bad_line) {
+            LOG_ERROR(LOG_ANIM, "%s:%d: invalid animation line\n", path, bad_line);
+        }
+        free_anim_library(lib);
+        return NULL;
+    }
+    LOG_INFO(LOG_ANIM, "Animation clips loaded: %s (%d clips)\n", path, lib->clip_count);
+    return lib;
+}
+
+void free_anim_library(anim_library *lib) {
+    if (!lib) return;
+    for (int i = 0; i < lib->clip_count; i++) {
+        release_asset(lib->clips[i].sheet);
+    }
+    free(lib);
+}
+
+void play_clip(anim_state *a, int clip) {
+    a->clip = (Uint8)clip;
+    a->frame = 0;
+    a->finished = 0;
+    a->time = 0;
+}
+
+Uint8 advance_anim(const anim_library *lib, anim_state *a, float dt_ms) {
+    if (a->finished) return 0;
+
+    Uint8 events = 0;
+    a->time += dt_ms;
+    // Late frames just run the loop more than once, so playback keeps real-time pace
+    for (;;) {
+        const anim_clip *c = &lib->clips[a->clip];
+        if (a->time < c->durations[a->frame]) break;
+        a->time -= c->durations[a->frame];
+
+        if (a->frame + 1 < c->frame_count) {
+            a->frame++;
+        } else if (c->loop) {
+            a->frame = 0;
+        } else if (c->next >= 0) {
+            a->clip = (Uint8)c->next;
+            a->frame = 0;
+            events |= ANIM_EVENT_END;
+        } else {
+            a->finished = 1;
+            a->time = 0;
+            return events | ANIM_EVENT_END;
+        }
+        events |= lib->clips[a->clip].events[a->frame];
+    }
+    return events;
+}
@@ -0,0 +1,56 @@
+#ifndef ANIM_H
+#define ANIM_H
+
+#include <SDL/SDL.h>
+#include "assets.h"
+
+#define MAX_CLIPS 16
+#define MAX_CLIP_FRAMES 32
+#define MAX_BOX_SIZE 128 // Hit and hurt boxes, so the combat grid can use cells this size
+
+// Events raised when a frame starts (anim_clip.events) or a clip runs out
+#define ANIM_EVENT_HIT 0x01
+#define ANIM_EVENT_END 0x80
+
+typedef struct {
+    char name[16];
+    sprite_asset* sheet;
+    int frame_count;
+    SDL_Rect frames[MAX_CLIP_FRAMES];   // Source rects in sheet->surface
+    Uint8 sheet_frames[MAX_CLIP_FRAMES]; // Same frames as indices into sheet->frames
+    Uint16 durations[MAX_CLIP_FRAMES];  // ms
+    Uint8 events[MAX_CLIP_FRAMES];
+    SDL_Rect hurtbox;                   // Frame-relative, facing right; w=0: can't be hit
+    SDL_Rect hitboxes[MAX_CLIP_FRAMES]; // Where each frame strikes, same space; w=0: it doesn't
+    int loop;
+    int next; // Clip to play after a one-shot, -1 to hold the last frame
+} anim_clip;
+
+typedef struct {
+    int clip_count;
+    anim_clip clips[MAX_CLIPS];
+} anim_library;
+
+// Playback position of one character
+typedef struct {
+    Uint8 clip;
+    Uint8 frame;
+    Uint8 finished; // One-shot with no next clip reached its end
+    float time;     // ms spent in the current frame
+} anim_state;
+
+anim_library* load_anim_library(const char* path); // NULL on error
+void free_anim_library(anim_library* lib);
+int find_clip(const anim_library* lib, const char* name);
+void play_clip(anim_state* a, int clip);
+Uint8 advance_anim(const anim_library* lib, anim_state* a, float dt_ms); // Returns ANIM_EVENT_* bits
+
+static inline const SDL_Rect* anim_rect(const anim_library* lib, const anim_state* a) {
+    return &lib->clips[a->clip].frames[a->frame];
+}
+
+static inline int anim_sheet_frame(const anim_library* lib, const anim_state* a) {
+    return lib->clips[a->clip].sheet_frames[a->frame];
+}
+
+#endif
@@ -0,0 +1,267 @@
+#include "assets.h"
+#include "log.h"
+#include "perso.h"
+#include "blit.h"
+#include "pack.h"
+#include "loader.h"
+#include <SDL/SDL.h>
+#include <SDL/SDL_image.h>
+#include <stdio.h>
+#include <string.h>
+
+static sprite_asset assets[MAX_ASSETS];
+static SDL_Surface *render_target; // Where sheets are drawn; the video surface when unset
+
+static SDL_Surface *creer_miroir(SDL_Surface *src) {
+    SDL_Surface *mirror = SDL_CreateRGBSurface(src->flags, src->w, src->h, src->format->BitsPerPixel,
+                                               src->format->Rmask, src->format->Gmask,
+                                               src->format->Bmask, src->format->Amask);
+    if (!mirror) {
+        LOG_ERROR(LOG_CORE, "Error creating mirrored surface: %s\n", SDL_GetError());
+        return NULL;
+    }
+    if (src->flags & SDL_SRCCOLORKEY) {
+        SDL_SetColorKey(mirror, SDL_SRCCOLORKEY, src->format->colorkey);
+    }
+    if (src->format->Amask) {
+        SDL_SetAlpha(mirror, SDL_SRCALPHA, 255);
+    }
+
+    SDL_LockSurface(src);
+    SDL_LockSurface(mirror);
+    if (src->format->BytesPerPixel == 4) {
+        for (int y = 0; y < src->h; y++) {
+            Uint32 *in = (Uint32 *)((Uint8 *)src->pixels + y * src->pitch);
+            Uint32 *out = (Uint32 *)((Uint8 *)mirror->pixels + y * mirror->pitch);
+            for (int x = 0; x < src->w; x++) {
+                out[src->w - 1 - x] = in[x];
+            }
+        }
+    } else {
+        for (int y = 0; y < src->h; y++) {
+            for (int x = 0; x < src->w; x++) {
+                put_pixel(mirror, src->w - 1 - x, y, get_pixel(src, x, y));
+            }
+        }
+    }
+    SDL_UnlockSurface(mirror);
+    SDL_UnlockSurface(src);
+    return mirror;
+}
+
+// Frames are encoded from the current surface, so redo them whenever it changes
+static void encode_frames(sprite_asset *asset) {
+    for (int i = 0; i < asset->frame_count; i++) {
+        free_rle(asset->rle[i]);
+        asset->rle[i] = encode_rle(asset->surface, &asset->frames[i]);
+    }
+}
+
+static int same_format(SDL_Surface *a, SDL_Surface *b) {
+    SDL_PixelFormat *fa = a->format;
+    SDL_PixelFormat *fb = b->format;
+    return fa->BitsPerPixel == fb->BitsPerPixel && fa->Rmask == fb->Rmask && fa->Gmask == fb->Gmask &&
+           fa->Bmask == fb->Bmask && fa->Amask == fb->Amask;
+}
+
+static void optimiser_asset(sprite_asset *asset) {
+    // Packed sheets usually match already, and stay on their mapped pixels
+    SDL_Surface *target = render_target ? render_target : SDL_GetVideoSurface();
+    if (target && !same_format(asset->surface, target)) {
+        SDL_Surface *optimized = SDL_ConvertSurface(asset->surface, target->format, SDL_SWSURFACE);
+        if (optimized) {
+            // SDL keeps the PNG's SDL_SRCALPHA; with no alpha channel left that is only a
+            // per-surface alpha of 255, and it would keep the sheet off the blit kernel
+            if (!optimized->format->Amask) SDL_SetAlpha(optimized, 0, 255);
+            SDL_FreeSurface(asset->surface);
+            asset->surface = optimized;
+        } else {
+            LOG_WARN(LOG_CORE, "Warning: Failed to optimize %s: %s\n", asset->filename, SDL_GetError());
+        }
+    }
+
+    if (asset->mirrored) {
+        SDL_FreeSurface(asset->mirrored);
+        asset->mirrored = NULL;
+    }
+    // The blit kernel mirrors while drawing; SDL needs a flipped copy
+    if (!blit_supported(asset->surface, target)) {
+        asset->mirrored = creer_miroir(asset->surface);
+    }
+    encode_frames(asset);
+}
+
+// Keys, converts and encodes a freshly decoded sheet; main thread only
+static void install_surface(sprite_asset *asset, SDL_Surface *surface) {
+    // Set transparency (white background: RGB 255,255,255)
+    Uint32 colorkey = SDL_MapRGB(surface->format, 255, 255, 255);
+    if (SDL_SetColorKey(surface, SDL_SRCCOLORKEY, colorkey) != 0) {
+        LOG_ERROR(LOG_CORE, "Error setting colorkey for %s: %s\n", asset->filename, SDL_GetError());
+    }
+    if (surface->format->Amask) {
+        SDL_SetAlpha(surface, SDL_SRCALPHA, 255);
+    }
+
+    asset->surface = surface;
+    asset->ready = 1;
+    optimiser_asset(asset);
+    // Shapes don't change with the display format, so unlike the runs they are built once
+    for (int i = 0; i < asset->frame_count; i++) {
+        asset->masks[i] = build_mask(asset->surface, &asset->frames[i]);
+    }
+    LOG_INFO(LOG_CORE, "Asset loaded: %s (%dx%d)\n", asset->filename, asset->surface->w, asset->surface->h);
+}
+
+static void finish_asset(load_request *r, void *result, long size) {
+    (void)size;
+    sprite_asset *asset = r->user;
+    asset->loading = 0;
+    if (asset->refcount <= 0) {
+        // Released while the loader was still decoding it
+        if (result) SDL_FreeSurface(result);
+        memset(asset, 0, sizeof(*asset));
+        return;
+    }
+    if (!result) {
+        asset->ready = -1;
+        return;
+    }
+    install_surface(asset, result);
+}
+
+static sprite_asset *load_asset(const char *filename, int priority, int async) {
+    sprite_asset *slot = NULL;
+    for (int i = 0; i < MAX_ASSETS; i++) {
+        int used = assets[i].refcount > 0 || assets[i].loading;
+        if (used && strcmp(assets[i].filename, filename) == 0) {
+            assets[i].refcount++;
+            return &assets[i];
+        }
+        if (!slot && !used) {
+            slot = &assets[i];
+        }
+    }
+    if (!slot) {
+        LOG_ERROR(LOG_CORE, "Error loading %s: asset table full (%d entries)\n", filename, MAX_ASSETS);
+        return NULL;
+    }
+
+    memset(slot, 0, sizeof(*slot));
+    strncpy(slot->filename, filename, sizeof(slot->filename) - 1);
+    slot->refcount = 1;
+
+    // Baked pixels need no decode; the PNG is the fallback
+    SDL_Surface *surface = pack_sheet(filename);
+    if (!surface && async && queue_load(filename, LOAD_IMAGE, priority, finish_asset, slot) == 0) {
+        slot->loading = 1;
+        return slot;
+    }
+    if (!surface) {
+        surface = IMG_Load(filename);
+    }
+    if (!surface) {
+        LOG_ERROR(LOG_CORE, "Error loading %s: %s\n", filename, IMG_GetError());
+        memset(slot, 0, sizeof(*slot));
+        return NULL;
+    }
+    install_surface(slot, surface);
+    return slot;
+}
+
+sprite_asset *acquire_asset(const char *filename) {
+    return load_asset(filename, 0, 0);
+}
+
+sprite_asset *request_asset(const char *filename, int priority) {
+    return load_asset(filename, priority, loader_running());
+}
+
+void release_asset(sprite_asset *asset) {
+    if (!asset || asset->refcount <= 0) return;
+    if (--asset->refcount > 0) return;
+    if (asset->loading) return; // finish_asset frees the slot
+
+    if (asset->surface) {
+        SDL_FreeSurface(asset->surface);
+    }
+    if (asset->mirrored) {
+        SDL_FreeSurface(asset->mirrored);
+    }
+    for (int i = 0; i < asset->frame_count; i++) {
+        free_rle(asset->rle[i]);
+        free_mask(asset->masks[i]);
+    }
+    LOG_INFO(LOG_CORE, "Asset released: %s\n", asset->filename);
+    memset(asset, 0, sizeof(*asset));
+}
+
+int add_asset_frame(sprite_asset *asset, const SDL_Rect *frame) {
+    for (int i = 0; i < asset->frame_count; i++) {
+        const SDL_Rect *r = &asset->frames[i];
+        if (r->x == frame->x && r->y == frame->y && r->w == frame->w && r->h == frame->h) return i;
+    }
+    if (asset->frame_count == MAX_SHEET_FRAMES) {
+        LOG_ERROR(LOG_CORE, "Too many frames in %s (max %d)\n", asset->filename, MAX_SHEET_FRAMES);
+        return -1;
+    }
+
+    int i = asset->frame_count++;
+    asset->frames[i] = *frame;
+    asset->rle[i] = asset->surface ? encode_rle(asset->surface, frame) : NULL;
+    asset->masks[i] = asset->surface ? build_mask(asset->surface, frame) : NULL;
+    return i;
+}
+
+void set_asset_target(SDL_Surface *target) {
+    render_target = target;
+    optimiser_assets();
+}
+
+void optimiser_assets(void) {
+    for (int i = 0; i < MAX_ASSETS; i++) {
+        if (assets[i].refcount > 0 && assets[i].surface) {
+            optimiser_asset(&assets[i]);
+        }
+    }
+}
+
+size_t assets_memory_usage(int *count) {
+    size_t bytes = 0;
+    int n = 0;
+    for (int i = 0; i < MAX_ASSETS; i++) {
+        if (assets[i].refcount <= 0 || !assets[i].surface) continue;
+        bytes += (size_t)assets[i].surface->h * assets[i].surface->pitch;
+        if (assets[i].mirrored) {
+            bytes += (size_t)assets[i].mirrored->h * assets[i].mirrored->pitch;
+        }
+        n++;
+    }
+    if (count) *count = n;
+    return bytes;
+}
+
+size_t assets_rle_usage(size_t *raw_bytes) {
+    size_t bytes = 0;
+    size_t raw = 0;
+    for (int i = 0; i < MAX_ASSETS; i++) {
+        if (assets[i].refcount <= 0) continue;
+        for (int f = 0; f < assets[i].frame_count; f++) {
+            if (!assets[i].rle[f]) continue;
+            bytes += rle_size(assets[i].rle[f]);
+            raw += (size_t)assets[i].rle[f]->w * assets[i].rle[f]->h * sizeof(Uint32);
+        }
+    }
+    if (raw_bytes) *raw_bytes = raw;
+    return bytes;
+}
+
+size_t assets_mask_usage(void) {
+    size_t bytes = 0;
+    for (int i = 0; i < MAX_ASSETS; i++) {
+        if (assets[i].refcount <= 0) continue;
+        for (int f = 0; f < assets[i].frame_count; f++) {
+            if (assets[i].masks[f]) bytes += mask_size(assets[i].masks[f]);
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,34 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <SDL/SDL.h>
+#include "rle.h"
+#include "mask.h"
+
+#define MAX_ASSETS 32
+#define MAX_SHEET_FRAMES 32
+
+typedef struct {
+    char filename[64];
+    SDL_Surface* surface;  // Render target's format once one is set, NULL until loaded
+    SDL_Surface* mirrored; // Left-facing copy, only when blit_sprite can't mirror for the target
+    SDL_Rect frames[MAX_SHEET_FRAMES]; // Frames the clips draw from this sheet
+    rle_sprite* rle[MAX_SHEET_FRAMES]; // Visible pixels of each frame, NULL if the format can't be encoded
+    sprite_mask* masks[MAX_SHEET_FRAMES]; // Collision shape of each frame, built once the sheet loads
+    int frame_count;
+    int ready;   // 1 once the sheet is usable, -1 if it failed to load
+    int loading; // Decoding on the loader thread
+    int refcount;
+} sprite_asset;
+
+sprite_asset* acquire_asset(const char* filename); // Loads now; NULL if the sheet can't be loaded
+sprite_asset* request_asset(const char* filename, int priority); // Queued on the loader when it runs
+void release_asset(sprite_asset* asset);
+int add_asset_frame(sprite_asset* asset, const SDL_Rect* frame); // Frame index, or -1
+void set_asset_target(SDL_Surface* target); // Sheets are converted for it from now on
+void optimiser_assets(void); // Reconvert every sheet to the render target's format
+size_t assets_memory_usage(int* count);
+size_t assets_rle_usage(size_t* raw_bytes); // Encoded frame bytes, and what the same frames take raw
+size_t assets_mask_usage(void);
+
+#endif
@@ -0,0 +1,1510 @@
+#include "perso.h"
+#include "assets.h"
+#include "hud.h"
+#include "log.h"
+#include "timing.h"
+#include "input.h"
+#include "alloc_count.h"
+#include "entities.h"
+#include "dirty.h"
+#include "blit.h"
+#include "pack.h"
+#include "combat.h"
+#include "scale.h"
+#include "compose.h"
+#include "jobs.h"
+#include "match.h"
+#include "netplay.h"
+#include "replay.h"
+#include "world.h"
+#include "effects.h"
+#include <SDL/SDL.h>
+#include <SDL/SDL_image.h>
+#include <SDL/SDL_ttf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCREEN_WIDTH 960
+#define SCREEN_HEIGHT 540
+#define FULLSCREEN_WIDTH 1920
+#define FULLSCREEN_HEIGHT 1080
+#define WARMUP_FRAMES 60
+#define VERIFY_WIDTH 320
+#define VERIFY_HEIGHT 240
+
+typedef struct {
+    int chars;
+    int hud;
+    int fullscreen;
+    int frames;
+    int store; // Simulate through the entity store instead of perso structs
+    int dirty; // Restore and present only what changed
+    int combat; // Resolve melee hits every tick
+    int threads; // Compositor threads, 1 draws in order on the main thread
+    int band_height;
+    int sim_threads; // Job pool for the perso update, 0 or 1 updates in order on the main thread
+    int particles; // Effects kept alive, topped up with bursts every frame; 0 leaves them off
+} bench_scenario;
+
+typedef struct {
+    double update;
+    double clear;
+    double sprites;
+    double effects;
+    double hud;
+    double compose;
+    double flip;
+} stage_times;
+
+// Each character replays its own deterministic stream of held inputs
+typedef struct {
+    Uint32 seed;
+    Uint8 held;
+    int remaining;
+} input_script;
+
+static Uint32 next_random(Uint32 *seed) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return *seed >> 8;
+}
+
+static Uint8 scripted_input(input_script *s, int *attack) {
+    static const Uint8 patterns[] = {0, INPUT_LEFT, INPUT_RIGHT, INPUT_LEFT | INPUT_JUMP, INPUT_RIGHT | INPUT_JUMP};
+    if (s->remaining-- <= 0) {
+        s->held = patterns[next_random(&s->seed) % 5];
+        s->remaining = 30 + next_random(&s->seed) % 90;
+    }
+    *attack = next_random(&s->seed) % 240 == 0;
+    return s->held;
+}
+
+// One tick of perso characters, shared by the benchmark and --verify-jobs
+typedef struct {
+    perso *chars;
+    input_script *scripts;
+    combat_body *bodies; // Filled by the batches, filed in the grid afterwards
+    int combat;
+    const collision_map *map;
+    Uint32 thread_queries[MAX_JOB_THREADS]; // Each thread's count for the tick, no sharing
+    unsigned long queries;                  // Collision queries over every tick so far
+} perso_tick;
+
+static void update_perso_batch(void *user, int batch, int first, int last, int thread) {
+    perso_tick *t = user;
+    for (int i = first; i < last; i++) {
+        perso *p = &t->chars[i];
+        int attack;
+        p->prev_pos = p->pos;
+        p->input = scripted_input(&t->scripts[i], &attack);
+        if (attack) attack_perso(p);
+        t->thread_queries[thread] += update_perso(p, t->map);
+        if (t->combat) perso_combat_body(p, &t->bodies[i]);
+    }
+}
+
+// Characters update in parallel; the grid and the hits, which touch other characters, don't
+static int tick_persos(perso_tick *t, int count, job_pool *jobs, combat_grid *g, combat_hit *hits, int *hit_count) {
+    memset(t->thread_queries, 0, sizeof(t->thread_queries));
+    run_jobs(jobs, count, JOB_BATCH_SIZE, update_perso_batch, t);
+    for (int i = 0; i < MAX_JOB_THREADS; i++) {
+        t->queries += t->thread_queries[i];
+    }
+    *hit_count = 0;
+    if (!t->combat) return 0;
+    for (int i = 0; i < count; i++) {
+        set_combat_body(g, i, &t->bodies[i]);
+    }
+    *hit_count = resolve_combat_jobs(g, jobs, hits, MAX_COMBAT_HITS);
+    int landed = 0;
+    for (int h = 0; h < *hit_count; h++) {
+        if (trigger_hit(&t->chars[hits[h].target])) {
+            t->chars[hits[h].attacker].score += HIT_SCORE;
+            landed++;
+        }
+    }
+    return landed;
+}
+
+static void run_scenario(const bench_scenario *sc, TTF_Font *font) {
+    int width = sc->fullscreen ? FULLSCREEN_WIDTH : SCREEN_WIDTH;
+    int height = sc->fullscreen ? FULLSCREEN_HEIGHT : SCREEN_HEIGHT;
+    SDL_Surface *screen = SDL_SetVideoMode(width, height, 32, SDL_SWSURFACE);
+    if (!screen) {
+        LOG_ERROR(LOG_CORE, "SDL_SetVideoMode failed: %s\n", SDL_GetError());
+        return;
+    }
+    scaler scaler;
+    if (init_scaler(&scaler, screen, SCALE_INTEGER) != 0) return;
+    SDL_Surface *back = scaler.back;
+    set_asset_target(back);
+    compositor compose;
+    if (init_compositor(&compose, back, sc->threads, sc->band_height) != 0) {
+        free_scaler(&scaler);
+        return;
+    }
+
+    perso *chars = malloc(sizeof(perso) * (sc->store ? 2 : sc->chars));
+    input_script *scripts = malloc(sizeof(input_script) * sc->chars);
+    combat_body *bodies = malloc(sizeof(combat_body) * sc->chars);
+    combat_hit *hits = malloc(sizeof(combat_hit) * MAX_COMBAT_HITS);
+    combat_grid combat;
+    if (!chars || !scripts || !bodies || !hits || init_combat(&combat, sc->chars) != 0) {
+        LOG_ERROR(LOG_CORE, "Out of memory for %d characters\n", sc->chars);
+        free(chars);
+        free(scripts);
+        free(bodies);
+        free(hits);
+        free_compositor(&compose);
+        free_scaler(&scaler);
+        return;
+    }
+
+    engine_clock sim_clock;
+    init_clock(&sim_clock, DEFAULT_TICK_RATE, 0);
+    entity_store crowd;
+    if (sc->store) {
+        if (init_entities(&crowd, sc->chars) != 0) {
+            free(chars);
+            free(scripts);
+            free(bodies);
+            free(hits);
+            free_combat(&combat);
+            free_compositor(&compose);
+            free_scaler(&scaler);
+            return;
+        }
+        int knight = add_archetype(&crowd, &default_archetype);
+        for (int i = 0; i < sc->chars; i++) {
+            spawn_entity(&crowd, knight, (i * 37) % (LOGICAL_WIDTH - 128), GROUND_LEVEL);
+        }
+    }
+    // The first two characters always exist as perso structs for the HUD
+    int perso_count = sc->store ? (sc->chars < 2 ? sc->chars : 2) : sc->chars;
+    for (int i = 0; i < sc->chars; i++) {
+        scripts[i].seed = 12345u + i * 7919u;
+        scripts[i].held = 0;
+        scripts[i].remaining = 0;
+    }
+    for (int i = 0; i < perso_count; i++) {
+        init_perso(&chars[i]);
+        chars[i].pos.x = (i * 37) % (LOGICAL_WIDTH - chars[i].pos.w);
+        chars[i].prev_pos = chars[i].pos;
+    }
+
+    // A pool that fails to start leaves one thread, which is still correct
+    job_pool jobs;
+    init_jobs(&jobs, sc->store ? 1 : sc->sim_threads);
+    perso_tick tick = {chars, scripts, bodies, sc->combat, screen_collision()};
+
+    // Twice the target, so the characters' own bursts still fit
+    effects fx;
+    int use_effects = sc->particles > 0 && init_effects(&fx, 2 * sc->particles, back, compose.band_height) == 0;
+    Uint32 fx_seed = 99;
+    unsigned long live_particles = 0;
+
+    hud hud1, hud2;
+    init_hud(&hud1, 1, font);
+    init_hud(&hud2, 2, font);
+
+    dirty_tracker dirty;
+    int use_dirty = sc->dirty && init_dirty(&dirty, back) == 0;
+
+    stage_times total = {0, 0, 0, 0, 0, 0, 0};
+    unsigned long allocs = 0;
+    unsigned long pairs = 0;
+    unsigned long mask_rejects = 0;
+    unsigned long queries = 0;
+    int landed = 0;
+    Uint32 black = SDL_MapRGB(back->format, 0, 0, 0);
+    double start = 0;
+
+    for (int frame = 0; frame < WARMUP_FRAMES + sc->frames; frame++) {
+        if (frame == WARMUP_FRAMES) {
+            memset(&total, 0, sizeof(total));
+            memset(jobs.steals, 0, sizeof(jobs.steals));
+            pairs = 0;
+            mask_rejects = 0;
+            queries = 0;
+            tick.queries = 0;
+            live_particles = 0;
+            if (use_effects) fx.dropped = 0;
+            landed = 0;
+            allocs = alloc_count();
+            start = clock_now();
+        }
+
+        double t0 = clock_now();
+        if (sc->store) {
+            for (int i = 0; i < sc->chars; i++) {
+                int attack;
+                crowd.input[i] = scripted_input(&scripts[i], &attack);
+                if (attack) attack_entity(&crowd, i);
+            }
+            queries += deplacer_entities(&crowd, screen_collision());
+            animer_entities(&crowd);
+            if (sc->combat) landed += combat_entities(&crowd, &combat, hits);
+        } else {
+            int hit_count;
+            landed += tick_persos(&tick, sc->chars, &jobs, &combat, hits, &hit_count);
+        }
+        pairs += combat.candidate_pairs;
+        mask_rejects += combat.mask_rejects;
+        clock_step(&sim_clock);
+
+        double t1 = clock_now();
+        if (use_dirty) {
+            dirty_begin_frame(&dirty, back);
+        } else {
+            compose_fill(&compose, NULL, black);
+        }
+
+        double t2 = clock_now();
+        if (sc->store) {
+            afficher_entities(&crowd, &compose);
+            if (use_dirty) dirty.full = 2; // The store doesn't report what it drew
+        } else {
+            for (int i = 0; i < sc->chars; i++) {
+                SDL_Rect render_pos;
+                interpoler_perso(&chars[i], 1.0f, &render_pos);
+                afficher_perso(&chars[i], &compose, &render_pos);
+                if (use_dirty) dirty_add(&dirty, back, &render_pos);
+            }
+        }
+
+        double t_fx = clock_now();
+        if (use_effects) {
+            for (int i = 0; i < perso_count; i++) {
+                perso_effects(&fx, &chars[i]);
+            }
+            while (fx.count < sc->particles) {
+                float x = (float)(next_random(&fx_seed) % LOGICAL_WIDTH);
+                float y = (float)(next_random(&fx_seed) % LOGICAL_HEIGHT);
+                if (next_random(&fx_seed) % 2) {
+                    emit_sparks(&fx, x, y, 24);
+                } else {
+                    emit_dust(&fx, x, y, 24, 20.0f);
+                }
+            }
+            SDL_Rect fx_area;
+            update_effects(&fx, sim_dt());
+            live_particles += draw_effects(&fx, 0, 0, &compose, &fx_area);
+            if (use_dirty && fx_area.w > 0) dirty_add(&dirty, back, &fx_area);
+        }
+
+        double t3 = clock_now();
+        if (sc->hud) {
+            SDL_Rect hud_area;
+            afficher_hud(&hud1, &chars[0], &compose);
+            if (use_dirty && hud_bounds(&hud1, &chars[0], back, &hud_area)) dirty_add(&dirty, back, &hud_area);
+            if (sc->chars > 1) {
+                afficher_hud(&hud2, &chars[1], &compose);
+                if (use_dirty && hud_bounds(&hud2, &chars[1], back, &hud_area)) dirty_add(&dirty, back, &hud_area);
+            }
+        }
+
+        double t4 = clock_now();
+        compose_flush(&compose);
+        double t5 = clock_now();
+        int update_count = use_dirty ? dirty_end_frame(&dirty, back) : -1;
+        present_scaled(&scaler, screen, update_count < 0 ? NULL : dirty.update, update_count);
+        double t6 = clock_now();
+
+        total.update += t1 - t0;
+        total.clear += t2 - t1;
+        total.sprites += t_fx - t2;
+        total.effects += t3 - t_fx;
+        total.hud += t4 - t3;
+        total.compose += t5 - t4;
+        total.flip += t6 - t5;
+    }
+
+    double elapsed = clock_now() - start;
+    allocs = alloc_count() - allocs;
+    double ms = 1000.0 / sc->frames;
+    printf("{\"chars\":%d,\"store\":%d,\"dirty\":%d,\"combat\":%d,\"hud\":%d,\"width\":%d,\"height\":%d,\"frames\":%d,"
+           "\"threads\":%d,\"band_height\":%d,\"serial_flushes\":%u,\"sim_threads\":%d,\"steals_per_frame\":%.2f,"
+           "\"particles\":%d,\"drawn_particles\":%.0f,\"dropped_particles\":%u,"
+           "\"fps\":%.1f,\"frame_ms\":%.4f,"
+           "\"stages_ms\":{\"update\":%.4f,\"sprites\":%.4f,\"effects\":%.4f,\"hud\":%.4f,\"clear\":%.4f,\"compose\":%.4f,\"flip\":%.4f},"
+           "\"pairs_per_tick\":%.1f,\"queries_per_tick\":%.1f,\"mask_rejects\":%lu,\"hits\":%d,"
+           "\"full_redraws\":%u,\"allocs_per_frame\":%.2f}\n",
+           sc->chars, sc->store, use_dirty, sc->combat, sc->hud, width, height, sc->frames,
+           compose.threads, compose.band_height, compose.serial_flushes, jobs.threads, (double)job_steals(&jobs) / sc->frames,
+           sc->particles, (double)live_particles / sc->frames, use_effects ? fx.dropped : 0,
+           sc->frames / elapsed, elapsed * ms,
+           total.update * ms, total.sprites * ms, total.effects * ms, total.hud * ms, total.clear * ms, total.compose * ms, total.flip * ms,
+           (double)pairs / sc->frames, (double)(queries + tick.queries) / sc->frames, mask_rejects, landed,
+           use_dirty ? dirty.full_frames : 0, (double)allocs / sc->frames);
+    fflush(stdout);
+
+    if (use_dirty) free_dirty(&dirty);
+    if (use_effects) free_effects(&fx);
+    free_hud(&hud1);
+    free_hud(&hud2);
+    for (int i = 0; i < perso_count; i++) {
+        free_perso(&chars[i]);
+    }
+    if (sc->store) {
+        free_entities(&crowd);
+    }
+    free_jobs(&jobs);
+    free_combat(&combat);
+    free(chars);
+    free(scripts);
+    free(bodies);
+    free(hits);
+    free_compositor(&compose);
+    set_asset_target(NULL);
+    free_scaler(&scaler);
+}
+
+// Left-right flipped copy, the reference SDL_BlitSurface path mirrors from
+static SDL_Surface *flipped_copy(SDL_Surface *src) {
+    SDL_PixelFormat *f = src->format;
+    SDL_Surface *out = SDL_CreateRGBSurface(SDL_SWSURFACE, src->w, src->h, 32, f->Rmask, f->Gmask, f->Bmask, f->Amask);
+    if (!out) return NULL;
+    if (src->flags & SDL_SRCCOLORKEY) SDL_SetColorKey(out, SDL_SRCCOLORKEY, f->colorkey);
+    if (src->flags & SDL_SRCALPHA) SDL_SetAlpha(out, SDL_SRCALPHA, 255);
+    SDL_LockSurface(src);
+    for (int y = 0; y < src->h; y++) {
+        Uint32 *in = (Uint32 *)((Uint8 *)src->pixels + y * src->pitch);
+        Uint32 *row = (Uint32 *)((Uint8 *)out->pixels + y * out->pitch);
+        for (int x = 0; x < src->w; x++) {
+            row[src->w - 1 - x] = in[x];
+        }
+    }
+    SDL_UnlockSurface(src);
+    return out;
+}
+
+static void fill_noise(SDL_Surface *s, Uint32 seed) {
+    for (int y = 0; y < s->h; y++) {
+        Uint32 *row = (Uint32 *)((Uint8 *)s->pixels + y * s->pitch);
+        for (int x = 0; x < s->w; x++) {
+            row[x] = next_random(&seed) * 257u;
+        }
+    }
+}
+
+static int channels_differ(Uint32 a, Uint32 b, Uint32 rgb_mask, int tolerance) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        if (!((rgb_mask >> shift) & 0xff)) continue;
+        int d = (int)((a >> shift) & 0xff) - (int)((b >> shift) & 0xff);
+        if (d > tolerance || d < -tolerance) return 1;
+    }
+    return 0;
+}
+
+// Compares blit_sprite with SDL_BlitSurface, pixel for pixel, for every kernel this CPU has
+static int verify_blit(void) {
+    SDL_Surface *screen = SDL_SetVideoMode(VERIFY_WIDTH, VERIFY_HEIGHT, 32, SDL_SWSURFACE);
+    sprite_asset *sheet = screen ? acquire_asset("Idle.png") : NULL;
+    if (!sheet) {
+        LOG_ERROR(LOG_CORE, "Blit verify setup failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    SDL_PixelFormat *f = screen->format;
+    Uint32 rgb_mask = f->Rmask | f->Gmask | f->Bmask;
+    SDL_Surface *expected = SDL_CreateRGBSurface(SDL_SWSURFACE, VERIFY_WIDTH, VERIFY_HEIGHT, 32, f->Rmask, f->Gmask, f->Bmask, 0);
+    SDL_Surface *actual = SDL_CreateRGBSurface(SDL_SWSURFACE, VERIFY_WIDTH, VERIFY_HEIGHT, 32, f->Rmask, f->Gmask, f->Bmask, 0);
+    SDL_Surface *alpha = SDL_CreateRGBSurface(SDL_SWSURFACE, 301, 97, 32, f->Rmask, f->Gmask, f->Bmask, ~rgb_mask);
+    if (!expected || !actual || !alpha) {
+        LOG_ERROR(LOG_CORE, "Blit verify setup failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    // A sheet SDL would have to draw means none of the kernels below are used in the game
+    int mismatches = 0;
+    if (!blit_supported(sheet->surface, screen)) {
+        LOG_ERROR(LOG_CORE, "Blit mismatch: Idle.png loads in a format the kernel can't draw (flags %#x)\n",
+                  sheet->surface->flags);
+        mismatches++;
+    }
+    fill_noise(alpha, 99);
+    SDL_SetAlpha(alpha, SDL_SRCALPHA, 255);
+    // The third source draws the keyed sheet from its run-length encoding
+    SDL_Surface *sources[3] = {sheet->surface, alpha, sheet->surface};
+    SDL_Surface *flipped[3] = {flipped_copy(sheet->surface), flipped_copy(alpha), NULL};
+    flipped[2] = flipped[0];
+
+    static const SDL_Rect frames[] = {{0, 0, 128, 128}, {131, 7, 61, 83}, {5, 3, 3, 90}, {250, 0, 51, 97}};
+    static const int positions[][2] = {{40, 30}, {-50, 10}, {280, -40}, {300, 230}, {-127, -127}, {330, 5}, {0, 0}};
+    int cases = 0;
+    for (int k = 0; k < BLIT_KERNEL_COUNT; k++) {
+        if (select_blit_kernel((blit_kernel)k) != 0) continue;
+        for (int src = 0; src < 3; src++) {
+            for (int mirror = 0; mirror < 2; mirror++) {
+                for (int fr = 0; fr < 4; fr++) {
+                    for (int pos = 0; pos < 7; pos++) {
+                        SDL_Rect frame = frames[fr];
+                        SDL_Rect ref_src = frame;
+                        if (mirror) ref_src.x = flipped[src]->w - frame.x - frame.w;
+                        SDL_Rect ref_dst = {positions[pos][0], positions[pos][1], 0, 0};
+                        SDL_Rect dst = ref_dst;
+                        fill_noise(expected, 7 + pos);
+                        fill_noise(actual, 7 + pos);
+                        SDL_BlitSurface(mirror ? flipped[src] : sources[src], &ref_src, expected, &ref_dst);
+                        if (src == 2) {
+                            rle_sprite *rle = encode_rle(sources[src], &frame);
+                            blit_rle(rle, actual, &dst, mirror);
+                            free_rle(rle);
+                        } else {
+                            blit_sprite(sources[src], &frame, actual, &dst, mirror);
+                        }
+
+                        int bad = ref_dst.x != dst.x || ref_dst.y != dst.y || ref_dst.w != dst.w || ref_dst.h != dst.h;
+                        for (int y = 0; y < VERIFY_HEIGHT && !bad; y++) {
+                            Uint32 *e = (Uint32 *)((Uint8 *)expected->pixels + y * expected->pitch);
+                            Uint32 *a = (Uint32 *)((Uint8 *)actual->pixels + y * actual->pitch);
+                            for (int x = 0; x < VERIFY_WIDTH && !bad; x++) {
+                                // SDL's own alpha blitters round differently depending on the CPU
+                                bad = channels_differ(e[x], a[x], rgb_mask, src == 1 ? 1 : 0);
+                            }
+                        }
+                        if (bad) {
+                            LOG_ERROR(LOG_CORE, "Blit mismatch: kernel=%s source=%s mirror=%d frame=%d pos=%d\n",
+                                      blit_kernel_name((blit_kernel)k), src == 0 ? "keyed" : src == 1 ? "alpha" : "rle",
+                                      mirror, fr, pos);
+                            mismatches++;
+                        }
+                        cases++;
+                    }
+                }
+            }
+        }
+    }
+    printf("{\"verify_blit\":\"%s\",\"cases\":%d,\"mismatches\":%d}\n",
+           blit_kernel_name(current_blit_kernel()), cases, mismatches);
+
+    for (int i = 0; i < 2; i++) {
+        if (flipped[i]) SDL_FreeSurface(flipped[i]);
+    }
+    SDL_FreeSurface(alpha);
+    SDL_FreeSurface(actual);
+    SDL_FreeSurface(expected);
+    release_asset(sheet);
+    init_blit();
+    return mismatches ? 1 : 0;
+}
+
+// Whether pixel (x, y) of a frame, as drawn with that facing, is opaque in the keyed sheet
+static int frame_opaque(SDL_Surface *sheet, const SDL_Rect *frame, int x, int y, int mirror) {
+    if (x < 0 || y < 0 || x >= frame->w || y >= frame->h) return 0;
+    int sx = frame->x + (mirror ? frame->w - 1 - x : x);
+    Uint32 pixel = ((Uint32 *)((Uint8 *)sheet->pixels + (frame->y + y) * sheet->pitch))[sx];
+    SDL_PixelFormat *f = sheet->format;
+    return (pixel & ~f->Amask) != (f->colorkey & ~f->Amask);
+}
+
+// Checks masks_overlap against a pixel-by-pixel search over random placements and clips
+static int verify_masks(void) {
+    SDL_Surface *screen = SDL_SetVideoMode(VERIFY_WIDTH, VERIFY_HEIGHT, 32, SDL_SWSURFACE);
+    sprite_asset *sheet = screen ? acquire_asset("Attack.png") : NULL;
+    if (!sheet) {
+        LOG_ERROR(LOG_CORE, "Mask verify setup failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    static const SDL_Rect frames[] = {{0, 0, 128, 128}, {384, 0, 128, 128}, {512, 0, 128, 128},
+                                      {131, 7, 61, 83}, {5, 3, 3, 90}, {400, 60, 70, 68}};
+    const int frame_count = sizeof(frames) / sizeof(frames[0]);
+    int index[sizeof(frames) / sizeof(frames[0])];
+    for (int i = 0; i < frame_count; i++) {
+        index[i] = add_asset_frame(sheet, &frames[i]);
+    }
+
+    Uint32 seed = 4242;
+    int cases = 0;
+    int mismatches = 0;
+    int overlaps = 0;
+    for (int n = 0; n < 4000; n++) {
+        int i = next_random(&seed) % frame_count;
+        int j = next_random(&seed) % frame_count;
+        int amirror = next_random(&seed) & 1, bmirror = next_random(&seed) & 1;
+        int ax = 100, ay = 100;
+        int bx = ax + (int)(next_random(&seed) % 180) - 90;
+        int by = ay + (int)(next_random(&seed) % 180) - 90;
+        SDL_Rect clip = {ax + (int)(next_random(&seed) % 128) - 20, ay + (int)(next_random(&seed) % 128) - 20,
+                         1 + next_random(&seed) % 100, 1 + next_random(&seed) % 100};
+        int clipped = n % 2;
+
+        int expected = 0;
+        const SDL_Rect *fa = &frames[i], *fb = &frames[j];
+        for (int y = 0; y < fa->h && !expected; y++) {
+            for (int x = 0; x < fa->w && !expected; x++) {
+                int wx = ax + x, wy = ay + y;
+                if (clipped && (wx < clip.x || wy < clip.y || wx >= clip.x + clip.w || wy >= clip.y + clip.h)) continue;
+                expected = frame_opaque(sheet->surface, fa, x, y, amirror) &&
+                           frame_opaque(sheet->surface, fb, wx - bx, wy - by, bmirror);
+            }
+        }
+        int actual = masks_overlap(sheet->masks[index[i]], ax, ay, amirror, sheet->masks[index[j]], bx, by, bmirror,
+                                   clipped ? &clip : NULL);
+        cases++;
+        overlaps += expected;
+        if (actual != expected) {
+            if (mismatches < 10) {
+                LOG_ERROR(LOG_CORE, "Mask mismatch: frames %d/%d mirrors %d/%d offset %d,%d clipped %d: %d, expected %d\n",
+                          i, j, amirror, bmirror, bx - ax, by - ay, clipped, actual, expected);
+            }
+            mismatches++;
+        }
+    }
+    printf("{\"verify_masks\":\"%s\",\"cases\":%d,\"overlapping\":%d,\"mismatches\":%d,\"mask_kb\":%lu}\n",
+           sheet->filename, cases, overlaps, mismatches, (unsigned long)(assets_mask_usage() / 1024));
+    release_asset(sheet);
+    return mismatches ? 1 : 0;
+}
+
+// Compares present_scaled with a per-pixel nearest-neighbour reference, full and partial, for
+// every kernel this CPU has, at integer, shrinking and non-integer modes
+static int verify_scale(void) {
+    static const struct {
+        int w, h;
+        scale_mode mode;
+    } modes[] = {{960, 540, SCALE_INTEGER}, {1920, 1080, SCALE_INTEGER}, {2880, 1620, SCALE_INTEGER},
+                 {1366, 768, SCALE_INTEGER}, {1366, 768, SCALE_FIT}, {800, 600, SCALE_INTEGER}};
+    int cases = 0;
+    int mismatches = 0;
+    for (int k = 0; k < BLIT_KERNEL_COUNT; k++) {
+        if (select_blit_kernel((blit_kernel)k) != 0) continue;
+        for (int m = 0; m < (int)(sizeof(modes) / sizeof(modes[0])); m++) {
+            SDL_Surface *screen = SDL_SetVideoMode(modes[m].w, modes[m].h, 32, SDL_SWSURFACE);
+            scaler scaler;
+            if (!screen || init_scaler(&scaler, screen, modes[m].mode) != 0) {
+                LOG_ERROR(LOG_CORE, "Scale verify setup failed: %s\n", SDL_GetError());
+                return 1;
+            }
+            Uint32 rgb_mask = screen->format->Rmask | screen->format->Gmask | screen->format->Bmask;
+            Uint32 seed = 777 + m;
+            fill_noise(scaler.back, seed);
+            for (int pass = 0; pass < 4; pass++) {
+                SDL_Rect rects[8];
+                int count = 0;
+                if (pass > 0) {
+                    // Redraw a few areas and present only those, as the dirty tracker would
+                    count = 1 + next_random(&seed) % 8;
+                    for (int i = 0; i < count; i++) {
+                        rects[i].x = (int)(next_random(&seed) % (LOGICAL_WIDTH + 40)) - 20;
+                        rects[i].y = (int)(next_random(&seed) % (LOGICAL_HEIGHT + 40)) - 20;
+                        rects[i].w = 1 + next_random(&seed) % 200;
+                        rects[i].h = 1 + next_random(&seed) % 200;
+                        SDL_Rect fill = rects[i];
+                        SDL_FillRect(scaler.back, &fill, next_random(&seed) & rgb_mask);
+                    }
+                }
+                present_scaled(&scaler, screen, pass > 0 ? rects : NULL, count);
+
+                const SDL_Rect *v = &scaler.view;
+                for (int y = 0; y < screen->h; y++) {
+                    const Uint32 *row = (const Uint32 *)((const Uint8 *)screen->pixels + y * screen->pitch);
+                    for (int x = 0; x < screen->w; x++) {
+                        Uint32 expected = 0;
+                        if (x >= v->x && y >= v->y && x < v->x + v->w && y < v->y + v->h) {
+                            int sx = (x - v->x) * LOGICAL_WIDTH / v->w;
+                            int sy = (y - v->y) * LOGICAL_HEIGHT / v->h;
+                            expected = ((const Uint32 *)((const Uint8 *)scaler.back->pixels + sy * scaler.back->pitch))[sx];
+                        }
+                        cases++;
+                        if (channels_differ(row[x], expected, rgb_mask, 0)) {
+                            if (mismatches < 10) {
+                                LOG_ERROR(LOG_CORE, "Scale mismatch: %s %dx%d mode %d pass %d at %d,%d\n",
+                                          blit_kernel_name((blit_kernel)k), screen->w, screen->h, modes[m].mode, pass, x, y);
+                            }
+                            mismatches++;
+                        }
+                    }
+                }
+            }
+            free_scaler(&scaler);
+        }
+    }
+    init_blit();
+    printf("{\"verify_scale\":%d,\"pixels\":%d,\"mismatches\":%d}\n", (int)(sizeof(modes) / sizeof(modes[0])), cases, mismatches);
+    return mismatches ? 1 : 0;
+}
+
+// One crowded frame: sprites in every band, fills, keyed blits and the HUD. The foreign
+// surface has another channel order, so its blits need SDL and make the flush serial.
+static void draw_verify_scene(compositor *c, entity_store *crowd, hud *huds, perso *p, SDL_Surface *keyed,
+                              SDL_Surface *foreign) {
+    Uint32 seed = 31337;
+    compose_fill(c, NULL, SDL_MapRGB(c->target->format, 20, 30, 40));
+    afficher_entities(crowd, c);
+    for (int i = 0; i < 64; i++) {
+        int x = (int)(next_random(&seed) % (LOGICAL_WIDTH + 100)) - 50;
+        int y = (int)(next_random(&seed) % (LOGICAL_HEIGHT + 100)) - 50;
+        if (i % 2) {
+            SDL_Rect r = {x, y, 1 + next_random(&seed) % 90, 1 + next_random(&seed) % 90};
+            compose_fill(c, &r, next_random(&seed));
+        } else {
+            compose_blit(c, keyed, NULL, x, y);
+        }
+        if (foreign && i % 16 == 0) compose_blit(c, foreign, NULL, x + 20, y + 20);
+    }
+    afficher_hud(&huds[0], p, c);
+    afficher_hud(&huds[1], p, c);
+    compose_flush(c);
+}
+
+// Compares banded composition with drawing in order, for several thread counts and band heights
+static int verify_compose(TTF_Font *font) {
+    SDL_Surface *screen = SDL_SetVideoMode(LOGICAL_WIDTH, LOGICAL_HEIGHT, 32, SDL_SWSURFACE);
+    if (!screen) {
+        LOG_ERROR(LOG_CORE, "Compose verify setup failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    SDL_PixelFormat *f = screen->format;
+    SDL_Surface *expected = SDL_CreateRGBSurface(SDL_SWSURFACE, LOGICAL_WIDTH, LOGICAL_HEIGHT, 32, f->Rmask, f->Gmask, f->Bmask, 0);
+    SDL_Surface *actual = SDL_CreateRGBSurface(SDL_SWSURFACE, LOGICAL_WIDTH, LOGICAL_HEIGHT, 32, f->Rmask, f->Gmask, f->Bmask, 0);
+    SDL_Surface *keyed = SDL_CreateRGBSurface(SDL_SWSURFACE, 61, 45, 32, f->Rmask, f->Gmask, f->Bmask, 0);
+    SDL_Surface *foreign = SDL_CreateRGBSurface(SDL_SWSURFACE, 33, 21, 32, f->Bmask, f->Gmask, f->Rmask, 0);
+    entity_store crowd;
+    if (!expected || !actual || !keyed || !foreign || init_entities(&crowd, 600) != 0) {
+        LOG_ERROR(LOG_CORE, "Compose verify setup failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    fill_noise(keyed, 5);
+    fill_noise(foreign, 6);
+    Uint32 key = SDL_MapRGB(keyed->format, 255, 0, 255);
+    for (int y = 0; y < keyed->h; y += 3) {
+        SDL_Rect stripe = {y % 7, y, 40, 2};
+        SDL_FillRect(keyed, &stripe, key);
+    }
+    SDL_SetColorKey(keyed, SDL_SRCCOLORKEY, key);
+
+    set_asset_target(expected);
+    int knight = add_archetype(&crowd, &default_archetype);
+    Uint32 seed = 2024;
+    for (int i = 0; i < 600; i++) {
+        int id = spawn_entity(&crowd, knight, (int)(next_random(&seed) % (LOGICAL_WIDTH + 64)) - 96,
+                              (int)(next_random(&seed) % (LOGICAL_HEIGHT + 64)) - 96);
+        crowd.direction[id] = next_random(&seed) & 1;
+        if (i % 3 == 0) attack_entity(&crowd, id);
+    }
+    for (int t = 0; t < 7; t++) {
+        animer_entities(&crowd);
+    }
+    perso p;
+    init_perso(&p);
+    p.score = 1234;
+    hud huds[2];
+    init_hud(&huds[0], 1, font);
+    init_hud(&huds[1], 2, font);
+
+    compositor c;
+    static const int band_heights[] = {1, 7, 32, 100, 1000};
+    int thread_counts[] = {2, compose_cpu_count() > 2 ? compose_cpu_count() : 3};
+    int cases = 0;
+    int serial = 0;
+    long mismatches = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        // The first pass leaves the foreign blits out, so every flush can run in parallel
+        SDL_Surface *other = pass ? foreign : NULL;
+        init_compositor(&c, expected, 1, 0);
+        draw_verify_scene(&c, &crowd, huds, &p, keyed, other);
+        free_compositor(&c);
+        for (int t = 0; t < 2; t++) {
+            for (int b = 0; b < (int)(sizeof(band_heights) / sizeof(band_heights[0])); b++) {
+                SDL_FillRect(actual, NULL, 0);
+                init_compositor(&c, actual, thread_counts[t], band_heights[b]);
+                draw_verify_scene(&c, &crowd, huds, &p, keyed, other);
+                serial += c.serial_flushes;
+                free_compositor(&c);
+                for (int y = 0; y < LOGICAL_HEIGHT; y++) {
+                    const Uint32 *a = (const Uint32 *)((const Uint8 *)actual->pixels + y * actual->pitch);
+                    const Uint32 *e = (const Uint32 *)((const Uint8 *)expected->pixels + y * expected->pitch);
+                    for (int x = 0; x < LOGICAL_WIDTH; x++) {
+                        if (a[x] == e[x]) continue;
+                        if (mismatches < 10) {
+                            LOG_ERROR(LOG_CORE, "Compose mismatch: %d threads, bands of %d, foreign %d at %d,%d\n",
+                                      thread_counts[t], band_heights[b], pass, x, y);
+                        }
+                        mismatches++;
+                    }
+                }
+                cases++;
+            }
+        }
+    }
+    printf("{\"verify_compose\":%d,\"threads\":%d,\"serial_flushes\":%d,\"mismatches\":%ld}\n",
+           cases, thread_counts[1], serial, mismatches);
+
+    free_hud(&huds[0]);
+    free_hud(&huds[1]);
+    free_perso(&p);
+    free_entities(&crowd);
+    set_asset_target(NULL);
+    SDL_FreeSurface(foreign);
+    SDL_FreeSurface(keyed);
+    SDL_FreeSurface(actual);
+    SDL_FreeSurface(expected);
+    return mismatches ? 1 : 0;
+}
+
+// Runs the same scripted crowd with every batch on the main thread, then across the pool,
+// and compares each tick's hits and the characters they leave behind
+#define VERIFY_JOB_CHARS 700
+#define VERIFY_JOB_TICKS 600
+
+static int run_verify_crowd(perso *chars, int threads, Uint32 *hit_sums, Uint32 *steals) {
+    input_script scripts[VERIFY_JOB_CHARS];
+    static combat_body bodies[VERIFY_JOB_CHARS];
+    combat_hit hits[MAX_COMBAT_HITS];
+    combat_grid combat;
+    job_pool jobs;
+    if (init_combat(&combat, VERIFY_JOB_CHARS) != 0) return -1;
+    init_jobs(&jobs, threads);
+
+    engine_clock clock;
+    init_clock(&clock, DEFAULT_TICK_RATE, 0);
+    for (int i = 0; i < VERIFY_JOB_CHARS; i++) {
+        scripts[i].seed = 777u + i * 104729u;
+        scripts[i].held = 0;
+        scripts[i].remaining = 0;
+        init_perso(&chars[i]);
+        // Packed tight so hits, and the merge across batches, happen every tick
+        chars[i].pos.x = (i * 13) % (LOGICAL_WIDTH - chars[i].pos.w);
+        chars[i].prev_pos = chars[i].pos;
+    }
+    perso_tick tick = {chars, scripts, bodies, 1, screen_collision()};
+    int total = 0;
+    for (int t = 0; t < VERIFY_JOB_TICKS; t++) {
+        int hit_count;
+        tick_persos(&tick, VERIFY_JOB_CHARS, &jobs, &combat, hits, &hit_count);
+        Uint32 sum = 2166136261u;
+        for (int h = 0; h < hit_count; h++) {
+            sum = (sum ^ (Uint32)hits[h].attacker) * 16777619u;
+            sum = (sum ^ (Uint32)hits[h].target) * 16777619u;
+        }
+        hit_sums[t] = sum;
+        total += hit_count;
+        clock_step(&clock);
+    }
+    *steals = job_steals(&jobs);
+    free_jobs(&jobs);
+    free_combat(&combat);
+    return total;
+}
+
+static int verify_jobs(void) {
+    static perso expected[VERIFY_JOB_CHARS], actual[VERIFY_JOB_CHARS];
+    static Uint32 expected_hits[VERIFY_JOB_TICKS], actual_hits[VERIFY_JOB_TICKS];
+    int threads = compose_cpu_count() > 2 ? compose_cpu_count() : 4;
+    Uint32 steals;
+    int hits = run_verify_crowd(expected, 1, expected_hits, &steals);
+    int parallel_hits = run_verify_crowd(actual, threads, actual_hits, &steals);
+    if (hits < 0 || parallel_hits < 0) {
+        LOG_ERROR(LOG_CORE, "Jobs verify setup failed\n");
+        return 1;
+    }
+
+    int mismatches = 0;
+    for (int t = 0; t < VERIFY_JOB_TICKS; t++) {
+        if (expected_hits[t] == actual_hits[t]) continue;
+        if (mismatches < 10) LOG_ERROR(LOG_CORE, "Jobs mismatch: hits differ on tick %d\n", t);
+        mismatches++;
+    }
+    for (int i = 0; i < VERIFY_JOB_CHARS; i++) {
+        const perso *e = &expected[i], *a = &actual[i];
+        if (e->pos.x == a->pos.x && e->pos.y == a->pos.y && e->state == a->state && e->direction == a->direction &&
+            e->anim.clip == a->anim.clip && e->anim.frame == a->anim.frame && e->vie == a->vie &&
+            e->score == a->score && e->speed == a->speed && e->velocity_y == a->velocity_y) {
+            continue;
+        }
+        if (mismatches < 10) LOG_ERROR(LOG_CORE, "Jobs mismatch: character %d differs\n", i);
+        mismatches++;
+    }
+    printf("{\"verify_jobs\":%d,\"threads\":%d,\"hits\":%d,\"steals\":%u,\"mismatches\":%d}\n",
+           VERIFY_JOB_TICKS, threads, hits, steals, mismatches);
+
+    for (int i = 0; i < VERIFY_JOB_CHARS; i++) {
+        free_perso(&expected[i]);
+        free_perso(&actual[i]);
+    }
+    return mismatches ? 1 : 0;
+}
+
+// Plays both sides of a netplay match in this process over loopback, one side ticking
+// unevenly, and checks both end where a match fed the same inputs directly ends
+#define VERIFY_NET_TICKS 600
+#define VERIFY_NET_LATENCY 40
+#define VERIFY_NET_PORT 7311
+
+static Uint8 verify_net_input(input_script *s) {
+    int attack;
+    Uint8 input = scripted_input(s, &attack);
+    return attack ? input | INPUT_ATTACK : input;
+}
+
+static int verify_netplay(void) {
+    static match games[3]; // Player 1's process, player 2's, and the reference
+    static netplay peers[2];
+    static Uint8 inputs[VERIFY_NET_TICKS][2];
+    engine_clock clocks[2];
+    for (int g = 0; g < 3; g++) {
+        if (init_match(&games[g]) != 0) return 1;
+        games[g].player2_visible = 1;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (init_netplay(&peers[i], i + 1, VERIFY_NET_PORT, VERIFY_NET_LATENCY) != 0) {
+            LOG_ERROR(LOG_CORE, "Netplay verify setup failed\n");
+            return 1;
+        }
+        init_clock(&clocks[i], DEFAULT_TICK_RATE, 0);
+    }
+
+    // What a snapshot costs: one save and one load of the whole match
+    match_snapshot snap, again;
+    int rounds = 100000;
+    double t0 = clock_now();
+    for (int r = 0; r < rounds; r++) {
+        save_match(&games[0], r, &snap);
+        load_match(&games[0], &snap);
+    }
+    double copy_us = (clock_now() - t0) * 1e6 / rounds;
+    save_match(&games[0], 0, &again);
+    int mismatches = memcmp(&snap.players, &again.players, sizeof(snap.players)) != 0;
+
+    input_script scripts[2] = {{99991u, 0, 0}, {424243u, 0, 0}};
+    Uint8 next[2] = {verify_net_input(&scripts[0]), verify_net_input(&scripts[1])};
+    Uint32 seed = 5;
+    double deadline = clock_now() + 30.0;
+    for (;;) {
+        int done = 1;
+        for (int i = 0; i < 2; i++) {
+            netplay *n = &peers[i];
+            poll_netplay(n);
+            rollback_netplay(n, &games[i], &clocks[i]);
+            // Player 2 runs 0 to 3 ticks a frame, so both fall behind and run ahead
+            int ticks = i == 0 ? 1 : (int)(next_random(&seed) % 4);
+            for (int t = 0; t < ticks && n->tick < VERIFY_NET_TICKS; t++) {
+                if (!advance_netplay(n, &games[i], &clocks[i], next[i])) break;
+                inputs[n->tick - 1][i] = next[i];
+                next[i] = verify_net_input(&scripts[i]);
+            }
+            send_netplay(n);
+            done &= n->tick == VERIFY_NET_TICKS && n->confirmed == VERIFY_NET_TICKS && !n->rollback_pending;
+        }
+        if (done || clock_now() > deadline) break;
+        SDL_Delay(2);
+    }
+
+    engine_clock reference_clock;
+    init_clock(&reference_clock, DEFAULT_TICK_RATE, 0);
+    for (int t = 0; t < VERIFY_NET_TICKS; t++) {
+        step_match(&games[2], inputs[t]);
+        clock_step(&reference_clock);
+    }
+    save_match(&games[2], VERIFY_NET_TICKS, &snap);
+    for (int i = 0; i < 2; i++) {
+        save_match(&games[i], VERIFY_NET_TICKS, &again);
+        if (peers[i].tick != VERIFY_NET_TICKS || memcmp(&snap, &again, sizeof(snap)) != 0) {
+            LOG_ERROR(LOG_CORE, "Netplay mismatch: player %d's process ended on tick %u, confirmed %u\n", i + 1,
+                      peers[i].tick, peers[i].confirmed);
+            mismatches++;
+        }
+    }
+
+    const netplay *n = &peers[1];
+    printf("{\"verify_netplay\":%d,\"latency_ms\":%d,\"snapshot_bytes\":%d,\"snapshot_us\":%.3f,"
+           "\"rollbacks\":%u,\"avg_depth\":%.1f,\"max_depth\":%u,\"resim_ms\":%.4f,\"stalls\":%u,\"mismatches\":%d}\n",
+           VERIFY_NET_TICKS, VERIFY_NET_LATENCY, (int)sizeof(match_snapshot), copy_us, n->rollbacks,
+           n->rollbacks ? (double)n->resim_ticks / n->rollbacks : 0.0, n->max_depth,
+           n->rollbacks ? n->resim_seconds * 1000.0 / n->rollbacks : 0.0, n->stalls, mismatches);
+
+    for (int i = 0; i < 2; i++) {
+        free_netplay(&peers[i]);
+    }
+    for (int g = 0; g < 3; g++) {
+        free_match(&games[g]);
+    }
+    return mismatches ? 1 : 0;
+}
+
+// Records a scripted session, saves and reloads it, and plays it back into a fresh match
+#define VERIFY_REPLAY_TICKS 3600
+#define VERIFY_REPLAY_FILE "bench_verify.rpl"
+
+static int verify_replay(void) {
+    static match recorded, played;
+    if (init_match(&recorded) != 0 || init_match(&played) != 0) return 1;
+    recorded.player2_visible = 1;
+    replay r, loaded;
+    init_replay(&r, DEFAULT_TICK_RATE, recorded.player2_visible, NULL, recorded.map);
+
+    input_script scripts[2] = {{31u, 0, 0}, {1009u, 0, 0}};
+    Uint32 seed = 77;
+    engine_clock clock;
+    init_clock(&clock, DEFAULT_TICK_RATE, 0);
+    for (int t = 0; t < VERIFY_REPLAY_TICKS; t++) {
+        match_commands cmd;
+        cmd.inputs[0] = verify_net_input(&scripts[0]);
+        cmd.inputs[1] = verify_net_input(&scripts[1]);
+        Uint32 roll = next_random(&seed) % 2000;
+        cmd.events = roll == 0 ? MATCH_TOGGLE_PLAYER2 : roll == 1 ? MATCH_HIT_PLAYER1 : roll == 2 ? MATCH_HIT_PLAYER2 : 0;
+        apply_match_events(&recorded, cmd.events);
+        step_match(&recorded, cmd.inputs);
+        clock_step(&clock);
+        if (record_replay(&r, &cmd, &recorded) != 0) return 1;
+    }
+    Uint32 hash = hash_match(&recorded);
+    if (save_replay(&r, VERIFY_REPLAY_FILE, hash) != 0 || load_replay(&loaded, VERIFY_REPLAY_FILE) != 0) return 1;
+    FILE *f = fopen(VERIFY_REPLAY_FILE, "rb");
+    fseek(f, 0, SEEK_END);
+    long bytes = ftell(f);
+    fclose(f);
+    remove(VERIFY_REPLAY_FILE);
+
+    int mismatches = loaded.tick_count != r.tick_count || loaded.final_hash != hash ||
+                     loaded.checkpoint_count != r.checkpoint_count || check_replay_level(&loaded, played.map) != 0;
+    for (Uint32 t = 0; t < r.tick_count && t < loaded.tick_count; t++) {
+        if (memcmp(&r.ticks[t], &loaded.ticks[t], sizeof(match_commands)) != 0) mismatches++;
+    }
+
+    played.player2_visible = loaded.player2_visible;
+    init_clock(&clock, loaded.tick_rate, 0);
+    double start = clock_now();
+    Uint32 diverged;
+    Uint32 replayed = play_replay(&loaded, &played, &clock, 0, loaded.tick_count, &diverged);
+    double seconds = clock_now() - start;
+    if (replayed != loaded.final_hash || diverged) {
+        LOG_ERROR(LOG_CORE, "Replay mismatch: state %08x, recorded %08x, diverged by tick %u\n", replayed,
+                  loaded.final_hash, diverged);
+        mismatches++;
+    }
+    printf("{\"verify_replay\":%u,\"file_bytes\":%ld,\"checkpoints\":%u,\"ticks_per_s\":%.0f,\"hash\":\"%08x\","
+           "\"mismatches\":%d}\n",
+           loaded.tick_count, bytes, loaded.checkpoint_count, seconds > 0 ? loaded.tick_count / seconds : 0.0, replayed,
+           mismatches);
+
+    free_replay(&r);
+    free_replay(&loaded);
+    free_match(&recorded);
+    free_match(&played);
+    return mismatches ? 1 : 0;
+}
+
+// Sweeps a camera over a generated level wider than the chunk cache, drawing the background
+// from cached chunks through the compositor and straight, and compares every frame with the
+// same tiles painted one at a time
+#define VERIFY_WORLD_CHUNKS 40
+#define VERIFY_WORLD_ROWS 3
+#define VERIFY_WORLD_FRAMES 240
+#define VERIFY_WORLD_FILE "bench_verify.map"
+
+// Adds the pixels where the drawn view differs, logging the first few
+static long compare_world(SDL_Surface *expected, SDL_Surface *actual, int frame, const camera *view, long mismatches) {
+    for (int y = 0; y < LOGICAL_HEIGHT; y++) {
+        const Uint32 *a = (const Uint32 *)((const Uint8 *)actual->pixels + y * actual->pitch);
+        const Uint32 *e = (const Uint32 *)((const Uint8 *)expected->pixels + y * expected->pitch);
+        for (int x = 0; x < LOGICAL_WIDTH; x++) {
+            if (a[x] == e[x]) continue;
+            if (mismatches < 10) {
+                LOG_ERROR(LOG_CORE, "World mismatch: frame %d, view %d,%d, at %d,%d\n", frame, view->x, view->y, x, y);
+            }
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+static int verify_world(void) {
+    SDL_Surface *screen = SDL_SetVideoMode(LOGICAL_WIDTH, LOGICAL_HEIGHT, 32, SDL_SWSURFACE);
+    if (!screen) {
+        LOG_ERROR(LOG_CORE, "World verify setup failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    SDL_PixelFormat *f = screen->format;
+    SDL_Surface *expected = SDL_CreateRGBSurface(SDL_SWSURFACE, LOGICAL_WIDTH, LOGICAL_HEIGHT, 32, f->Rmask, f->Gmask, f->Bmask, 0);
+    SDL_Surface *actual = SDL_CreateRGBSurface(SDL_SWSURFACE, LOGICAL_WIDTH, LOGICAL_HEIGHT, 32, f->Rmask, f->Gmask, f->Bmask, 0);
+    int cols = VERIFY_WORLD_CHUNKS * CHUNK_TILES;
+    int rows = VERIFY_WORLD_ROWS * CHUNK_TILES;
+    Uint8 *tiles = malloc((size_t)cols * rows);
+    if (!expected || !actual || !tiles) {
+        LOG_ERROR(LOG_CORE, "World verify setup failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    // Mostly runs, so the encoding sees both long and single-tile ones
+    Uint32 seed = 4242;
+    Uint8 tile = TILE_EMPTY;
+    for (int i = 0; i < cols * rows; i++) {
+        if (next_random(&seed) % 4 == 0) tile = (Uint8)(next_random(&seed) % TILE_KIND_COUNT);
+        tiles[i] = tile;
+    }
+    world w;
+    if (save_level(VERIFY_WORLD_FILE, tiles, VERIFY_WORLD_CHUNKS, VERIFY_WORLD_ROWS) != 0 ||
+        load_world(&w, VERIFY_WORLD_FILE, actual) != 0) {
+        free(tiles);
+        return 1;
+    }
+    compositor c;
+    if (init_compositor(&c, actual, compose_cpu_count() > 2 ? compose_cpu_count() : 2, 0) != 0) {
+        init_compositor(&c, actual, 1, 0);
+    }
+
+    camera view = {0, 0, LOGICAL_WIDTH, LOGICAL_HEIGHT};
+    long mismatches = 0;
+    double seconds = 0;
+    for (int frame = 0; frame < VERIFY_WORLD_FRAMES; frame++) {
+        // Out and back, with jumps now and then and both edges reached
+        int span = w.width - view.w;
+        int pass = frame * 2 * span / VERIFY_WORLD_FRAMES;
+        view.x = pass <= span ? pass : 2 * span - pass;
+        if (frame % 37 == 5) view.x = (int)(next_random(&seed) % (span + 1));
+        view.y = (int)(next_random(&seed) % (w.height - view.h + 1));
+        if (frame % 11 == 0) view.y = frame % 22 ? w.height - view.h : 0;
+
+        double start = clock_now();
+        stream_world(&w, &view);
+        if (frame % 2) {
+            paint_world(&w, &view, actual);
+        } else {
+            draw_world(&w, &view, &c);
+            compose_flush(&c);
+        }
+        seconds += clock_now() - start;
+
+        for (int ty = view.y / TILE_SIZE; ty <= (view.y + view.h - 1) / TILE_SIZE; ty++) {
+            for (int tx = view.x / TILE_SIZE; tx <= (view.x + view.w - 1) / TILE_SIZE; tx++) {
+                paint_tile(expected, tx * TILE_SIZE - view.x, ty * TILE_SIZE - view.y, tiles[ty * cols + tx], tx, ty);
+            }
+        }
+        mismatches = compare_world(expected, actual, frame, &view, mismatches);
+    }
+    Uint32 loads = w.loads, evictions = w.evictions;
+
+    // A level smaller than the view: past its edges both paths leave black, not the last frame
+    free_world(&w);
+    if (save_level(VERIFY_WORLD_FILE, tiles, 1, 1) != 0 || load_world(&w, VERIFY_WORLD_FILE, actual) != 0) {
+        mismatches++;
+    } else {
+        view.x = 0;
+        view.y = 0;
+        SDL_FillRect(expected, NULL, SDL_MapRGB(f, 0, 0, 0));
+        for (int ty = 0; ty < CHUNK_TILES; ty++) {
+            for (int tx = 0; tx < CHUNK_TILES; tx++) {
+                paint_tile(expected, tx * TILE_SIZE, ty * TILE_SIZE, tiles[ty * CHUNK_TILES + tx], tx, ty);
+            }
+        }
+        for (int frame = 0; frame < 2; frame++) {
+            fill_noise(actual, 31 + frame);
+            stream_world(&w, &view);
+            if (frame % 2) {
+                paint_world(&w, &view, actual);
+            } else {
+                draw_world(&w, &view, &c);
+                compose_flush(&c);
+            }
+            mismatches = compare_world(expected, actual, VERIFY_WORLD_FRAMES + frame, &view, mismatches);
+        }
+    }
+    printf("{\"verify_world\":%d,\"chunks\":%d,\"loads\":%u,\"evictions\":%u,\"ms_per_frame\":%.3f,"
+           "\"mismatches\":%ld}\n",
+           VERIFY_WORLD_FRAMES, VERIFY_WORLD_CHUNKS * VERIFY_WORLD_ROWS, loads, evictions,
+           seconds * 1000.0 / VERIFY_WORLD_FRAMES, mismatches);
+
+    free_compositor(&c);
+    free_world(&w);
+    remove(VERIFY_WORLD_FILE);
+    free(tiles);
+    SDL_FreeSurface(actual);
+    SDL_FreeSurface(expected);
+    return mismatches ? 1 : 0;
+}
+
+// A recorded session as a throughput benchmark and a regression check on its final state
+static int run_replay_file(const char *path) {
+    replay r;
+    match m;
+    if (load_replay(&r, path) != 0) return 1;
+    if (init_match(&m) != 0) {
+        free_replay(&r);
+        return 1;
+    }
+    m.player2_visible = r.player2_visible;
+    // Only the level's solid tiles matter here, but they come with the world
+    SDL_Surface *screen = SDL_SetVideoMode(LOGICAL_WIDTH, LOGICAL_HEIGHT, 32, SDL_SWSURFACE);
+    world level;
+    if (!screen || (load_world(&level, r.level[0] ? r.level : NULL, screen) != 0 && r.level[0])) {
+        LOG_ERROR(LOG_CORE, "Replay: can't load its level %s\n", r.level);
+        free_match(&m);
+        free_replay(&r);
+        return 1;
+    }
+    if (level.file) m.map = &level.solid;
+    if (check_replay_level(&r, m.map) != 0) {
+        free_world(&level);
+        free_match(&m);
+        free_replay(&r);
+        return 1;
+    }
+    engine_clock clock;
+    init_clock(&clock, r.tick_rate, 0);
+    double start = clock_now();
+    Uint32 diverged;
+    Uint32 hash = play_replay(&r, &m, &clock, 0, r.tick_count, &diverged);
+    double seconds = clock_now() - start;
+    printf("{\"replay\":\"%s\",\"ticks\":%u,\"seconds\":%.4f,\"ticks_per_s\":%.0f,\"hash\":\"%08x\","
+           "\"recorded\":\"%08x\",\"diverged_at\":%u,\"match\":%d}\n",
+           path, r.tick_count, seconds, seconds > 0 ? r.tick_count / seconds : 0.0, hash, r.final_hash, diverged,
+           hash == r.final_hash && !diverged);
+    int status = hash == r.final_hash && !diverged ? 0 : 1;
+    free_world(&level);
+    free_match(&m);
+    free_replay(&r);
+    return status;
+}
+
+// Draws particles through banded compositors and compares each frame with the same squares
+// filled one at a time, the view moving so bursts cross every edge. Counts what emitting,
+// moving and recording allocate, which must be nothing.
+#define VERIFY_EFFECTS_FRAMES 90
+#define VERIFY_EFFECTS_CAPACITY 20000
+
+static int verify_effects(void) {
+    SDL_Surface *screen = SDL_SetVideoMode(LOGICAL_WIDTH, LOGICAL_HEIGHT, 32, SDL_SWSURFACE);
+    if (!screen) {
+        LOG_ERROR(LOG_CORE, "Effects verify setup failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    SDL_PixelFormat *f = screen->format;
+    SDL_Surface *expected = SDL_CreateRGBSurface(SDL_SWSURFACE, LOGICAL_WIDTH, LOGICAL_HEIGHT, 32, f->Rmask, f->Gmask, f->Bmask, 0);
+    SDL_Surface *actual = SDL_CreateRGBSurface(SDL_SWSURFACE, LOGICAL_WIDTH, LOGICAL_HEIGHT, 32, f->Rmask, f->Gmask, f->Bmask, 0);
+    if (!expected || !actual) {
+        LOG_ERROR(LOG_CORE, "Effects verify setup failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    static const int band_heights[] = {1, 7, 32, 100};
+    int threads = compose_cpu_count() > 2 ? compose_cpu_count() : 2;
+    int cases = 0;
+    int peak = 0;
+    unsigned long allocs = 0;
+    long mismatches = 0;
+    for (int b = 0; b < (int)(sizeof(band_heights) / sizeof(band_heights[0])); b++) {
+        compositor c;
+        if (init_compositor(&c, actual, threads, band_heights[b]) != 0) init_compositor(&c, actual, 1, band_heights[b]);
+        effects fx;
+        if (init_effects(&fx, VERIFY_EFFECTS_CAPACITY, actual, c.band_height) != 0) {
+            free_compositor(&c);
+            return 1;
+        }
+        Uint32 seed = 31;
+        for (int frame = 0; frame < VERIFY_EFFECTS_FRAMES; frame++) {
+            int view_x = frame * 5 - 200;
+            int view_y = (frame % 30) * 4 - 60;
+            SDL_Rect area;
+            unsigned long before = alloc_count();
+            for (int k = 0; k < 6; k++) {
+                float x = (float)(view_x + (int)(next_random(&seed) % (LOGICAL_WIDTH + 80)) - 40);
+                float y = (float)(view_y + (int)(next_random(&seed) % (LOGICAL_HEIGHT + 80)) - 40);
+                if (k % 2) {
+                    emit_sparks(&fx, x, y, 60);
+                } else {
+                    emit_dust(&fx, x, y, 40, 30.0f);
+                }
+            }
+            update_effects(&fx, 1.0f / 60.0f);
+            int drawn = draw_effects(&fx, view_x, view_y, &c, &area);
+            allocs += alloc_count() - before;
+            if (fx.count > peak) peak = fx.count;
+
+            SDL_FillRect(actual, NULL, 0);
+            compose_flush(&c);
+            SDL_FillRect(expected, NULL, 0);
+            for (int i = 0; i < drawn; i++) {
+                SDL_Rect r = {fx.draw_x[i], fx.draw_y[i], fx.draw_size[i], fx.draw_size[i]};
+                SDL_FillRect(expected, &r, fx.draw_color[i]);
+            }
+            for (int y = 0; y < LOGICAL_HEIGHT; y++) {
+                const Uint32 *a = (const Uint32 *)((const Uint8 *)actual->pixels + y * actual->pitch);
+                const Uint32 *e = (const Uint32 *)((const Uint8 *)expected->pixels + y * expected->pitch);
+                for (int x = 0; x < LOGICAL_WIDTH; x++) {
+                    if (a[x] == e[x]) continue;
+                    if (mismatches < 10) {
+                        LOG_ERROR(LOG_CORE, "Effects mismatch: bands of %d, frame %d, at %d,%d\n", band_heights[b], frame, x, y);
+                    }
+                    mismatches++;
+                }
+            }
+            cases++;
+        }
+        free_effects(&fx);
+        free_compositor(&c);
+    }
+    printf("{\"verify_effects\":%d,\"threads\":%d,\"peak_particles\":%d,\"allocs\":%lu,\"mismatches\":%ld}\n", cases,
+           threads, peak, allocs, mismatches);
+    SDL_FreeSurface(actual);
+    SDL_FreeSurface(expected);
+    return mismatches || allocs ? 1 : 0;
+}
+
+// Checks the swept collision queries against moving the box a pixel at a time, on a random
+// map with boxes reaching past every edge of it
+#define VERIFY_COLLIDE_COLS 64
+#define VERIFY_COLLIDE_ROWS 48
+#define VERIFY_COLLIDE_CASES 200000
+
+static int tile_floor(int p) {
+    return p >= 0 ? p / TILE_SIZE : -((-p + TILE_SIZE - 1) / TILE_SIZE);
+}
+
+static int tile_ceil(int p) {
+    return -tile_floor(-p);
+}
+
+// Same edges as the collision map: solid past the sides and below, open above
+static int tile_blocks(const Uint8 *tiles, int col, int row) {
+    if (col < 0 || col >= VERIFY_COLLIDE_COLS || row >= VERIFY_COLLIDE_ROWS) return 1;
+    return row >= 0 && tiles[row * VERIFY_COLLIDE_COLS + col];
+}
+
+static int span_blocks(const Uint8 *tiles, int horizontal, int line, int a0, int a1) {
+    for (int t = tile_floor(a0); t <= tile_floor(a1 - 1); t++) {
+        if (horizontal ? tile_blocks(tiles, t, line) : tile_blocks(tiles, line, t)) return 1;
+    }
+    return 0;
+}
+
+// dir 0 down, 1 up, 2 right, 3 left
+static int stepped_move(const Uint8 *tiles, int dir, int a0, int a1, int edge, int d) {
+    for (int j = 1; j <= d; j++) {
+        int line;
+        switch (dir) {
+            case 0:
+                line = tile_floor(edge + j - 1);
+                if (line >= tile_ceil(edge) && span_blocks(tiles, 1, line, a0, a1)) return j - 1;
+                break;
+            case 1:
+                line = tile_floor(edge - j);
+                if (line < tile_floor(edge) && span_blocks(tiles, 1, line, a0, a1)) return j - 1;
+                break;
+            case 2:
+                line = tile_floor(edge + j - 1);
+                if (line >= tile_ceil(edge) && span_blocks(tiles, 0, line, a0, a1)) return j - 1;
+                break;
+            default:
+                line = tile_floor(edge - j);
+                if (line < tile_floor(edge) && span_blocks(tiles, 0, line, a0, a1)) return j - 1;
+                break;
+        }
+    }
+    return d;
+}
+
+static int verify_collide(void) {
+    Uint8 tiles[VERIFY_COLLIDE_COLS * VERIFY_COLLIDE_ROWS];
+    collision_map m;
+    if (init_collision(&m, VERIFY_COLLIDE_COLS, VERIFY_COLLIDE_ROWS) != 0) return 1;
+    Uint32 seed = 777;
+    for (int row = 0; row < VERIFY_COLLIDE_ROWS; row++) {
+        for (int col = 0; col < VERIFY_COLLIDE_COLS; col++) {
+            tiles[row * VERIFY_COLLIDE_COLS + col] = next_random(&seed) % 6 == 0;
+            if (tiles[row * VERIFY_COLLIDE_COLS + col]) set_solid(&m, col, row);
+        }
+    }
+
+    int w = VERIFY_COLLIDE_COLS * TILE_SIZE;
+    int h = VERIFY_COLLIDE_ROWS * TILE_SIZE;
+    long mismatches = 0;
+    double swept = 0, stepped = 0;
+    for (int i = 0; i < VERIFY_COLLIDE_CASES; i++) {
+        int dir = i % 4;
+        int x = (int)(next_random(&seed) % (w + 128)) - 64;
+        int y = (int)(next_random(&seed) % (h + 128)) - 64;
+        int size = 1 + (int)(next_random(&seed) % 80);
+        int d = (int)(next_random(&seed) % 120);
+        int a0 = dir < 2 ? x : y;
+        int edge = dir < 2 ? y : x;
+
+        double t0 = clock_now();
+        int got;
+        switch (dir) {
+            case 0: got = collide_down(&m, a0, a0 + size, edge, d); break;
+            case 1: got = collide_up(&m, a0, a0 + size, edge, d); break;
+            case 2: got = collide_right(&m, a0, a0 + size, edge, d); break;
+            default: got = collide_left(&m, a0, a0 + size, edge, d); break;
+        }
+        double t1 = clock_now();
+        int want = stepped_move(tiles, dir, a0, a0 + size, edge, d);
+        double t2 = clock_now();
+        swept += t1 - t0;
+        stepped += t2 - t1;
+        if (got == want) continue;
+        if (mismatches < 10) {
+            LOG_ERROR(LOG_CORE, "Collide mismatch: dir %d, span %d+%d, edge %d, d %d: got %d, want %d\n", dir, a0, size,
+                      edge, d, got, want);
+        }
+        mismatches++;
+    }
+    printf("{\"verify_collide\":%d,\"swept_ns\":%.1f,\"stepped_ns\":%.1f,\"mismatches\":%ld}\n",
+           VERIFY_COLLIDE_CASES, swept * 1e9 / VERIFY_COLLIDE_CASES, stepped * 1e9 / VERIFY_COLLIDE_CASES, mismatches);
+    free_collision(&m);
+    return mismatches ? 1 : 0;
+}
+
+static void usage(const char *name) {
+    printf("Usage: %s [--all] [--chars N] [--frames N] [--hud 0|1] [--fullscreen] [--store] [--dirty] [--combat] [--threads N] [--band-height N] [--sim-threads N] [--particles N] [--verify-blit] [--verify-masks] [--verify-scale] [--verify-compose] [--verify-jobs] [--verify-netplay] [--verify-replay] [--verify-world] [--verify-collide] [--verify-effects] [--replay FILE]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    bench_scenario single = {2, 1, 0, 600, 0, 0, 0, 1, COMPOSE_BAND_HEIGHT, 1};
+    int all = 0;
+    int verify = 0;
+    int verify_mask = 0;
+    int verify_scaler = 0;
+    int verify_compositor = 0;
+    int verify_job = 0;
+    int verify_net = 0;
+    int verify_rec = 0;
+    int verify_level = 0;
+    int verify_collision = 0;
+    int verify_particles = 0;
+    const char *replay_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--all") == 0) {
+            all = 1;
+        } else if (strcmp(argv[i], "--chars") == 0 && i + 1 < argc) {
+            single.chars = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            single.frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hud") == 0 && i + 1 < argc) {
+            single.hud = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fullscreen") == 0) {
+            single.fullscreen = 1;
+        } else if (strcmp(argv[i], "--store") == 0) {
+            single.store = 1;
+        } else if (strcmp(argv[i], "--dirty") == 0) {
+            single.dirty = 1;
+        } else if (strcmp(argv[i], "--combat") == 0) {
+            single.combat = 1;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            single.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--band-height") == 0 && i + 1 < argc) {
+            single.band_height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sim-threads") == 0 && i + 1 < argc) {
+            single.sim_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+            single.particles = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--verify-blit") == 0) {
+            verify = 1;
+        } else if (strcmp(argv[i], "--verify-masks") == 0) {
+            verify_mask = 1;
+        } else if (strcmp(argv[i], "--verify-scale") == 0) {
+            verify_scaler = 1;
+        } else if (strcmp(argv[i], "--verify-compose") == 0) {
+            verify_compositor = 1;
+        } else if (strcmp(argv[i], "--verify-jobs") == 0) {
+            verify_job = 1;
+        } else if (strcmp(argv[i], "--verify-netplay") == 0) {
+            verify_net = 1;
+        } else if (strcmp(argv[i], "--verify-replay") == 0) {
+            verify_rec = 1;
+        } else if (strcmp(argv[i], "--verify-world") == 0) {
+            verify_level = 1;
+        } else if (strcmp(argv[i], "--verify-collide") == 0) {
+            verify_collision = 1;
+        } else if (strcmp(argv[i], "--verify-effects") == 0) {
+            verify_particles = 1;
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (single.chars < 1 || single.frames < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Results go to stdout as JSON lines, so keep the log on stderr
+    log_set_stream(stderr);
+    SDL_putenv("SDL_VIDEODRIVER=dummy");
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        LOG_ERROR(LOG_CORE, "SDL_Init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    init_log(NULL);
+    if (TTF_Init() < 0 || !(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
+        LOG_ERROR(LOG_CORE, "SDL_ttf/SDL_image init failed: %s\n", SDL_GetError());
+        SDL_Quit();
+        return 1;
+    }
+    TTF_Font *font = TTF_OpenFont("arial.ttf", 20);
+    if (!font) {
+        LOG_ERROR(LOG_CORE, "Failed to load font: %s\n", TTF_GetError());
+        SDL_Quit();
+        return 1;
+    }
+
+    init_blit();
+    int status = 0;
+    if (verify || verify_mask || verify_scaler || verify_compositor || verify_job || verify_net || verify_rec || verify_level ||
+        verify_collision || verify_particles) {
+        if (verify) status |= verify_blit();
+        if (verify_mask) status |= verify_masks();
+        if (verify_scaler) status |= verify_scale();
+        if (verify_compositor) status |= verify_compose(font);
+        if (verify_job) status |= verify_jobs();
+        if (verify_net) status |= verify_netplay();
+        if (verify_rec) status |= verify_replay();
+        if (verify_level) status |= verify_world();
+        if (verify_collision) status |= verify_collide();
+        if (verify_particles) status |= verify_effects();
+    } else if (replay_path) {
+        status = run_replay_file(replay_path);
+    } else if (all) {
+        status = verify_blit() | verify_masks() | verify_scale() | verify_compose(font) | verify_jobs() | verify_netplay() | verify_replay() |
+                 verify_world() | verify_collide() | verify_effects();
+        static const int counts[] = {2, 64, 512};
+        for (int c = 0; c < 3; c++) {
+            for (int fullscreen = 0; fullscreen < 2; fullscreen++) {
+                for (int with_hud = 0; with_hud < 2; with_hud++) {
+                    for (int dirty = 0; dirty < 2; dirty++) {
+                        bench_scenario sc = {counts[c], with_hud, fullscreen, single.frames, 0, dirty, 0, 1, COMPOSE_BAND_HEIGHT, 1};
+                        run_scenario(&sc, font);
+                    }
+                }
+            }
+        }
+        static const int crowds[] = {512, 4096};
+        for (int c = 0; c < 2; c++) {
+            for (int combat = 0; combat < 2; combat++) {
+                bench_scenario sc = {crowds[c], 1, 1, single.frames, 1, 0, combat, 1, COMPOSE_BAND_HEIGHT, 1};
+                run_scenario(&sc, font);
+            }
+        }
+        // The largest crowd again, composed in bands across threads
+        int cpus = compose_cpu_count();
+        static const int band_heights[] = {16, 32, 64};
+        for (int threads = 2; threads <= cpus; threads *= 2) {
+            for (int b = 0; b < 3; b++) {
+                bench_scenario sc = {4096, 1, 1, single.frames, 1, 0, 0, threads, band_heights[b], 1};
+                run_scenario(&sc, font);
+            }
+        }
+        // Perso characters with combat, their update split across the job pool
+        for (int threads = 1; threads <= cpus; threads *= 2) {
+            bench_scenario sc = {512, 1, 0, single.frames, 0, 0, 1, 1, COMPOSE_BAND_HEIGHT, threads};
+            run_scenario(&sc, font);
+        }
+        // Effects at full screen, drawn in order and then in bands
+        static const int particle_counts[] = {10000, 50000};
+        for (int p = 0; p < 2; p++) {
+            for (int threads = 1; threads <= cpus; threads *= 2) {
+                bench_scenario sc = {64, 1, 1, single.frames, 0, 0, 1, threads, COMPOSE_BAND_HEIGHT, 1, particle_counts[p]};
+                run_scenario(&sc, font);
+            }
+        }
+    } else {
+        run_scenario(&single, font);
+    }
+
+    TTF_CloseFont(font);
+    close_pack();
+    IMG_Quit();
+    TTF_Quit();
+    SDL_Quit();
+    return status;
+}
@@ -0,0 +1,306 @@
+#include "blit.h"
+#include "log.h"
+#include <SDL/SDL.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BLIT_X86 1
+#endif
+
+typedef struct {
+    Uint32 rgb_mask; // Bits compared against the key and written when blending
+    Uint32 key;      // Colour key, already masked
+    int alpha_shift; // Per-pixel alpha position
+} blit_params;
+
+// Draws one clipped row. src is the first pixel in drawing order; mirrored rows read backwards from it
+typedef void (*blit_row_fn)(Uint32 *dst, const Uint32 *src, int w, int mirror, const blit_params *bp);
+
+static void key_row_scalar(Uint32 *dst, const Uint32 *src, int w, int mirror, const blit_params *bp) {
+    int step = mirror ? -1 : 1;
+    for (int x = 0; x < w; x++, src += step) {
+        Uint32 s = *src;
+        if ((s & bp->rgb_mask) != bp->key) dst[x] = s;
+    }
+}
+
+// Same result as SDL's d + ((s - d) * a >> 8), with opaque pixels copied exactly
+static void alpha_row_scalar(Uint32 *dst, const Uint32 *src, int w, int mirror, const blit_params *bp) {
+    int step = mirror ? -1 : 1;
+    for (int x = 0; x < w; x++, src += step) {
+        Uint32 s = *src;
+        Uint32 a = (s >> bp->alpha_shift) & 0xff;
+        if (a == 0) continue;
+        Uint32 d = dst[x];
+        Uint32 out = s;
+        if (a != 255) {
+            out = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                Uint32 sc = (s >> shift) & 0xff;
+                Uint32 dc = (d >> shift) & 0xff;
+                out |= ((sc * a + dc * (256 - a)) >> 8) << shift;
+            }
+        }
+        dst[x] = (out & bp->rgb_mask) | (d & ~bp->rgb_mask);
+    }
+}
+
+#ifdef BLIT_X86
+__attribute__((target("sse2")))
+static __m128i load_sse2(const Uint32 *src, int x, int mirror) {
+    if (!mirror) return _mm_loadu_si128((const __m128i *)(src + x));
+    return _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(src - x - 3)), _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+__attribute__((target("sse2")))
+static void key_row_sse2(Uint32 *dst, const Uint32 *src, int w, int mirror, const blit_params *bp) {
+    const __m128i mask = _mm_set1_epi32((int)bp->rgb_mask);
+    const __m128i key = _mm_set1_epi32((int)bp->key);
+    int x = 0;
+    for (; x + 4 <= w; x += 4) {
+        __m128i s = load_sse2(src, x, mirror);
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+        __m128i keyed = _mm_cmpeq_epi32(_mm_and_si128(s, mask), key);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(_mm_and_si128(keyed, d), _mm_andnot_si128(keyed, s)));
+    }
+    key_row_scalar(dst + x, mirror ? src - x : src + x, w - x, mirror, bp);
+}
+
+// (s * a + d * (256 - a)) >> 8 on 16-bit channels, which never exceeds 65280
+__attribute__((target("sse2")))
+static __m128i blend_sse2(__m128i s, __m128i d, __m128i a) {
+    __m128i inv = _mm_sub_epi16(_mm_set1_epi16(256), a);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, inv)), 8);
+}
+
+__attribute__((target("sse2")))
+static void alpha_row_sse2(Uint32 *dst, const Uint32 *src, int w, int mirror, const blit_params *bp) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i byte = _mm_set1_epi32(0xff);
+    const __m128i mask = _mm_set1_epi32((int)bp->rgb_mask);
+    const __m128i shift = _mm_cvtsi32_si128(bp->alpha_shift);
+    int x = 0;
+    for (; x + 4 <= w; x += 4) {
+        __m128i s = load_sse2(src, x, mirror);
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+        __m128i a = _mm_and_si128(_mm_srl_epi32(s, shift), byte);
+        __m128i a16 = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+        __m128i lo = blend_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi32(a16, a16));
+        __m128i hi = blend_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi32(a16, a16));
+        __m128i out = _mm_packus_epi16(lo, hi);
+        __m128i opaque = _mm_cmpeq_epi32(a, byte);
+        out = _mm_or_si128(_mm_and_si128(opaque, s), _mm_andnot_si128(opaque, out));
+        out = _mm_or_si128(_mm_and_si128(out, mask), _mm_andnot_si128(mask, d));
+        _mm_storeu_si128((__m128i *)(dst + x), out);
+    }
+    alpha_row_scalar(dst + x, mirror ? src - x : src + x, w - x, mirror, bp);
+}
+
+__attribute__((target("avx2")))
+static __m256i load_avx2(const Uint32 *src, int x, int mirror) {
+    if (!mirror) return _mm256_loadu_si256((const __m256i *)(src + x));
+    __m256i v = _mm256_loadu_si256((const __m256i *)(src - x - 7));
+    return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+__attribute__((target("avx2")))
+static void key_row_avx2(Uint32 *dst, const Uint32 *src, int w, int mirror, const blit_params *bp) {
+    const __m256i mask = _mm256_set1_epi32((int)bp->rgb_mask);
+    const __m256i key = _mm256_set1_epi32((int)bp->key);
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        __m256i s = load_avx2(src, x, mirror);
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + x));
+        __m256i keyed = _mm256_cmpeq_epi32(_mm256_and_si256(s, mask), key);
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_blendv_epi8(s, d, keyed));
+    }
+    // The tail runs legacy SSE code, which stalls while upper halves are dirty
+    _mm256_zeroupper();
+    key_row_sse2(dst + x, mirror ? src - x : src + x, w - x, mirror, bp);
+}
+
+__attribute__((target("avx2")))
+static __m256i blend_avx2(__m256i s, __m256i d, __m256i a) {
+    __m256i inv = _mm256_sub_epi16(_mm256_set1_epi16(256), a);
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(s, a), _mm256_mullo_epi16(d, inv)), 8);
+}
+
+// Unpacks work per 128-bit lane, so pixels and their alphas stay paired
+__attribute__((target("avx2")))
+static void alpha_row_avx2(Uint32 *dst, const Uint32 *src, int w, int mirror, const blit_params *bp) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i byte = _mm256_set1_epi32(0xff);
+    const __m256i mask = _mm256_set1_epi32((int)bp->rgb_mask);
+    const __m128i shift = _mm_cvtsi32_si128(bp->alpha_shift);
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        __m256i s = load_avx2(src, x, mirror);
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + x));
+        __m256i a = _mm256_and_si256(_mm256_srl_epi32(s, shift), byte);
+        __m256i a16 = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+        __m256i lo = blend_avx2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi32(a16, a16));
+        __m256i hi = blend_avx2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi32(a16, a16));
+        __m256i out = _mm256_packus_epi16(lo, hi);
+        out = _mm256_blendv_epi8(out, s, _mm256_cmpeq_epi32(a, byte));
+        out = _mm256_or_si256(_mm256_and_si256(out, mask), _mm256_andnot_si256(mask, d));
+        _mm256_storeu_si256((__m256i *)(dst + x), out);
+    }
+    _mm256_zeroupper();
+    alpha_row_sse2(dst + x, mirror ? src - x : src + x, w - x, mirror, bp);
+}
+#endif
+
+static const char *kernel_names[BLIT_KERNEL_COUNT] = {"scalar", "sse2", "avx2"};
+#ifdef BLIT_X86
+static const blit_row_fn key_rows[BLIT_KERNEL_COUNT] = {key_row_scalar, key_row_sse2, key_row_avx2};
+static const blit_row_fn alpha_rows[BLIT_KERNEL_COUNT] = {alpha_row_scalar, alpha_row_sse2, alpha_row_avx2};
+#else
+static const blit_row_fn key_rows[BLIT_KERNEL_COUNT] = {key_row_scalar, key_row_scalar, key_row_scalar};
+static const blit_row_fn alpha_rows[BLIT_KERNEL_COUNT] = {alpha_row_scalar, alpha_row_scalar, alpha_row_scalar};
+#endif
+static blit_kernel kernel = BLIT_SCALAR;
+static int kernel_chosen = 0;
+
+static int kernel_available(blit_kernel k) {
+#ifdef BLIT_X86
+    __builtin_cpu_init();
+    if (k == BLIT_AVX2) return __builtin_cpu_supports("avx2");
+    if (k == BLIT_SSE2) return __builtin_cpu_supports("sse2");
+#endif
+    return k == BLIT_SCALAR;
+}
+
+void init_blit(void) {
+    kernel = BLIT_SCALAR;
+    for (int k = BLIT_KERNEL_COUNT - 1; k > BLIT_SCALAR; k--) {
+        if (kernel_available((blit_kernel)k)) {
+            kernel = (blit_kernel)k;
+            break;
+        }
+    }
+    kernel_chosen = 1;
+    LOG_INFO(LOG_RENDER, "Sprite blit kernel: %s\n", kernel_names[kernel]);
+}
+
+int select_blit_kernel(blit_kernel k) {
+    if (k < 0 || k >= BLIT_KERNEL_COUNT || !kernel_available(k)) return -1;
+    kernel = k;
+    kernel_chosen = 1;
+    return 0;
+}
+
+blit_kernel current_blit_kernel(void) {
+    return kernel;
+}
+
+const char *blit_kernel_name(blit_kernel k) {
+    return k >= 0 && k < BLIT_KERNEL_COUNT ? kernel_names[k] : "unknown";
+}
+
+int blit_supported(SDL_Surface *src, SDL_Surface *dst) {
+    if (!src || !dst) return 0;
+    SDL_PixelFormat *s = src->format;
+    SDL_PixelFormat *d = dst->format;
+    if (s->BytesPerPixel != 4 || d->BytesPerPixel != 4) return 0;
+    if (s->Rmask != d->Rmask || s->Gmask != d->Gmask || s->Bmask != d->Bmask) return 0;
+    if (s->Amask && s->Amask != 0xffu << s->Ashift) return 0;
+    // Per-surface alpha stays with SDL
+    if ((src->flags & SDL_SRCALPHA) && !s->Amask) return 0;
+    return 1;
+}
+
+static int max_int(int a, int b) {
+    return a > b ? a : b;
+}
+
+int blit_sprite(SDL_Surface *src, const SDL_Rect *src_rect, SDL_Surface *dst, SDL_Rect *dst_rect, int mirror) {
+    if (!blit_supported(src, dst)) return -1;
+    if (!kernel_chosen) init_blit();
+
+    int sx = src_rect ? src_rect->x : 0;
+    int sy = src_rect ? src_rect->y : 0;
+    int w = src_rect ? src_rect->w : src->w;
+    int h = src_rect ? src_rect->h : src->h;
+    int dx = dst_rect ? dst_rect->x : 0;
+    int dy = dst_rect ? dst_rect->y : 0;
+
+    // Columns cut from each side of the destination, by the source bounds and the clip rect.
+    // A mirrored row draws the source's right edge first, so its source cuts swap sides.
+    const SDL_Rect *clip = &dst->clip_rect;
+    int cut_src_left = max_int(0, -sx);
+    int cut_src_right = max_int(0, sx + w - src->w);
+    int left = max_int(mirror ? cut_src_right : cut_src_left, clip->x - dx);
+    int right = max_int(mirror ? cut_src_left : cut_src_right, dx + w - (clip->x + clip->w));
+    int top = max_int(max_int(0, -sy), clip->y - dy);
+    int bottom = max_int(max_int(0, sy + h - src->h), dy + h - (clip->y + clip->h));
+    int out_w = w - left - right;
+    int out_h = h - top - bottom;
+    if (dst_rect) {
+        dst_rect->x = dx + left;
+        dst_rect->y = dy + top;
+        dst_rect->w = out_w > 0 ? out_w : 0;
+        dst_rect->h = out_h > 0 ? out_h : 0;
+    }
+    if (out_w <= 0 || out_h <= 0) return 0;
+
+    blit_params bp;
+    blit_row_fn row;
+    bp.rgb_mask = ~src->format->Amask;
+    bp.alpha_shift = src->format->Ashift;
+    if ((src->flags & SDL_SRCALPHA) && src->format->Amask) {
+        bp.key = 0;
+        row = alpha_rows[kernel];
+    } else if (src->flags & SDL_SRCCOLORKEY) {
+        bp.key = src->format->colorkey & bp.rgb_mask;
+        row = key_rows[kernel];
+    } else {
+        // Nothing matches this key, so every pixel is copied
+        bp.rgb_mask = 0;
+        bp.key = 1;
+        row = key_rows[kernel];
+    }
+
+    if (SDL_MUSTLOCK(src) && SDL_LockSurface(src) < 0) return -1;
+    if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) < 0) {
+        if (SDL_MUSTLOCK(src)) SDL_UnlockSurface(src);
+        return -1;
+    }
+
+    int first_col = mirror ? sx + w - 1 - left : sx + left;
+    const Uint8 *src_row = (const Uint8 *)src->pixels + (sy + top) * src->pitch + first_col * 4;
+    Uint8 *dst_row = (Uint8 *)dst->pixels + (dy + top) * dst->pitch + (dx + left) * 4;
+    for (int y = 0; y < out_h; y++) {
+        row((Uint32 *)dst_row, (const Uint32 *)src_row, out_w, mirror, &bp);
+        src_row += src->pitch;
+        dst_row += dst->pitch;
+    }
+
+    if (SDL_MUSTLOCK(dst)) SDL_UnlockSurface(dst);
+    if (SDL_MUSTLOCK(src)) SDL_UnlockSurface(src);
+    return 0;
+}
+
+int draw_sprite(const sprite_asset *sheet, int frame, int mirror, SDL_Surface *screen, SDL_Rect *dst_rect) {
+    const SDL_Rect *rect = &sheet->frames[frame];
+    if (!sheet->surface) {
+        // Still on the loader thread: a grey box holds the frame's place
+        dst_rect->w = rect->w;
+        dst_rect->h = rect->h;
+        return SDL_FillRect(screen, dst_rect, SDL_MapRGB(screen->format, 96, 96, 96));
+    }
+    // The runs only hold pixels in the sheet's format, which must also be the screen's
+    if (sheet->rle[frame] && blit_supported(sheet->surface, screen)) {
+        return blit_rle(sheet->rle[frame], screen, dst_rect, mirror);
+    }
+    if (blit_sprite(sheet->surface, rect, screen, dst_rect, mirror) == 0) return 0;
+
+    SDL_Rect src = *rect;
+    if (!mirror) return SDL_BlitSurface(sheet->surface, &src, screen, dst_rect);
+    if (!sheet->mirrored) {
+        SDL_SetError("%s has no mirrored sheet for this screen format", sheet->filename);
+        return -1;
+    }
+    // The mirrored sheet is flipped as a whole, so frames run right to left
+    src.x = sheet->mirrored->w - rect->x - rect->w;
+    return SDL_BlitSurface(sheet->mirrored, &src, screen, dst_rect);
+}
@@ -0,0 +1,29 @@
+#ifndef BLIT_H
+#define BLIT_H
+
+#include <SDL/SDL.h>
+#include "assets.h"
+
+typedef enum {
+    BLIT_SCALAR,
+    BLIT_SSE2,
+    BLIT_AVX2,
+    BLIT_KERNEL_COUNT
+} blit_kernel;
+
+void init_blit(void); // Picks the widest kernel the CPU supports
+int select_blit_kernel(blit_kernel k); // -1 if the CPU lacks it
+blit_kernel current_blit_kernel(void);
+const char* blit_kernel_name(blit_kernel k);
+
+// 32-bit surfaces with the same RGB layout, keyed or with per-pixel alpha
+int blit_supported(SDL_Surface* src, SDL_Surface* dst);
+
+// Like SDL_BlitSurface, mirroring the source rect when asked; -1 if !blit_supported
+int blit_sprite(SDL_Surface* src, const SDL_Rect* src_rect, SDL_Surface* dst, SDL_Rect* dst_rect, int mirror);
+
+// Draws one of sheet->frames: from its runs when encoded, else with blit_sprite,
+// else through SDL and the mirrored sheet; a placeholder while the sheet loads
+int draw_sprite(const sprite_asset* sheet, int frame, int mirror, SDL_Surface* screen, SDL_Rect* dst_rect);
+
+#endif
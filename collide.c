@@ -0,0 +1,149 @@
+#include "collide.h"
+#include "scale.h"
+#include "log.h"
+#include <SDL/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCREEN_COLS (LOGICAL_WIDTH / TILE_SIZE)
+#define SCREEN_ROWS ((LOGICAL_HEIGHT + TILE_SIZE - 1) / TILE_SIZE)
+#define SCREEN_WORDS ((SCREEN_ROWS + 31) / 32)
+
+int init_collision(collision_map *m, int cols, int rows) {
+    m->cols = cols;
+    m->rows = rows;
+    m->words = (rows + 31) / 32;
+    m->bits = calloc((size_t)cols * m->words, sizeof(Uint32));
+    if (!m->bits) {
+        LOG_ERROR(LOG_PHYSICS, "Out of memory for a %dx%d collision map\n", cols, rows);
+        return -1;
+    }
+    return 0;
+}
+
+void set_solid(collision_map *m, int col, int row) {
+    m->bits[col * m->words + row / 32] |= 1u << (row % 32);
+}
+
+const collision_map *screen_collision(void) {
+    static Uint32 bits[SCREEN_COLS * SCREEN_WORDS];
+    static collision_map screen = {SCREEN_COLS, SCREEN_ROWS, SCREEN_WORDS, bits};
+    static int built = 0;
+    if (!built) {
+        built = 1;
+        for (int c = 0; c < SCREEN_COLS; c++) {
+            for (int r = LEVEL_GROUND_ROW; r < SCREEN_ROWS; r++) {
+                set_solid(&screen, c, r);
+            }
+        }
+    }
+    return &screen;
+}
+
+Uint32 hash_collision(const collision_map *m) {
+    Uint32 hash = 2166136261u;
+    Uint32 size[2] = {(Uint32)m->cols, (Uint32)m->rows};
+    const Uint8 *bytes = (const Uint8 *)size;
+    for (size_t i = 0; i < sizeof(size); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    bytes = (const Uint8 *)m->bits;
+    for (size_t i = 0; i < (size_t)m->cols * m->words * sizeof(Uint32); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void free_collision(collision_map *m) {
+    free(m->bits);
+    memset(m, 0, sizeof(*m));
+}
+
+static int floor_div(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static int ceil_div(int a, int b) {
+    return -floor_div(-a, b);
+}
+
+// First solid row of col in [r0, r1], r1 + 1 if none
+static int first_solid(const collision_map *m, int col, int r0, int r1) {
+    if (col < 0 || col >= m->cols) return r0 <= r1 ? r0 : r1 + 1; // The sides go up forever
+    if (r0 < 0) r0 = 0;
+    if (r0 > r1) return r1 + 1;
+    if (r0 >= m->rows) return r0;
+    const Uint32 *column = m->bits + col * m->words;
+    int last = r1 < m->rows - 1 ? r1 : m->rows - 1;
+    for (int r = r0; r <= last; r = (r / 32 + 1) * 32) {
+        Uint32 word = column[r / 32] >> (r % 32);
+        if (word) {
+            int hit = r + __builtin_ctz(word);
+            if (hit <= last) return hit;
+            break;
+        }
+    }
+    return r1 >= m->rows ? m->rows : r1 + 1;
+}
+
+// Last solid row of col in [r0, r1], r0 - 1 if none
+static int last_solid(const collision_map *m, int col, int r0, int r1) {
+    if (r0 > r1) return r0 - 1;
+    if (col < 0 || col >= m->cols || r1 >= m->rows) return r1;
+    if (r1 < 0) return r0 - 1;
+    const Uint32 *column = m->bits + col * m->words;
+    int first = r0 > 0 ? r0 : 0;
+    for (int r = r1; r >= first; r = (r / 32) * 32 - 1) {
+        Uint32 word = column[r / 32] & (0xffffffffu >> (31 - r % 32));
+        if (word) {
+            int hit = (r / 32) * 32 + 31 - __builtin_clz(word);
+            if (hit >= first) return hit;
+            break;
+        }
+    }
+    return r0 - 1;
+}
+
+int collide_down(const collision_map *m, int x0, int x1, int bottom, int d) {
+    if (d <= 0) return 0;
+    int r0 = ceil_div(bottom, TILE_SIZE);
+    int r1 = floor_div(bottom + d, TILE_SIZE);
+    int best = r1 + 1;
+    for (int c = floor_div(x0, TILE_SIZE); c <= floor_div(x1 - 1, TILE_SIZE); c++) {
+        int r = first_solid(m, c, r0, best - 1);
+        if (r < best) best = r;
+    }
+    return best <= r1 ? best * TILE_SIZE - bottom : d;
+}
+
+int collide_up(const collision_map *m, int x0, int x1, int top, int d) {
+    if (d <= 0) return 0;
+    int r0 = ceil_div(top - d, TILE_SIZE) - 1;
+    int r1 = floor_div(top, TILE_SIZE) - 1;
+    int best = r0 - 1;
+    for (int c = floor_div(x0, TILE_SIZE); c <= floor_div(x1 - 1, TILE_SIZE); c++) {
+        int r = last_solid(m, c, best + 1 > r0 ? best + 1 : r0, r1);
+        if (r > best) best = r;
+    }
+    return best >= r0 ? top - (best + 1) * TILE_SIZE : d;
+}
+
+int collide_right(const collision_map *m, int y0, int y1, int right, int d) {
+    if (d <= 0) return 0;
+    int r0 = floor_div(y0, TILE_SIZE);
+    int r1 = floor_div(y1 - 1, TILE_SIZE);
+    for (int c = ceil_div(right, TILE_SIZE); c <= floor_div(right + d, TILE_SIZE); c++) {
+        if (first_solid(m, c, r0, r1) <= r1) return c * TILE_SIZE - right;
+    }
+    return d;
+}
+
+int collide_left(const collision_map *m, int y0, int y1, int left, int d) {
+    if (d <= 0) return 0;
+    int r0 = floor_div(y0, TILE_SIZE);
+    int r1 = floor_div(y1 - 1, TILE_SIZE);
+    for (int c = floor_div(left, TILE_SIZE) - 1; c >= ceil_div(left - d, TILE_SIZE) - 1; c--) {
+        if (first_solid(m, c, r0, r1) <= r1) return left - (c + 1) * TILE_SIZE;
+    }
+    return d;
+}
@@ -0,0 +1,33 @@
+#ifndef COLLIDE_H
+#define COLLIDE_H
+
+#include <SDL/SDL.h>
+#include "level.h"
+
+#define TILE_SOLID(t) ((t) >= TILE_GRASS && (t) <= TILE_BRICK)
+
+// Which level tiles stop a character, one bit per tile, built once when the level loads so
+// the simulation never depends on what the renderer has streamed in. Columns are stored
+// whole so a fall scans one run of words. Past the sides, at any height, and below the
+// bottom is solid; above the top is open.
+typedef struct {
+    int cols, rows;
+    int words;    // Per column
+    Uint32* bits; // Column by column, bit r % 32 of word r / 32 set when row r is solid
+} collision_map;
+
+int init_collision(collision_map* m, int cols, int rows); // Everything open
+void set_solid(collision_map* m, int col, int row);
+const collision_map* screen_collision(void); // The single-screen arena: a floor under GROUND_LEVEL
+Uint32 hash_collision(const collision_map* m); // Of the size and solid tiles, to tell levels apart
+void free_collision(collision_map* m);
+
+// Swept moves of a box edge, in pixels: each checks every tile between the edge and where it
+// would end up, so no speed passes through a wall, and returns how far of d the box can go.
+// A box already overlapping a tile is only stopped by the ones ahead of it.
+int collide_down(const collision_map* m, int x0, int x1, int bottom, int d); // Box spans columns [x0, x1)
+int collide_up(const collision_map* m, int x0, int x1, int top, int d);
+int collide_right(const collision_map* m, int y0, int y1, int right, int d); // Box spans rows [y0, y1)
+int collide_left(const collision_map* m, int y0, int y1, int left, int d);
+
+#endif
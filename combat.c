@@ -0,0 +1,254 @@
+#include "combat.h"
+#include "log.h"
+#include "profile.h"
+#include <SDL/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+int init_combat(combat_grid *g, int capacity) {
+    memset(g, 0, sizeof(*g));
+    g->bodies = calloc(capacity, sizeof(combat_body));
+    g->cell = malloc(capacity * sizeof(int));
+    g->next = malloc(capacity * sizeof(int));
+    g->prev = malloc(capacity * sizeof(int));
+    if (!g->bodies || !g->cell || !g->next || !g->prev) {
+        LOG_ERROR(LOG_PHYSICS, "Out of memory for a combat grid of %d bodies\n", capacity);
+        free_combat(g);
+        return -1;
+    }
+    g->capacity = capacity;
+    for (int i = 0; i < capacity; i++) {
+        g->cell[i] = -1;
+    }
+    for (int i = 0; i < COMBAT_COLS * COMBAT_ROWS; i++) {
+        g->heads[i] = -1;
+    }
+    return 0;
+}
+
+void free_combat(combat_grid *g) {
+    free(g->bodies);
+    free(g->cell);
+    free(g->next);
+    free(g->prev);
+    for (int t = 0; t < MAX_JOB_THREADS; t++) {
+        free(g->thread_hits[t]);
+    }
+    free(g->batches);
+    memset(g, 0, sizeof(*g));
+}
+
+static int axis_cell(int centre, int count) {
+    int c = centre >= 0 ? centre / COMBAT_CELL : -1;
+    if (c < 0) return 0;
+    return c < count ? c : count - 1;
+}
+
+static int box_cell(const SDL_Rect *r) {
+    return axis_cell(r->y + r->h / 2, COMBAT_ROWS) * COMBAT_COLS + axis_cell(r->x + r->w / 2, COMBAT_COLS);
+}
+
+static void unlink_body(combat_grid *g, int id) {
+    int cell = g->cell[id];
+    if (cell < 0) return;
+    if (g->prev[id] >= 0) {
+        g->next[g->prev[id]] = g->next[id];
+    } else {
+        g->heads[cell] = g->next[id];
+    }
+    if (g->next[id] >= 0) g->prev[g->next[id]] = g->prev[id];
+    g->cell[id] = -1;
+}
+
+void set_combat_body(combat_grid *g, int id, const combat_body *b) {
+    g->bodies[id] = *b;
+    int cell = b->hurt.w > 0 ? box_cell(&b->hurt) : -1;
+    if (cell == g->cell[id]) return;
+
+    unlink_body(g, id);
+    if (cell < 0) return;
+    g->cell[id] = cell;
+    g->prev[id] = -1;
+    g->next[id] = g->heads[cell];
+    if (g->heads[cell] >= 0) g->prev[g->heads[cell]] = id;
+    g->heads[cell] = id;
+    g->moves++;
+}
+
+void remove_combat_body(combat_grid *g, int id) {
+    unlink_body(g, id);
+    memset(&g->bodies[id], 0, sizeof(combat_body));
+}
+
+static void place_box(const SDL_Rect *box, const SDL_Rect *frame, int x, int y, int mirror, SDL_Rect *out) {
+    if (box->w == 0) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    out->x = x + (mirror ? frame->w - box->x - box->w : box->x);
+    out->y = y + box->y;
+    out->w = box->w;
+    out->h = box->h;
+}
+
+void anim_combat_body(const anim_library *lib, const anim_state *a, int x, int y, int mirror, combat_body *out) {
+    const anim_clip *c = &lib->clips[a->clip];
+    const SDL_Rect *frame = &c->frames[a->frame];
+    place_box(&c->hurtbox, frame, x, y, mirror, &out->hurt);
+    place_box(&c->hitboxes[a->frame], frame, x, y, mirror, &out->hit);
+    out->mask = c->sheet->masks[c->sheet_frames[a->frame]];
+    out->x = x;
+    out->y = y;
+    out->mirror = mirror;
+}
+
+static int overlap(const SDL_Rect *a, const SDL_Rect *b) {
+    return a->x < b->x + b->w && b->x < a->x + a->w && a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+// The boxes overlap; do the attacker's pixels in the hitbox touch the target's in its hurtbox?
+static int pixels_touch(const combat_body *a, const combat_body *t) {
+    if (!a->mask || !t->mask) return 1; // Sheets still loading: the boxes decide
+    SDL_Rect clip;
+    clip.x = a->hit.x > t->hurt.x ? a->hit.x : t->hurt.x;
+    clip.y = a->hit.y > t->hurt.y ? a->hit.y : t->hurt.y;
+    clip.w = (a->hit.x + a->hit.w < t->hurt.x + t->hurt.w ? a->hit.x + a->hit.w : t->hurt.x + t->hurt.w) - clip.x;
+    clip.h = (a->hit.y + a->hit.h < t->hurt.y + t->hurt.h ? a->hit.y + a->hit.h : t->hurt.y + t->hurt.h) - clip.y;
+    return masks_overlap(a->mask, a->x, a->y, a->mirror, t->mask, t->x, t->y, t->mirror, &clip);
+}
+
+// What one run over a range of attackers found
+struct combat_batch {
+    int thread;
+    int start; // First hit in that thread's buffer
+    int count;
+    int overflow; // Found more than max_hits; the rest were dropped
+    int failed;   // No room in the thread's buffer, so the merge redoes it
+    Uint32 pairs;
+    Uint32 rejects;
+};
+
+// Hitboxes of attackers [first, last) in id order, stopping after max_hits. Reads the grid only.
+static int resolve_range(const combat_grid *g, int first, int last, combat_hit *hits, int max_hits,
+                         struct combat_batch *out) {
+    int count = 0;
+    out->pairs = 0;
+    out->rejects = 0;
+    out->overflow = 0;
+    for (int a = first; a < last; a++) {
+        const SDL_Rect *hit = &g->bodies[a].hit;
+        if (hit->w == 0) continue;
+
+        int cell = box_cell(hit);
+        int row = cell / COMBAT_COLS, col = cell % COMBAT_COLS;
+        for (int r = row - 1; r <= row + 1; r++) {
+            if (r < 0 || r >= COMBAT_ROWS) continue;
+            for (int c = col - 1; c <= col + 1; c++) {
+                if (c < 0 || c >= COMBAT_COLS) continue;
+                for (int t = g->heads[r * COMBAT_COLS + c]; t >= 0; t = g->next[t]) {
+                    if (t == a) continue;
+                    out->pairs++;
+                    if (!overlap(hit, &g->bodies[t].hurt)) continue;
+                    if (!pixels_touch(&g->bodies[a], &g->bodies[t])) {
+                        out->rejects++;
+                        continue;
+                    }
+                    if (count == max_hits) {
+                        out->overflow = 1;
+                        return count;
+                    }
+                    hits[count].attacker = a;
+                    hits[count].target = t;
+                    count++;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+int resolve_combat(combat_grid *g, combat_hit *hits, int max_hits) {
+    struct combat_batch b;
+    int count = resolve_range(g, 0, g->capacity, hits, max_hits, &b);
+    g->candidate_pairs = b.pairs;
+    g->mask_rejects = b.rejects;
+    if (b.overflow) {
+        LOG_WARN(LOG_PHYSICS, "Warning: more than %d hits in one tick, dropping the rest\n", max_hits);
+    }
+    PROF_COUNT(PROF_PAIRS, g->candidate_pairs);
+    return count;
+}
+
+typedef struct {
+    combat_grid *grid;
+    int max_hits;
+} combat_job;
+
+static void resolve_batch(void *user, int batch, int first, int last, int thread) {
+    combat_job *job = user;
+    combat_grid *g = job->grid;
+    struct combat_batch *b = &g->batches[batch];
+    b->thread = thread;
+    b->start = g->thread_used[thread];
+    b->count = 0;
+    b->failed = 0;
+
+    // Room for a full batch; none can keep more than max_hits
+    int needed = g->thread_used[thread] + job->max_hits;
+    if (needed > g->thread_capacity[thread]) {
+        int capacity = g->thread_capacity[thread] * 2 > needed ? g->thread_capacity[thread] * 2 : needed;
+        combat_hit *grown = realloc(g->thread_hits[thread], capacity * sizeof(combat_hit));
+        if (!grown) {
+            b->failed = 1;
+            return;
+        }
+        g->thread_hits[thread] = grown;
+        g->thread_capacity[thread] = capacity;
+    }
+    b->count = resolve_range(g, first, last, g->thread_hits[thread] + b->start, job->max_hits, b);
+    g->thread_used[thread] += b->count;
+}
+
+int resolve_combat_jobs(combat_grid *g, job_pool *pool, combat_hit *hits, int max_hits) {
+    int batch_count = (g->capacity + JOB_BATCH_SIZE - 1) / JOB_BATCH_SIZE;
+    if (pool->threads == 1 || batch_count <= 1) return resolve_combat(g, hits, max_hits);
+    if (batch_count > g->batch_capacity) {
+        struct combat_batch *grown = realloc(g->batches, batch_count * sizeof(*grown));
+        if (!grown) return resolve_combat(g, hits, max_hits);
+        g->batches = grown;
+        g->batch_capacity = batch_count;
+    }
+    memset(g->thread_used, 0, sizeof(g->thread_used));
+
+    combat_job job = {g, max_hits};
+    run_jobs(pool, g->capacity, JOB_BATCH_SIZE, resolve_batch, &job);
+
+    // Batches back in attacker order, so the hits come out as resolve_combat lists them
+    int count = 0;
+    int overflow = 0;
+    g->candidate_pairs = 0;
+    g->mask_rejects = 0;
+    for (int i = 0; i < batch_count && !overflow; i++) {
+        struct combat_batch *b = &g->batches[i];
+        if (b->failed) {
+            int first = i * JOB_BATCH_SIZE;
+            int last = first + JOB_BATCH_SIZE < g->capacity ? first + JOB_BATCH_SIZE : g->capacity;
+            b->count = resolve_range(g, first, last, hits + count, max_hits - count, b);
+            count += b->count;
+        } else {
+            int room = max_hits - count;
+            int taken = b->count < room ? b->count : room;
+            memcpy(hits + count, g->thread_hits[b->thread] + b->start, taken * sizeof(combat_hit));
+            count += taken;
+            if (b->count > room) b->overflow = 1;
+        }
+        overflow = b->overflow;
+        g->candidate_pairs += b->pairs;
+        g->mask_rejects += b->rejects;
+    }
+    if (overflow) {
+        LOG_WARN(LOG_PHYSICS, "Warning: more than %d hits in one tick, dropping the rest\n", max_hits);
+    }
+    PROF_COUNT(PROF_PAIRS, g->candidate_pairs);
+    return count;
+}
@@ -0,0 +1,59 @@
+#ifndef COMBAT_H
+#define COMBAT_H
+
+#include <SDL/SDL.h>
+#include "anim.h"
+#include "jobs.h"
+
+// Uniform grid over the world; positions past its edges share the border cells
+#define COMBAT_CELL MAX_BOX_SIZE
+#define COMBAT_COLS 32
+#define COMBAT_ROWS 16
+#define MAX_COMBAT_HITS 256 // Per resolve_combat call
+
+// Boxes of one character in world space; w=0 when absent
+typedef struct {
+    SDL_Rect hurt;
+    SDL_Rect hit;
+    const sprite_mask* mask; // Current frame's pixels, NULL until its sheet loads
+    int x, y, mirror;        // Where that frame is drawn
+} combat_body;
+
+typedef struct {
+    int attacker;
+    int target;
+} combat_hit;
+
+// Hurtboxes filed by the cell of their centre. No box is larger than a cell, so a
+// hitbox can only touch hurtboxes filed in the 3x3 cells around its own centre.
+typedef struct {
+    int capacity;
+    combat_body* bodies;
+    int* cell; // Where each body is filed, -1 when it isn't
+    int* next; // Per-cell doubly linked lists
+    int* prev;
+    int heads[COMBAT_COLS * COMBAT_ROWS];
+    Uint32 candidate_pairs; // Narrow-phase tests in the last resolve_combat
+    Uint32 mask_rejects;    // Of those, boxes that overlapped but pixels that didn't
+    Uint32 moves;           // Bodies refiled since init, the incremental rebuild's cost
+
+    // Scratch for resolve_combat_jobs, kept between ticks
+    combat_hit* thread_hits[MAX_JOB_THREADS]; // Each thread's hits, batch after batch
+    int thread_used[MAX_JOB_THREADS];
+    int thread_capacity[MAX_JOB_THREADS];
+    struct combat_batch* batches;
+    int batch_capacity;
+} combat_grid;
+
+int init_combat(combat_grid* g, int capacity);
+void free_combat(combat_grid* g);
+void set_combat_body(combat_grid* g, int id, const combat_body* b); // Refiles only when the cell changes
+void remove_combat_body(combat_grid* g, int id);
+// Boxes and mask of the current frame at (x, y), mirrored when facing left
+void anim_combat_body(const anim_library* lib, const anim_state* a, int x, int y, int mirror, combat_body* out);
+int resolve_combat(combat_grid* g, combat_hit* hits, int max_hits); // Every hitbox against every other hurtbox
+// Same hits in the same order, attackers split into batches across the pool. The grid
+// must not change until it returns.
+int resolve_combat_jobs(combat_grid* g, job_pool* pool, combat_hit* hits, int max_hits);
+
+#endif
@@ -0,0 +1,337 @@
+#include "compose.h"
+#include "blit.h"
+#include "log.h"
+#include "profile.h"
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int compose_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) return 1;
+    return n < MAX_COMPOSE_THREADS ? (int)n : MAX_COMPOSE_THREADS;
+}
+
+// Straight stores on 32-bit targets, which is most of them; SDL_FillRect per square otherwise
+static int draw_squares(const square_batch *s, SDL_Surface *dst, int y0) {
+    const SDL_Rect *clip = &dst->clip_rect;
+    int clip_x1 = clip->x + clip->w;
+    int clip_y1 = clip->y + clip->h;
+    if (dst->format->BytesPerPixel != 4) {
+        for (int i = 0; i < s->count; i++) {
+            SDL_Rect r = {s->x[i], s->y[i] - y0, s->size[i], s->size[i]};
+            SDL_FillRect(dst, &r, s->color[i]);
+        }
+        return 0;
+    }
+    if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) < 0) return -1;
+    for (int i = 0; i < s->count; i++) {
+        int x0 = s->x[i];
+        int top = s->y[i] - y0;
+        int x1 = x0 + s->size[i];
+        int bottom = top + s->size[i];
+        if (x0 < clip->x) x0 = clip->x;
+        if (top < clip->y) top = clip->y;
+        if (x1 > clip_x1) x1 = clip_x1;
+        if (bottom > clip_y1) bottom = clip_y1;
+        Uint32 color = s->color[i];
+        Uint8 *row = (Uint8 *)dst->pixels + top * dst->pitch;
+        for (int y = top; y < bottom; y++, row += dst->pitch) {
+            for (int x = x0; x < x1; x++) {
+                ((Uint32 *)row)[x] = color;
+            }
+        }
+    }
+    if (SDL_MUSTLOCK(dst)) SDL_UnlockSurface(dst);
+    return 0;
+}
+
+// Draws one command into dst, whose first row is target row y0
+static int run_cmd(const compose_cmd *cmd, SDL_Surface *dst, int y0) {
+    SDL_Rect r = cmd->dst;
+    r.y -= y0;
+    switch (cmd->kind) {
+        case COMPOSE_SPRITE:
+            return draw_sprite(cmd->sheet, cmd->frame, cmd->mirror, dst, &r);
+        case COMPOSE_BLIT: {
+            SDL_Rect src = cmd->src_rect;
+            if (blit_sprite(cmd->src, &src, dst, &r, 0) == 0) return 0;
+            return SDL_BlitSurface(cmd->src, &src, dst, &r);
+        }
+        case COMPOSE_SQUARES:
+            return draw_squares(cmd->squares, dst, y0);
+        default:
+            return SDL_FillRect(dst, &r, cmd->color);
+    }
+}
+
+static void run_bands(compositor *c) {
+    for (;;) {
+        SDL_mutexP(c->lock);
+        int b = c->next_band++;
+        SDL_mutexV(c->lock);
+        if (b >= c->band_count) return;
+        for (int i = c->band_first[b]; i < c->band_first[b + 1]; i++) {
+            if (run_cmd(&c->cmds[c->binned[i]], c->bands[b], b * c->band_height) != 0) {
+                LOG_DEBUG(LOG_RENDER, "Compose: command %d failed in band %d\n", c->binned[i], b);
+            }
+        }
+    }
+}
+
+static int compose_worker(void *data) {
+    compositor *c = data;
+    Uint32 seen = 0;
+    SDL_mutexP(c->lock);
+    for (;;) {
+        while (!c->quitting && c->generation == seen) {
+            SDL_CondWait(c->wake, c->lock);
+        }
+        if (c->quitting) break;
+        seen = c->generation;
+        SDL_mutexV(c->lock);
+        run_bands(c);
+        SDL_mutexP(c->lock);
+        if (--c->busy == 0) SDL_CondSignal(c->idle);
+    }
+    SDL_mutexV(c->lock);
+    return 0;
+}
+
+int init_compositor(compositor *c, SDL_Surface *target, int threads, int band_height) {
+    memset(c, 0, sizeof(*c));
+    c->target = target;
+    c->threads = threads < 1 ? 1 : threads > MAX_COMPOSE_THREADS ? MAX_COMPOSE_THREADS : threads;
+    c->band_height = band_height > 0 ? band_height : COMPOSE_BAND_HEIGHT;
+    c->band_count = (target->h + c->band_height - 1) / c->band_height;
+    if (c->threads == 1) {
+        LOG_INFO(LOG_RENDER, "Compositor: drawing on the main thread\n");
+        return 0;
+    }
+
+    c->cmds = malloc(MAX_COMPOSE_CMDS * sizeof(compose_cmd));
+    c->bands = calloc(c->band_count, sizeof(SDL_Surface *));
+    c->band_first = malloc((c->band_count + 1) * sizeof(int));
+    c->lock = SDL_CreateMutex();
+    c->wake = SDL_CreateCond();
+    c->idle = SDL_CreateCond();
+    if (!c->cmds || !c->bands || !c->band_first || !c->lock || !c->wake || !c->idle) {
+        LOG_ERROR(LOG_RENDER, "Out of memory for a %d-band compositor\n", c->band_count);
+        free_compositor(c);
+        return -1;
+    }
+    SDL_PixelFormat *f = target->format;
+    for (int b = 0; b < c->band_count; b++) {
+        int y = b * c->band_height;
+        int rows = target->h - y < c->band_height ? target->h - y : c->band_height;
+        c->bands[b] = SDL_CreateRGBSurfaceFrom((Uint8 *)target->pixels + y * target->pitch, target->w, rows,
+                                               f->BitsPerPixel, target->pitch, f->Rmask, f->Gmask, f->Bmask, f->Amask);
+        if (!c->bands[b]) {
+            LOG_ERROR(LOG_RENDER, "Failed to create compositor band %d: %s\n", b, SDL_GetError());
+            free_compositor(c);
+            return -1;
+        }
+    }
+
+    int started = 0;
+    for (int i = 0; i < c->threads - 1; i++) {
+        c->workers[i] = SDL_CreateThread(compose_worker, c);
+        if (!c->workers[i]) {
+            LOG_WARN(LOG_RENDER, "Warning: compositor worker failed to start: %s\n", SDL_GetError());
+            break;
+        }
+        started++;
+    }
+    c->threads = started + 1;
+    LOG_INFO(LOG_RENDER, "Compositor: %d threads, %d bands of %d rows\n", c->threads, c->band_count, c->band_height);
+    return 0;
+}
+
+static int deferred(const compositor *c) {
+    return c->cmds != NULL;
+}
+
+static compose_cmd *record(compositor *c) {
+    if (c->count == MAX_COMPOSE_CMDS) compose_flush(c);
+    return &c->cmds[c->count++];
+}
+
+int compose_sprite(compositor *c, const sprite_asset *sheet, int frame, int mirror, SDL_Rect *dst) {
+    dst->w = sheet->frames[frame].w;
+    dst->h = sheet->frames[frame].h;
+    PROF_COUNT(PROF_BLITS, 1);
+    if (!deferred(c)) return draw_sprite(sheet, frame, mirror, c->target, dst);
+
+    // Sheets the kernels can't draw go through SDL's blitter
+    if (sheet->surface && !blit_supported(sheet->surface, c->target)) c->serial = 1;
+    compose_cmd *cmd = record(c);
+    cmd->kind = COMPOSE_SPRITE;
+    cmd->dst = *dst;
+    cmd->sheet = sheet;
+    cmd->frame = frame;
+    cmd->mirror = mirror;
+    return 0;
+}
+
+int compose_blit(compositor *c, SDL_Surface *src, const SDL_Rect *src_rect, int x, int y) {
+    compose_cmd tmp;
+    compose_cmd *cmd = deferred(c) ? record(c) : &tmp;
+    cmd->kind = COMPOSE_BLIT;
+    cmd->src = src;
+    if (src_rect) {
+        cmd->src_rect = *src_rect;
+    } else {
+        cmd->src_rect.x = 0;
+        cmd->src_rect.y = 0;
+        cmd->src_rect.w = src->w;
+        cmd->src_rect.h = src->h;
+    }
+    cmd->dst.x = x;
+    cmd->dst.y = y;
+    cmd->dst.w = cmd->src_rect.w;
+    cmd->dst.h = cmd->src_rect.h;
+    if (!deferred(c)) return run_cmd(cmd, c->target, 0);
+    if (!blit_supported(src, c->target)) c->serial = 1;
+    return 0;
+}
+
+int compose_fill(compositor *c, const SDL_Rect *r, Uint32 color) {
+    compose_cmd tmp;
+    compose_cmd *cmd = deferred(c) ? record(c) : &tmp;
+    cmd->kind = COMPOSE_FILL;
+    cmd->color = color;
+    if (r) {
+        cmd->dst = *r;
+    } else {
+        cmd->dst.x = 0;
+        cmd->dst.y = 0;
+        cmd->dst.w = c->target->w;
+        cmd->dst.h = c->target->h;
+    }
+    if (!deferred(c)) return run_cmd(cmd, c->target, 0);
+    return 0;
+}
+
+int compose_squares(compositor *c, const square_batch *s, const SDL_Rect *area) {
+    compose_cmd tmp;
+    compose_cmd *cmd = deferred(c) ? record(c) : &tmp;
+    cmd->kind = COMPOSE_SQUARES;
+    cmd->dst = *area;
+    cmd->squares = s;
+    if (!deferred(c)) return run_cmd(cmd, c->target, 0);
+    return 0;
+}
+
+// Bands a command touches; 0 if it lies off the target
+static int cmd_bands(const compositor *c, const compose_cmd *cmd, int *b0, int *b1) {
+    int y0 = cmd->dst.y > 0 ? cmd->dst.y : 0;
+    int y1 = cmd->dst.y + cmd->dst.h < c->target->h ? cmd->dst.y + cmd->dst.h : c->target->h;
+    if (y1 <= y0 || cmd->dst.w == 0 || cmd->dst.x >= c->target->w || cmd->dst.x + cmd->dst.w <= 0) return 0;
+    *b0 = y0 / c->band_height;
+    *b1 = (y1 - 1) / c->band_height;
+    return 1;
+}
+
+// Counting sort of the commands into per-band runs, each in recorded order
+static int bin_commands(compositor *c) {
+    memset(c->band_first, 0, (c->band_count + 1) * sizeof(int));
+    int total = 0;
+    for (int i = 0; i < c->count; i++) {
+        int b0, b1;
+        if (!cmd_bands(c, &c->cmds[i], &b0, &b1)) continue;
+        for (int b = b0; b <= b1; b++) {
+            c->band_first[b + 1]++;
+        }
+        total += b1 - b0 + 1;
+    }
+    if (total > c->binned_capacity) {
+        int capacity = total > 2 * c->binned_capacity ? total : 2 * c->binned_capacity;
+        int *grown = realloc(c->binned, capacity * sizeof(int));
+        if (!grown) return -1;
+        c->binned = grown;
+        c->binned_capacity = capacity;
+    }
+    for (int b = 0; b < c->band_count; b++) {
+        c->band_first[b + 1] += c->band_first[b];
+    }
+    // Filled from the back, which leaves band_first[b + 1] at band b's start
+    for (int i = c->count - 1; i >= 0; i--) {
+        int b0, b1;
+        if (!cmd_bands(c, &c->cmds[i], &b0, &b1)) continue;
+        for (int b = b0; b <= b1; b++) {
+            c->binned[--c->band_first[b + 1]] = i;
+        }
+    }
+    memmove(c->band_first, c->band_first + 1, c->band_count * sizeof(int));
+    c->band_first[c->band_count] = total;
+    return 0;
+}
+
+void compose_flush(compositor *c) {
+    if (!deferred(c) || c->count == 0) return;
+    if (bin_commands(c) != 0) {
+        LOG_WARN(LOG_RENDER, "Warning: compositor out of memory, drawing %d commands in order\n", c->count);
+        for (int i = 0; i < c->count; i++) {
+            run_cmd(&c->cmds[i], c->target, 0);
+        }
+        c->count = 0;
+        c->serial = 0;
+        return;
+    }
+
+    const SDL_Rect *clip = &c->target->clip_rect;
+    for (int b = 0; b < c->band_count; b++) {
+        SDL_Rect band_clip = {clip->x, clip->y - b * c->band_height, clip->w, clip->h};
+        SDL_SetClipRect(c->bands[b], &band_clip);
+    }
+    if (SDL_MUSTLOCK(c->target) && SDL_LockSurface(c->target) < 0) return;
+
+    int parallel = c->threads > 1 && !c->serial;
+    SDL_mutexP(c->lock);
+    c->next_band = 0;
+    if (parallel) {
+        c->busy = c->threads - 1;
+        c->generation++;
+        SDL_CondBroadcast(c->wake);
+    }
+    SDL_mutexV(c->lock);
+    run_bands(c);
+    if (parallel) {
+        SDL_mutexP(c->lock);
+        while (c->busy > 0) {
+            SDL_CondWait(c->idle, c->lock);
+        }
+        SDL_mutexV(c->lock);
+    }
+
+    if (SDL_MUSTLOCK(c->target)) SDL_UnlockSurface(c->target);
+    c->flushes++;
+    if (!parallel) c->serial_flushes++;
+    c->count = 0;
+    c->serial = 0;
+}
+
+void free_compositor(compositor *c) {
+    if (c->lock) {
+        SDL_mutexP(c->lock);
+        c->quitting = 1;
+        SDL_CondBroadcast(c->wake);
+        SDL_mutexV(c->lock);
+    }
+    for (int i = 0; i < MAX_COMPOSE_THREADS - 1; i++) {
+        if (c->workers[i]) SDL_WaitThread(c->workers[i], NULL);
+    }
+    for (int b = 0; c->bands && b < c->band_count; b++) {
+        if (c->bands[b]) SDL_FreeSurface(c->bands[b]);
+    }
+    if (c->idle) SDL_DestroyCond(c->idle);
+    if (c->wake) SDL_DestroyCond(c->wake);
+    if (c->lock) SDL_DestroyMutex(c->lock);
+    free(c->bands);
+    free(c->band_first);
+    free(c->binned);
+    free(c->cmds);
+    memset(c, 0, sizeof(*c));
+}
@@ -0,0 +1,80 @@
+#ifndef COMPOSE_H
+#define COMPOSE_H
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+#include "assets.h"
+
+#define MAX_COMPOSE_CMDS 8192    // Recorded per flush; a full list is flushed early
+#define MAX_COMPOSE_THREADS 8    // Including the main thread
+#define COMPOSE_BAND_HEIGHT 32   // Rows per band unless init_compositor is told otherwise
+
+typedef enum {
+    COMPOSE_SPRITE, // draw_sprite of a sheet frame
+    COMPOSE_BLIT,   // Whole or part of a surface, unscaled
+    COMPOSE_FILL,
+    COMPOSE_SQUARES // A whole square_batch
+} compose_kind;
+
+// Solid squares in one command, for particles: a crowd of them costs a few commands rather
+// than one each. The arrays are read when the batch is drawn, so they must outlive the
+// next compose_flush.
+typedef struct {
+    const Sint16* x;
+    const Sint16* y;     // Top left on the target
+    const Uint8* size;   // Side in pixels
+    const Uint32* color; // In the target's format
+    int count;
+} square_batch;
+
+typedef struct {
+    compose_kind kind;
+    SDL_Rect dst;   // Target area the command may touch, unclipped
+    const sprite_asset* sheet;
+    int frame;
+    int mirror;
+    SDL_Surface* src;
+    SDL_Rect src_rect;
+    Uint32 color;
+    const square_batch* squares;
+} compose_cmd;
+
+// Records draw commands for one target and executes them band by band. Each band gets
+// the commands that touch it in recorded order, so any split draws the same pixels as
+// drawing them one after another. With one thread commands run as they are recorded.
+typedef struct {
+    SDL_Surface* target;
+    int threads;
+    int band_height;
+    int band_count;
+    SDL_Surface** bands; // Views of the target's rows, each clipped to its band
+    compose_cmd* cmds;
+    int count;
+    int* band_first;     // Start of each band's run in binned, band_count + 1 entries
+    int* binned;         // Command indices, grouped by band
+    int binned_capacity;
+    int serial;          // A recorded command needs SDL's blitter, which isn't thread-safe
+    Uint32 flushes;
+    Uint32 serial_flushes;
+
+    SDL_Thread* workers[MAX_COMPOSE_THREADS - 1];
+    SDL_mutex* lock;
+    SDL_cond* wake;      // Workers wait here for the next flush
+    SDL_cond* idle;      // The main thread waits here for them to finish it
+    Uint32 generation;   // Bumped per flush
+    int next_band;
+    int busy;            // Workers still on this flush
+    int quitting;
+} compositor;
+
+int compose_cpu_count(void);
+// threads <= 1 draws straight into target; band_height <= 0 takes COMPOSE_BAND_HEIGHT
+int init_compositor(compositor* c, SDL_Surface* target, int threads, int band_height);
+int compose_sprite(compositor* c, const sprite_asset* sheet, int frame, int mirror, SDL_Rect* dst); // Sets dst's size
+int compose_blit(compositor* c, SDL_Surface* src, const SDL_Rect* src_rect, int x, int y);
+int compose_fill(compositor* c, const SDL_Rect* r, Uint32 color); // NULL fills the whole target
+int compose_squares(compositor* c, const square_batch* s, const SDL_Rect* area); // area holds every square
+void compose_flush(compositor* c); // Draws everything recorded; returns once it is on the target
+void free_compositor(compositor* c);
+
+#endif
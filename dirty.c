@@ -0,0 +1,153 @@
+#include "dirty.h"
+#include "log.h"
+#include "profile.h"
+#include <SDL/SDL.h>
+#include <string.h>
+
+static int create_background(dirty_tracker *d, SDL_Surface *screen) {
+    SDL_PixelFormat *f = screen->format;
+    d->background = SDL_CreateRGBSurface(SDL_SWSURFACE, screen->w, screen->h, f->BitsPerPixel,
+                                         f->Rmask, f->Gmask, f->Bmask, f->Amask);
+    if (!d->background) {
+        LOG_ERROR(LOG_RENDER, "Failed to create %dx%d background: %s\n", screen->w, screen->h, SDL_GetError());
+        return -1;
+    }
+    SDL_FillRect(d->background, NULL, SDL_MapRGB(d->background->format, 0, 0, 0));
+    return 0;
+}
+
+int init_dirty(dirty_tracker *d, SDL_Surface *screen) {
+    memset(d, 0, sizeof(*d));
+    d->full = 1;
+    return create_background(d, screen);
+}
+
+void reset_dirty(dirty_tracker *d, SDL_Surface *screen) {
+    if (d->background) {
+        SDL_FreeSurface(d->background);
+        d->background = NULL;
+    }
+    d->drawn_count = 0;
+    d->previous_count = 0;
+    d->full = 1;
+    create_background(d, screen);
+}
+
+void dirty_redraw(dirty_tracker *d) {
+    if (!d->full) d->full = 1;
+}
+
+static int overlaps(const SDL_Rect *a, const SDL_Rect *b) {
+    // Touching rects count too: presenting them as one is never more work
+    return a->x <= b->x + b->w && b->x <= a->x + a->w &&
+           a->y <= b->y + b->h && b->y <= a->y + a->h;
+}
+
+// Collapses overlapping rects into their bounding boxes, in place; returns the new count
+static int merge_rects(SDL_Rect *r, int n) {
+    int merged = 1;
+    while (merged) {
+        merged = 0;
+        for (int i = 0; i < n; i++) {
+            for (int j = i + 1; j < n; j++) {
+                if (!overlaps(&r[i], &r[j])) continue;
+                int x0 = r[i].x < r[j].x ? r[i].x : r[j].x;
+                int y0 = r[i].y < r[j].y ? r[i].y : r[j].y;
+                int x1 = r[i].x + r[i].w > r[j].x + r[j].w ? r[i].x + r[i].w : r[j].x + r[j].w;
+                int y1 = r[i].y + r[i].h > r[j].y + r[j].h ? r[i].y + r[i].h : r[j].y + r[j].h;
+                r[i].x = x0;
+                r[i].y = y0;
+                r[i].w = x1 - x0;
+                r[i].h = y1 - y0;
+                r[j--] = r[--n];
+                merged = 1;
+            }
+        }
+    }
+    return n;
+}
+
+static long rects_area(const SDL_Rect *r, int n) {
+    long area = 0;
+    for (int i = 0; i < n; i++) {
+        area += (long)r[i].w * r[i].h;
+    }
+    return area;
+}
+
+static int too_large(SDL_Surface *screen, long area) {
+    return area * 100 > (long)screen->w * screen->h * DIRTY_FULL_PERCENT;
+}
+
+void dirty_begin_frame(dirty_tracker *d, SDL_Surface *screen) {
+    d->drawn_count = 0;
+    if (!d->full) {
+        memcpy(d->update, d->previous, d->previous_count * sizeof(SDL_Rect));
+        d->update_count = merge_rects(d->update, d->previous_count);
+        if (too_large(screen, rects_area(d->update, d->update_count))) d->full = 1;
+    }
+
+    if (d->full) {
+        SDL_BlitSurface(d->background, NULL, screen, NULL);
+        PROF_COUNT(PROF_BLITS, 1);
+        LOG_TRACE(LOG_RENDER, "Dirty: full restore\n");
+        return;
+    }
+    for (int i = 0; i < d->update_count; i++) {
+        SDL_Rect dst = d->update[i];
+        SDL_BlitSurface(d->background, &d->update[i], screen, &dst);
+    }
+    PROF_COUNT(PROF_BLITS, d->update_count);
+    LOG_TRACE(LOG_RENDER, "Dirty: restored %d rects\n", d->update_count);
+}
+
+void dirty_add(dirty_tracker *d, SDL_Surface *screen, const SDL_Rect *r) {
+    int x0 = r->x > 0 ? r->x : 0;
+    int y0 = r->y > 0 ? r->y : 0;
+    int x1 = r->x + r->w < screen->w ? r->x + r->w : screen->w;
+    int y1 = r->y + r->h < screen->h ? r->y + r->h : screen->h;
+    if (x1 <= x0 || y1 <= y0) return;
+
+    if (d->drawn_count == MAX_DIRTY_RECTS) {
+        // Untracked drawing: this frame and the next (which must erase it) go full
+        d->full = 2;
+        return;
+    }
+    SDL_Rect *out = &d->drawn[d->drawn_count++];
+    out->x = x0;
+    out->y = y0;
+    out->w = x1 - x0;
+    out->h = y1 - y0;
+}
+
+int dirty_end_frame(dirty_tracker *d, SDL_Surface *screen) {
+    if (!d->full) {
+        memcpy(d->update, d->previous, d->previous_count * sizeof(SDL_Rect));
+        memcpy(d->update + d->previous_count, d->drawn, d->drawn_count * sizeof(SDL_Rect));
+        d->update_count = merge_rects(d->update, d->previous_count + d->drawn_count);
+        if (too_large(screen, rects_area(d->update, d->update_count))) d->full = 1;
+    }
+    int count = d->full ? -1 : d->update_count;
+    if (d->full) d->full_frames++;
+
+    memcpy(d->previous, d->drawn, d->drawn_count * sizeof(SDL_Rect));
+    d->previous_count = d->drawn_count;
+    d->full = d->full == 2;
+    return count;
+}
+
+void dirty_present(dirty_tracker *d, SDL_Surface *screen) {
+    int count = dirty_end_frame(d, screen);
+    if (count < 0) {
+        SDL_UpdateRect(screen, 0, 0, 0, 0);
+    } else {
+        SDL_UpdateRects(screen, count, d->update);
+    }
+}
+
+void free_dirty(dirty_tracker *d) {
+    if (d->background) {
+        SDL_FreeSurface(d->background);
+        d->background = NULL;
+    }
+}
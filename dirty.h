@@ -0,0 +1,32 @@
+#ifndef DIRTY_H
+#define DIRTY_H
+
+#include <SDL/SDL.h>
+
+#define MAX_DIRTY_RECTS 64
+#define DIRTY_FULL_PERCENT 40 // Past this share of the screen a full redraw is cheaper
+
+// Tracks what was drawn last frame so only changed regions are restored and presented.
+// Needs a surface whose contents survive between frames: a single-buffered screen or a back buffer.
+typedef struct {
+    SDL_Surface* background; // Restored under sprites, same size and format as the surface tracked
+    SDL_Rect drawn[MAX_DIRTY_RECTS]; // Areas drawn this frame
+    int drawn_count;
+    SDL_Rect previous[MAX_DIRTY_RECTS]; // Areas drawn last frame
+    int previous_count;
+    SDL_Rect update[2 * MAX_DIRTY_RECTS]; // Merged areas presented this frame
+    int update_count;
+    int full; // 1: redraw and present the whole screen this frame, 2: the next one too
+    Uint32 full_frames; // Frames that fell back to a full redraw
+} dirty_tracker;
+
+int init_dirty(dirty_tracker* d, SDL_Surface* screen); // Black background
+void reset_dirty(dirty_tracker* d, SDL_Surface* screen); // After a video mode change
+void dirty_redraw(dirty_tracker* d); // background changed: the next frame restores and presents all of it
+void dirty_begin_frame(dirty_tracker* d, SDL_Surface* screen); // Restores last frame's areas
+void dirty_add(dirty_tracker* d, SDL_Surface* screen, const SDL_Rect* r);
+int dirty_end_frame(dirty_tracker* d, SDL_Surface* screen); // Rects in update to present, -1 for all of it
+void dirty_present(dirty_tracker* d, SDL_Surface* screen); // Instead of SDL_Flip
+void free_dirty(dirty_tracker* d);
+
+#endif
@@ -0,0 +1,238 @@
+#include "effects.h"
+#include "log.h"
+#include "profile.h"
+#include <SDL/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SQUARE 5 // Largest particle side, so a strip's batch knows how far below it reaches
+
+static void *take(Uint8 **block, size_t size) {
+    void *p = *block;
+    *block += size;
+    return p;
+}
+
+int init_effects(effects *fx, int capacity, SDL_Surface *target, int strip_height) {
+    memset(fx, 0, sizeof(*fx));
+    if (capacity <= 0) capacity = MAX_EFFECT_PARTICLES;
+    capacity = (capacity + 7) & ~7; // Whole vectors for the update loops
+
+    // Widest fields first so every array stays aligned to its type
+    size_t floats = (size_t)capacity * sizeof(float);
+    size_t words = (size_t)capacity * sizeof(Uint32);
+    size_t shorts = (size_t)capacity * sizeof(Sint16);
+    size_t bytes = (size_t)capacity;
+    Uint8 *p = malloc(7 * floats + words + 4 * shorts + 2 * bytes);
+    if (!p) {
+        LOG_ERROR(LOG_RENDER, "Out of memory for %d particles\n", capacity);
+        return -1;
+    }
+    fx->block = p;
+    fx->x = take(&p, floats);
+    fx->y = take(&p, floats);
+    fx->vx = take(&p, floats);
+    fx->vy = take(&p, floats);
+    fx->ay = take(&p, floats);
+    fx->life = take(&p, floats);
+    fx->fade = take(&p, floats);
+    fx->draw_color = take(&p, words);
+    fx->value = take(&p, shorts);
+    fx->strip_of = take(&p, shorts);
+    fx->draw_x = take(&p, shorts);
+    fx->draw_y = take(&p, shorts);
+    fx->kind = take(&p, bytes);
+    fx->draw_size = take(&p, bytes);
+    fx->capacity = capacity;
+    fx->seed = 0x9e3779b9u;
+
+    if (strip_height < 1) strip_height = COMPOSE_BAND_HEIGHT;
+    if ((target->h + strip_height - 1) / strip_height > MAX_EFFECT_STRIPS) {
+        strip_height = (target->h + MAX_EFFECT_STRIPS - 1) / MAX_EFFECT_STRIPS;
+    }
+    fx->strip_height = strip_height;
+    fx->strip_count = (target->h + strip_height - 1) / strip_height;
+
+    // Dimmest first, indexed by how much life is left
+    static const Uint8 ramps[EFFECT_KIND_COUNT][EFFECT_SHADES][3] = {
+        {{150, 40, 20}, {230, 110, 30}, {255, 200, 60}, {255, 250, 210}},
+        {{90, 80, 70}, {120, 105, 90}, {150, 135, 115}, {180, 165, 145}},
+        {{255, 230, 90}, {255, 230, 90}, {255, 230, 90}, {255, 230, 90}},
+    };
+    for (int k = 0; k < EFFECT_KIND_COUNT; k++) {
+        for (int s = 0; s < EFFECT_SHADES; s++) {
+            fx->colors[k][s] = SDL_MapRGB(target->format, ramps[k][s][0], ramps[k][s][1], ramps[k][s][2]);
+        }
+    }
+    LOG_INFO(LOG_RENDER, "Effects: %d particles, %d KB, %d strips of %d rows\n", capacity,
+             (int)((7 * floats + words + 4 * shorts + 2 * bytes) / 1024), fx->strip_count, fx->strip_height);
+    return 0;
+}
+
+static float random_range(effects *fx, float lo, float hi) {
+    fx->seed = fx->seed * 1664525u + 1013904223u;
+    return lo + (hi - lo) * (float)(fx->seed >> 8) / 16777216.0f;
+}
+
+static int spawn(effects *fx, effect_kind kind, float x, float y, float vx, float vy, float ay, float life) {
+    if (fx->count == fx->capacity) {
+        fx->dropped++;
+        return -1;
+    }
+    int i = fx->count++;
+    fx->x[i] = x;
+    fx->y[i] = y;
+    fx->vx[i] = vx;
+    fx->vy[i] = vy;
+    fx->ay[i] = ay;
+    fx->life[i] = life;
+    fx->fade[i] = 1.0f / life;
+    fx->kind[i] = kind;
+    fx->value[i] = 0;
+    return i;
+}
+
+void emit_sparks(effects *fx, float x, float y, int count) {
+    for (int n = 0; n < count; n++) {
+        float speed = random_range(fx, 120.0f, 420.0f);
+        spawn(fx, EFFECT_SPARK, x, y, random_range(fx, -1.0f, 1.0f) * speed, -random_range(fx, 0.1f, 1.0f) * speed,
+              900.0f, random_range(fx, 0.2f, 0.5f));
+    }
+}
+
+void emit_dust(effects *fx, float x, float y, int count, float spread) {
+    for (int n = 0; n < count; n++) {
+        spawn(fx, EFFECT_DUST, x + random_range(fx, -spread, spread), y - random_range(fx, 0.0f, 4.0f),
+              random_range(fx, -60.0f, 60.0f), random_range(fx, -40.0f, -10.0f), 30.0f, random_range(fx, 0.3f, 0.7f));
+    }
+}
+
+void emit_number(effects *fx, float x, float y, int value) {
+    int i = spawn(fx, EFFECT_NUMBER, x, y, 0.0f, -80.0f, 60.0f, 0.9f);
+    if (i >= 0) fx->value[i] = (Sint16)value;
+}
+
+void perso_effects(effects *fx, perso *p) {
+    if (!p->events) return;
+    float centre = p->pos.x + BODY_X + BODY_W / 2.0f;
+    float feet = p->pos.y + BODY_Y + BODY_H;
+    if (p->events & PERSO_EVENT_HIT) {
+        emit_sparks(fx, centre, p->pos.y + BODY_Y + BODY_H / 3.0f, 24);
+        emit_number(fx, centre - 12.0f, p->pos.y + BODY_Y - 8.0f, -HIT_DAMAGE);
+    }
+    if (p->events & PERSO_EVENT_LANDED) emit_dust(fx, centre, feet, 10, BODY_W / 2.0f);
+    if (p->events & PERSO_EVENT_DIED) emit_dust(fx, centre, feet, 48, BODY_W * 1.5f);
+    p->events = 0;
+}
+
+// Separate from the pool's fields so the compiler knows the arrays don't overlap
+static void move_particles(float *restrict x, float *restrict y, const float *restrict vx, float *restrict vy,
+                           const float *restrict ay, float *restrict life, int n, float dt) {
+    for (int i = 0; i < n; i++) {
+        vy[i] += ay[i] * dt;
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+        life[i] -= dt;
+    }
+}
+
+void update_effects(effects *fx, float dt) {
+    int n = fx->count;
+    if (n == 0 || dt <= 0) return;
+    move_particles(fx->x, fx->y, fx->vx, fx->vy, fx->ay, fx->life, n, dt);
+
+    // The last live particle fills each gap; drawing doesn't care about order
+    for (int i = 0; i < n;) {
+        if (fx->life[i] > 0) {
+            i++;
+            continue;
+        }
+        n--;
+        fx->x[i] = fx->x[n];
+        fx->y[i] = fx->y[n];
+        fx->vx[i] = fx->vx[n];
+        fx->vy[i] = fx->vy[n];
+        fx->ay[i] = fx->ay[n];
+        fx->life[i] = fx->life[n];
+        fx->fade[i] = fx->fade[n];
+        fx->kind[i] = fx->kind[n];
+        fx->value[i] = fx->value[n];
+    }
+    fx->count = n;
+}
+
+int draw_effects(effects *fx, int view_x, int view_y, compositor *c, SDL_Rect *bounds) {
+    int w = c->target->w;
+    int h = c->target->h;
+    int starts[MAX_EFFECT_STRIPS + 1];
+    memset(starts, 0, sizeof(starts));
+    int left = w, top = h, right = 0, bottom = 0;
+    if (!fx->font && text_ready()) {
+        SDL_Color yellow = {255, 230, 90, 0};
+        fx->font = get_text_font(EFFECT_NUMBER_PTSIZE, yellow);
+    }
+
+    // Counting sort by strip: what is in view, and where each strip's run starts
+    for (int i = 0; i < fx->count; i++) {
+        int sx = (int)fx->x[i] - view_x;
+        int sy = (int)fx->y[i] - view_y;
+        fx->strip_of[i] = -1;
+        if (fx->kind[i] == EFFECT_NUMBER) {
+            if (fx->font && sx > -64 && sx < w && sy > -64 && sy < h) queue_text(fx->font, sx, sy, "%d", fx->value[i]);
+            continue;
+        }
+        if (sx <= -MAX_SQUARE || sx >= w || sy <= -MAX_SQUARE || sy >= h) continue;
+        int strip = sy < 0 ? 0 : sy / fx->strip_height;
+        if (strip >= fx->strip_count) strip = fx->strip_count - 1;
+        fx->strip_of[i] = (Sint16)strip;
+        starts[strip + 1]++;
+        if (sx < left) left = sx;
+        if (sy < top) top = sy;
+        if (sx + MAX_SQUARE > right) right = sx + MAX_SQUARE;
+        if (sy + MAX_SQUARE > bottom) bottom = sy + MAX_SQUARE;
+    }
+    for (int s = 0; s < fx->strip_count; s++) {
+        starts[s + 1] += starts[s];
+    }
+    int drawn = starts[fx->strip_count];
+
+    int next[MAX_EFFECT_STRIPS];
+    memcpy(next, starts, sizeof(next));
+    for (int i = 0; i < fx->count; i++) {
+        int strip = fx->strip_of[i];
+        if (strip < 0) continue;
+        int d = next[strip]++;
+        int shade = (int)(fx->life[i] * fx->fade[i] * EFFECT_SHADES);
+        if (shade >= EFFECT_SHADES) shade = EFFECT_SHADES - 1;
+        fx->draw_x[d] = (Sint16)((int)fx->x[i] - view_x);
+        fx->draw_y[d] = (Sint16)((int)fx->y[i] - view_y);
+        fx->draw_size[d] = (Uint8)(fx->kind[i] == EFFECT_SPARK ? 2 + (shade >= 2) : 2 + shade);
+        fx->draw_color[d] = fx->colors[fx->kind[i]][shade];
+    }
+
+    for (int s = 0; s < fx->strip_count; s++) {
+        int count = starts[s + 1] - starts[s];
+        if (count == 0) continue;
+        square_batch *b = &fx->strips[s];
+        b->x = fx->draw_x + starts[s];
+        b->y = fx->draw_y + starts[s];
+        b->size = fx->draw_size + starts[s];
+        b->color = fx->draw_color + starts[s];
+        b->count = count;
+        int y0 = s == 0 ? -MAX_SQUARE : s * fx->strip_height;
+        SDL_Rect area = {0, y0, w, (s + 1) * fx->strip_height + MAX_SQUARE - y0};
+        compose_squares(c, b, &area);
+    }
+    PROF_COUNT(PROF_PARTICLES, drawn);
+
+    bounds->x = left > 0 ? left : 0;
+    bounds->y = top > 0 ? top : 0;
+    bounds->w = drawn && right > bounds->x ? (right < w ? right : w) - bounds->x : 0;
+    bounds->h = drawn && bottom > bounds->y ? (bottom < h ? bottom : h) - bounds->y : 0;
+    return drawn;
+}
+
+void free_effects(effects *fx) {
+    free(fx->block);
+    memset(fx, 0, sizeof(*fx));
+}
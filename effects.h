@@ -0,0 +1,67 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include <SDL/SDL.h>
+#include "compose.h"
+#include "perso.h"
+#include "text.h"
+
+#define MAX_EFFECT_PARTICLES 65536 // Pool size when init_effects is given 0
+#define MAX_EFFECT_STRIPS 64       // Square batches per frame, one per strip of the target's rows
+#define EFFECT_SHADES 4            // Colours per kind, brightest while young
+#define EFFECT_NUMBER_PTSIZE 18
+
+typedef enum {
+    EFFECT_SPARK,  // Hits: fast and bright, falling
+    EFFECT_DUST,   // Landings and deaths: slow puffs drifting up
+    EFFECT_NUMBER, // Damage dealt, rising; drawn as text
+    EFFECT_KIND_COUNT
+} effect_kind;
+
+// Particles in a fixed pool, field by field so update_effects is a few straight loops over
+// floats the compiler vectorises. Live ones are packed at the front and a dead one takes the
+// last one's place. Every array, the drawing ones included, comes from init_effects; once it
+// returns nothing allocates, and emitting into a full pool drops the new particles.
+typedef struct {
+    int capacity;
+    int count;            // Live
+    float* x;
+    float* y;             // World pixels
+    float* vx;
+    float* vy;            // Pixels per second
+    float* ay;            // Pixels per second squared, down
+    float* life;          // Seconds left
+    float* fade;          // 1 / the life it started with
+    Uint8* kind;
+    Sint16* value;        // Shown by EFFECT_NUMBER
+    Uint32 seed;
+    Uint32 dropped;       // Emitted into a full pool
+
+    // Drawing: squares sorted by strip, a batch per strip so each lands in one or two bands
+    Sint16* strip_of;     // Of each particle, -1 when off the view
+    Sint16* draw_x;
+    Sint16* draw_y;
+    Uint8* draw_size;
+    Uint32* draw_color;
+    square_batch strips[MAX_EFFECT_STRIPS];
+    int strip_height;
+    int strip_count;
+    Uint32 colors[EFFECT_KIND_COUNT][EFFECT_SHADES]; // Mapped to the target, dimmest first
+    text_font* font;      // For the numbers, once the text engine is up
+    void* block;          // Every array above
+} effects;
+
+// capacity <= 0 takes MAX_EFFECT_PARTICLES; strip_height is the compositor's band height.
+// On failure fx is still usable, a pool that drops everything, and -1 is returned.
+int init_effects(effects* fx, int capacity, SDL_Surface* target, int strip_height);
+void emit_sparks(effects* fx, float x, float y, int count);
+void emit_dust(effects* fx, float x, float y, int count, float spread);
+void emit_number(effects* fx, float x, float y, int value);
+void perso_effects(effects* fx, perso* p); // Emits for p's events and clears them
+void update_effects(effects* fx, float dt);
+// Records the squares and queues the numbers, the view's top left at view_x, view_y.
+// bounds covers the squares, 0 wide when there are none; returns how many were drawn.
+int draw_effects(effects* fx, int view_x, int view_y, compositor* c, SDL_Rect* bounds);
+void free_effects(effects* fx);
+
+#endif
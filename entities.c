@@ -0,0 +1,279 @@
+#include "entities.h"
+#include "log.h"
+#include "timing.h"
+#include "input.h"
+#include "blit.h"
+#include <SDL/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARRAY_ALIGN 64
+
+// Carves the next array out of the store's block, keeping each one cache-line aligned
+static void *carve(Uint8 **cursor, size_t bytes) {
+    void *p = *cursor;
+    *cursor += (bytes + ARRAY_ALIGN - 1) & ~(size_t)(ARRAY_ALIGN - 1);
+    return p;
+}
+
+int init_entities(entity_store *s, int capacity) {
+    memset(s, 0, sizeof(*s));
+    size_t n = (size_t)capacity;
+    size_t bytes = 4 * (n * sizeof(float) + ARRAY_ALIGN) + 2 * (n * sizeof(Uint32) + ARRAY_ALIGN) +
+                   (n * sizeof(Sint16) + ARRAY_ALIGN) + (n * sizeof(anim_state) + ARRAY_ALIGN) +
+                   6 * (n + ARRAY_ALIGN) + ARRAY_ALIGN;
+    s->block = calloc(1, bytes);
+    if (!s->block) {
+        LOG_ERROR(LOG_CORE, "Failed to allocate entity store for %d entities\n", capacity);
+        return -1;
+    }
+
+    Uint8 *cursor = (Uint8 *)(((size_t)s->block + ARRAY_ALIGN - 1) & ~(size_t)(ARRAY_ALIGN - 1));
+    s->x = carve(&cursor, n * sizeof(float));
+    s->y = carve(&cursor, n * sizeof(float));
+    s->velocity_y = carve(&cursor, n * sizeof(float));
+    s->speed = carve(&cursor, n * sizeof(float));
+    s->move_start = carve(&cursor, n * sizeof(Uint32));
+    s->last_hit_time = carve(&cursor, n * sizeof(Uint32));
+    s->vie = carve(&cursor, n * sizeof(Sint16));
+    s->state = carve(&cursor, n);
+    s->anim = carve(&cursor, n * sizeof(anim_state));
+    s->anim_events = carve(&cursor, n);
+    s->direction = carve(&cursor, n);
+    s->input = carve(&cursor, n);
+    s->flags = carve(&cursor, n);
+    s->archetype = carve(&cursor, n);
+    s->capacity = capacity;
+    LOG_INFO(LOG_CORE, "Entity store: %d slots, %lu KB\n", capacity, (unsigned long)(bytes / 1024));
+    return 0;
+}
+
+int add_archetype(entity_store *s, perso_archetype *archetype) {
+    for (int a = 0; a < s->archetype_count; a++) {
+        if (s->archetypes[a] == archetype) return a;
+    }
+    if (s->archetype_count == MAX_ARCHETYPES) {
+        LOG_ERROR(LOG_CORE, "Too many archetypes (max %d)\n", MAX_ARCHETYPES);
+        return -1;
+    }
+
+    if (acquire_archetype(archetype) != 0) return -1;
+    int a = s->archetype_count;
+    s->archetypes[a] = archetype;
+    s->archetype_count++;
+    return a;
+}
+
+int spawn_entity(entity_store *s, int archetype, int x, int y) {
+    if (s->count == s->capacity || archetype < 0 || archetype >= s->archetype_count) return -1;
+
+    int id = s->count++;
+    s->x[id] = x;
+    s->y[id] = y;
+    s->velocity_y[id] = 0;
+    s->speed[id] = 4.0f;
+    s->move_start[id] = 0;
+    s->last_hit_time[id] = (Uint32)-HIT_COOLDOWN; // As init_perso
+    s->vie[id] = 100;
+    s->state[id] = IDLE;
+    play_clip(&s->anim[id], s->archetypes[archetype]->clips[IDLE]);
+    s->anim_events[id] = 0;
+    s->direction[id] = 0;
+    s->input[id] = 0;
+    s->flags[id] = 0;
+    s->archetype[id] = (Uint8)archetype;
+    return id;
+}
+
+int deplacer_entities(entity_store *s, const collision_map *map) {
+    Uint32 now = sim_time_ms();
+    float dt = sim_dt();
+    float step = dt * REFERENCE_TICK_RATE;
+    int queries = 0;
+
+    for (int i = 0; i < s->count; i++) {
+        Uint8 state = s->state[i];
+        Uint8 flags = s->flags[i];
+        if ((flags & ENTITY_DEAD) || state == DEAD || state == ATTACK || state == HURT) continue;
+
+        Uint8 input = s->input[i];
+        int moved = 0;
+        if (input & (INPUT_LEFT | INPUT_RIGHT)) {
+            if (!(flags & ENTITY_MOVING)) {
+                s->move_start[i] = now;
+                s->speed[i] = 4.0f;
+                flags |= ENTITY_MOVING;
+            }
+            if (now - s->move_start[i] > ACCEL_DELAY) {
+                s->speed[i] += ACCELERATION * (now - s->move_start[i] - ACCEL_DELAY) * dt;
+                if (s->speed[i] > 8.0f) s->speed[i] = 8.0f;
+            }
+            // As the fall below: whole pixels collide, and the fraction moves once the way is clear
+            float delta = s->speed[i] * step;
+            int left = (int)s->x[i] + BODY_X;
+            int top = (int)s->y[i] + BODY_Y;
+            if (input & INPUT_LEFT) {
+                int reach = (int)s->x[i] - (int)(s->x[i] - delta);
+                int moved = collide_left(map, top, top + BODY_H, left, reach);
+                s->x[i] = moved < reach ? (float)((int)s->x[i] - moved) : s->x[i] - delta;
+                s->direction[i] = 1;
+            } else {
+                int reach = (int)(s->x[i] + delta) - (int)s->x[i];
+                int moved = collide_right(map, top, top + BODY_H, left + BODY_W, reach);
+                s->x[i] = moved < reach ? (float)((int)s->x[i] + moved) : s->x[i] + delta;
+                s->direction[i] = 0;
+            }
+            queries++;
+            if (!(flags & ENTITY_JUMPING)) state = RUN;
+            moved = 1;
+        } else {
+            flags &= ~ENTITY_MOVING;
+            s->speed[i] = 4.0f;
+        }
+
+        if (!moved && !(flags & ENTITY_JUMPING)) state = IDLE;
+
+        // As jump_perso, with the position kept fractional
+        int left = (int)s->x[i] + BODY_X;
+        int feet = (int)s->y[i] + BODY_Y + BODY_H;
+        if ((input & INPUT_JUMP) && !(flags & ENTITY_JUMPING)) {
+            s->velocity_y[i] = -15;
+            flags |= ENTITY_JUMPING;
+            state = JUMP;
+        } else if (!(flags & ENTITY_JUMPING)) {
+            queries++;
+            if (collide_down(map, left, left + BODY_W, feet, 1) > 0) {
+                s->velocity_y[i] = 0;
+                flags |= ENTITY_JUMPING;
+                state = JUMP;
+            }
+        }
+        if (flags & ENTITY_JUMPING) {
+            float dy = (s->velocity_y[i] + 0.25f * step) * step;
+            s->velocity_y[i] += 0.5f * step;
+            queries++;
+            if (dy >= 0) {
+                // Whole pixels to the next tile edge; the fraction only moves once the way is clear
+                int reach = (int)(s->y[i] + dy) - (int)s->y[i];
+                int fall = collide_down(map, left, left + BODY_W, feet, reach > 0 ? reach : 1);
+                if (fall < (reach > 0 ? reach : 1)) {
+                    s->y[i] = (float)((int)s->y[i] + fall);
+                    s->velocity_y[i] = 0;
+                    flags &= ~ENTITY_JUMPING;
+                    state = IDLE;
+                } else {
+                    s->y[i] += dy;
+                }
+            } else {
+                int reach = (int)s->y[i] - (int)(s->y[i] + dy);
+                int rise = collide_up(map, left, left + BODY_W, feet - BODY_H, reach);
+                if (rise < reach) {
+                    s->y[i] = (float)((int)s->y[i] - rise);
+                    s->velocity_y[i] = 0;
+                } else {
+                    s->y[i] += dy;
+                }
+            }
+        }
+
+        s->state[i] = state;
+        s->flags[i] = flags;
+    }
+    return queries;
+}
+
+void animer_entities(entity_store *s) {
+    float dt_ms = sim_dt() * 1000.0f;
+
+    for (int i = 0; i < s->count; i++) {
+        s->anim_events[i] = 0;
+        if (s->flags[i] & ENTITY_PLAYED_DEAD) continue;
+
+        const perso_archetype *a = s->archetypes[s->archetype[i]];
+        anim_state *anim = &s->anim[i];
+        Uint8 state = s->state[i];
+        int clip = a->clips[state];
+        if (anim->clip != clip) play_clip(anim, clip);
+
+        Uint8 events = advance_anim(a->anims, anim, dt_ms);
+        if (anim->clip != clip) {
+            // A one-shot handed over to its next clip; follow it with the state
+            for (int k = 0; k < 6; k++) {
+                if (a->clips[k] == anim->clip) {
+                    state = (Uint8)k;
+                    break;
+                }
+            }
+        }
+        if (state == DEAD && (events & ANIM_EVENT_END)) {
+            s->flags[i] |= ENTITY_DEAD | ENTITY_PLAYED_DEAD;
+        }
+        s->state[i] = state;
+        s->anim_events[i] = events;
+    }
+}
+
+void attack_entity(entity_store *s, int id) {
+    Uint8 state = s->state[id];
+    if ((s->flags[id] & ENTITY_DEAD) || state == DEAD || state == ATTACK || state == HURT) return;
+
+    s->state[id] = ATTACK;
+    play_clip(&s->anim[id], s->archetypes[s->archetype[id]]->clips[ATTACK]);
+}
+
+int hit_entity(entity_store *s, int id) {
+    Uint8 state = s->state[id];
+    if ((s->flags[id] & ENTITY_DEAD) || state == DEAD || state == HURT) return 0;
+    Uint32 now = sim_time_ms();
+    if (now - s->last_hit_time[id] < HIT_COOLDOWN) return 0;
+
+    const perso_archetype *a = s->archetypes[s->archetype[id]];
+    s->state[id] = HURT;
+    play_clip(&s->anim[id], a->clips[HURT]);
+    s->last_hit_time[id] = now;
+    s->vie[id] -= HIT_DAMAGE;
+    if (s->vie[id] <= 0) {
+        s->vie[id] = 0;
+        s->state[id] = DEAD;
+        play_clip(&s->anim[id], a->clips[DEAD]);
+        s->flags[id] |= ENTITY_DEAD;
+    }
+    return 1;
+}
+
+int combat_entities(entity_store *s, combat_grid *g, combat_hit *hits) {
+    for (int i = 0; i < s->count; i++) {
+        if (s->flags[i] & ENTITY_DEAD) {
+            remove_combat_body(g, i);
+            continue;
+        }
+        combat_body body;
+        const anim_library *lib = s->archetypes[s->archetype[i]]->anims;
+        anim_combat_body(lib, &s->anim[i], (int)s->x[i], (int)s->y[i], s->direction[i], &body);
+        set_combat_body(g, i, &body);
+    }
+
+    int count = resolve_combat(g, hits, MAX_COMBAT_HITS);
+    int landed = 0;
+    for (int h = 0; h < count; h++) {
+        landed += hit_entity(s, hits[h].target);
+    }
+    return landed;
+}
+
+void afficher_entities(entity_store *s, compositor *c) {
+    for (int i = 0; i < s->count; i++) {
+        const anim_library *lib = s->archetypes[s->archetype[i]]->anims;
+        sprite_asset *sheet = lib->clips[s->anim[i].clip].sheet;
+        SDL_Rect dst = {(Sint16)s->x[i], (Sint16)s->y[i], 0, 0};
+        compose_sprite(c, sheet, anim_sheet_frame(lib, &s->anim[i]), s->direction[i], &dst);
+    }
+}
+
+void free_entities(entity_store *s) {
+    for (int a = 0; a < s->archetype_count; a++) {
+        release_archetype(s->archetypes[a]);
+    }
+    free(s->block);
+    memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,53 @@
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <SDL/SDL.h>
+#include "perso.h"
+#include "anim.h"
+#include "combat.h"
+
+#define MAX_ARCHETYPES 8
+
+// entity_store.flags bits
+#define ENTITY_JUMPING 0x01
+#define ENTITY_MOVING 0x02
+#define ENTITY_DEAD 0x04
+#define ENTITY_PLAYED_DEAD 0x08
+
+// Crowd characters kept as parallel arrays, so batched updates walk memory linearly
+typedef struct {
+    int count;
+    int capacity;
+    void* block; // Every array below lives in this one allocation
+
+    float* x;
+    float* y;
+    float* velocity_y;
+    float* speed;       // Run speed, accelerates while a direction is held
+    Uint32* move_start; // When the current run started
+    Uint32* last_hit_time;
+    Sint16* vie;
+    Uint8* state;
+    anim_state* anim;
+    Uint8* anim_events; // ANIM_EVENT_* raised during the last animer_entities
+    Uint8* direction;   // 0: right, 1: left
+    Uint8* input;       // INPUT_* bits for the current tick
+    Uint8* flags;
+    Uint8* archetype;
+
+    int archetype_count;
+    perso_archetype* archetypes[MAX_ARCHETYPES];
+} entity_store;
+
+int init_entities(entity_store* s, int capacity);
+int add_archetype(entity_store* s, perso_archetype* archetype); // Index, or -1
+int spawn_entity(entity_store* s, int archetype, int x, int y);      // Entity id, or -1
+int deplacer_entities(entity_store* s, const collision_map* map); // Movement and jumps for everyone; returns collision queries
+void animer_entities(entity_store* s);
+void attack_entity(entity_store* s, int id);
+int hit_entity(entity_store* s, int id); // 1 if the hit landed
+int combat_entities(entity_store* s, combat_grid* g, combat_hit* hits); // Files everyone, applies hits; returns hits landed
+void afficher_entities(entity_store* s, compositor* c);
+void free_entities(entity_store* s);
+
+#endif
@@ -0,0 +1,103 @@
+#include "hud.h"
+#include "log.h"
+#include "profile.h"
+#include <SDL/SDL.h>
+#include <SDL/SDL_ttf.h>
+#include <stdio.h>
+
+static SDL_Surface *render_text(TTF_Font *font, const char *text) {
+    SDL_Color text_color = {255, 255, 255};
+    SDL_Surface *rendered = TTF_RenderText_Solid(font, text, text_color);
+    if (rendered == NULL) {
+        LOG_ERROR(LOG_RENDER, "Failed to render \"%s\": %s\n", text, TTF_GetError());
+        return NULL;
+    }
+
+    // Keep the cached text in display format so the per-frame blit is a plain copy
+    SDL_Surface *optimized = SDL_DisplayFormat(rendered);
+    if (optimized == NULL) {
+        return rendered;
+    }
+    SDL_FreeSurface(rendered);
+    return optimized;
+}
+
+void init_hud(hud *h, int player_num, TTF_Font *font) {
+    char player_label[10];
+    sprintf(player_label, "Player %d", player_num);
+
+    h->player_num = player_num;
+    h->font = font;
+    h->label = render_text(font, player_label);
+    h->score_text = NULL;
+    h->shown_score = -1;
+}
+
+static int hud_x(hud *h, SDL_Surface *screen) {
+    return h->player_num == 1 ? 10 : screen->w - HEALTH_BAR_WIDTH - 10;
+}
+
+void afficher_hud(hud *h, perso *p, compositor *c) {
+    if (p->is_dead && p->played_dead) return;
+
+    if (h->score_text == NULL || h->shown_score != p->score) {
+        char score_label[20];
+        sprintf(score_label, "Score: %d", p->score);
+        if (h->score_text) {
+            SDL_FreeSurface(h->score_text);
+        }
+        h->score_text = render_text(h->font, score_label);
+        h->shown_score = p->score;
+    }
+
+    SDL_Surface *screen = c->target;
+    int x = hud_x(h, screen);
+    int health_width = p->vie > 0 ? p->vie : 0;
+    if (health_width > HEALTH_BAR_WIDTH) health_width = HEALTH_BAR_WIDTH;
+
+    SDL_Rect border = {x, 30, HEALTH_BAR_WIDTH + 2, 12};
+    SDL_Rect background = {x + 1, 31, HEALTH_BAR_WIDTH, 10};
+    SDL_Rect health = {x + 1, 31, health_width, 10};
+
+    if (h->label) {
+        compose_blit(c, h->label, NULL, x, 5);
+        PROF_COUNT(PROF_BLITS, 1);
+    }
+    compose_fill(c, &border, SDL_MapRGB(screen->format, 255, 255, 255));
+    compose_fill(c, &background, SDL_MapRGB(screen->format, 255, 0, 0));
+    if (health_width > 0) {
+        compose_fill(c, &health, SDL_MapRGB(screen->format, 0, 255, 0));
+    }
+    if (h->score_text) {
+        compose_blit(c, h->score_text, NULL, x, 45);
+        PROF_COUNT(PROF_BLITS, 1);
+    }
+}
+
+int hud_bounds(hud *h, perso *p, SDL_Surface *screen, SDL_Rect *r) {
+    if (p->is_dead && p->played_dead) return 0;
+
+    int w = HEALTH_BAR_WIDTH + 2;
+    int bottom = 42;
+    if (h->label && h->label->w > w) w = h->label->w;
+    if (h->score_text) {
+        if (h->score_text->w > w) w = h->score_text->w;
+        bottom = 45 + h->score_text->h;
+    }
+    r->x = hud_x(h, screen);
+    r->y = 5;
+    r->w = w;
+    r->h = bottom - 5;
+    return 1;
+}
+
+void free_hud(hud *h) {
+    if (h->label) {
+        SDL_FreeSurface(h->label);
+        h->label = NULL;
+    }
+    if (h->score_text) {
+        SDL_FreeSurface(h->score_text);
+        h->score_text = NULL;
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_ttf.h>
+#include "perso.h"
+
+#define HEALTH_BAR_WIDTH 100
+
+typedef struct {
+    int player_num;
+    TTF_Font* font;
+    SDL_Surface* label;      // "Player N", rendered once
+    SDL_Surface* score_text; // Re-rendered only when the score changes
+    int shown_score;
+} hud;
+
+void init_hud(hud* h, int player_num, TTF_Font* font);
+void afficher_hud(hud* h, perso* p, compositor* c); // The surfaces stay in use until c is flushed
+int hud_bounds(hud* h, perso* p, SDL_Surface* screen, SDL_Rect* r); // Area afficher_hud covers, 0 if hidden
+void free_hud(hud* h);
+
+#endif
@@ -0,0 +1,18 @@
+#include "input.h"
+#include <SDL/SDL.h>
+
+Uint8 lire_input_clavier(int player_num) {
+    const Uint8 *keys = SDL_GetKeyState(NULL);
+    Uint8 input = 0;
+
+    if (player_num == 1) {
+        if (keys[SDLK_LEFT]) input |= INPUT_LEFT;
+        if (keys[SDLK_RIGHT]) input |= INPUT_RIGHT;
+        if (keys[SDLK_UP]) input |= INPUT_JUMP;
+    } else {
+        if (keys[SDLK_q]) input |= INPUT_LEFT;
+        if (keys[SDLK_d]) input |= INPUT_RIGHT;
+        if (keys[SDLK_z]) input |= INPUT_JUMP;
+    }
+    return input;
+}
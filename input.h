@@ -0,0 +1,14 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <SDL/SDL.h>
+
+// Per-player controls for one tick, stored in perso.input
+#define INPUT_LEFT 0x01
+#define INPUT_RIGHT 0x02
+#define INPUT_JUMP 0x04
+#define INPUT_ATTACK 0x08 // Pressed since the previous tick, so it travels with the rest
+
+Uint8 lire_input_clavier(int player_num); // Player 1: arrows, player 2: q/d/z
+
+#endif
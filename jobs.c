@@ -0,0 +1,146 @@
+#include "jobs.h"
+#include "log.h"
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+#include <string.h>
+
+static int take_batch(job_queue *q, int steal) {
+    int batch = -1;
+    SDL_mutexP(q->lock);
+    if (q->first < q->last) batch = steal ? --q->last : q->first++;
+    SDL_mutexV(q->lock);
+    return batch;
+}
+
+// Own queue first, then the others' leftovers, until nothing is left to start
+static void work(job_pool *p, int self) {
+    for (;;) {
+        int batch = take_batch(&p->queues[self], 0);
+        for (int i = 1; batch < 0 && i < p->threads; i++) {
+            batch = take_batch(&p->queues[(self + i) % p->threads], 1);
+            if (batch >= 0) p->steals[self]++;
+        }
+        if (batch < 0) return;
+        int first = batch * p->batch_size;
+        int last = first + p->batch_size < p->count ? first + p->batch_size : p->count;
+        p->fn(p->user, batch, first, last, self);
+    }
+}
+
+static int job_worker(void *data) {
+    job_pool *p = data;
+    Uint32 seen = 0;
+    SDL_mutexP(p->lock);
+    int self = ++p->joined; // Queue 0 belongs to the caller of run_jobs
+    for (;;) {
+        while (!p->quitting && p->generation == seen) {
+            SDL_CondWait(p->wake, p->lock);
+        }
+        if (p->quitting) break;
+        seen = p->generation;
+        SDL_mutexV(p->lock);
+        work(p, self);
+        SDL_mutexP(p->lock);
+        if (--p->busy == 0) SDL_CondSignal(p->idle);
+    }
+    SDL_mutexV(p->lock);
+    return 0;
+}
+
+int init_jobs(job_pool *p, int threads) {
+    memset(p, 0, sizeof(*p));
+    p->threads = threads < 1 ? 1 : threads > MAX_JOB_THREADS ? MAX_JOB_THREADS : threads;
+    if (p->threads == 1) return 0;
+
+    p->lock = SDL_CreateMutex();
+    p->wake = SDL_CreateCond();
+    p->idle = SDL_CreateCond();
+    int ok = p->lock && p->wake && p->idle;
+    for (int t = 0; ok && t < p->threads; t++) {
+        p->queues[t].lock = SDL_CreateMutex();
+        ok = p->queues[t].lock != NULL;
+    }
+    if (!ok) {
+        LOG_ERROR(LOG_CORE, "Failed to create job pool locks: %s\n", SDL_GetError());
+        free_jobs(p);
+        p->threads = 1;
+        return -1;
+    }
+
+    int started = 0;
+    for (int i = 0; i < p->threads - 1; i++) {
+        p->workers[i] = SDL_CreateThread(job_worker, p);
+        if (!p->workers[i]) {
+            LOG_WARN(LOG_CORE, "Warning: job worker failed to start: %s\n", SDL_GetError());
+            break;
+        }
+        started++;
+    }
+    p->threads = started + 1;
+    LOG_INFO(LOG_CORE, "Job pool: %d threads\n", p->threads);
+    return 0;
+}
+
+void run_jobs(job_pool *p, int count, int batch_size, job_fn fn, void *user) {
+    if (count <= 0) return;
+    if (batch_size <= 0) batch_size = JOB_BATCH_SIZE;
+    int batches = (count + batch_size - 1) / batch_size;
+    if (p->threads == 1 || batches == 1) {
+        for (int b = 0; b < batches; b++) {
+            int first = b * batch_size;
+            fn(user, b, first, first + batch_size < count ? first + batch_size : count, 0);
+        }
+        return;
+    }
+
+    p->fn = fn;
+    p->user = user;
+    p->count = count;
+    p->batch_size = batch_size;
+    // Contiguous shares, so each thread starts on characters next to each other in memory
+    for (int t = 0; t < p->threads; t++) {
+        p->queues[t].first = batches * t / p->threads;
+        p->queues[t].last = batches * (t + 1) / p->threads;
+    }
+
+    SDL_mutexP(p->lock);
+    p->busy = p->threads - 1;
+    p->generation++;
+    SDL_CondBroadcast(p->wake);
+    SDL_mutexV(p->lock);
+
+    work(p, 0);
+
+    SDL_mutexP(p->lock);
+    while (p->busy > 0) {
+        SDL_CondWait(p->idle, p->lock);
+    }
+    SDL_mutexV(p->lock);
+}
+
+Uint32 job_steals(const job_pool *p) {
+    Uint32 total = 0;
+    for (int t = 0; t < p->threads; t++) {
+        total += p->steals[t];
+    }
+    return total;
+}
+
+void free_jobs(job_pool *p) {
+    if (p->lock) {
+        SDL_mutexP(p->lock);
+        p->quitting = 1;
+        SDL_CondBroadcast(p->wake);
+        SDL_mutexV(p->lock);
+    }
+    for (int i = 0; i < MAX_JOB_THREADS - 1; i++) {
+        if (p->workers[i]) SDL_WaitThread(p->workers[i], NULL);
+    }
+    for (int t = 0; t < MAX_JOB_THREADS; t++) {
+        if (p->queues[t].lock) SDL_DestroyMutex(p->queues[t].lock);
+    }
+    if (p->idle) SDL_DestroyCond(p->idle);
+    if (p->wake) SDL_DestroyCond(p->wake);
+    if (p->lock) SDL_DestroyMutex(p->lock);
+    memset(p, 0, sizeof(*p));
+}
@@ -0,0 +1,48 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+
+#define MAX_JOB_THREADS 8 // Including the thread that calls run_jobs
+#define JOB_BATCH_SIZE 64 // Characters per batch unless the caller picks another size
+
+// Runs items [first, last), which make up batch number batch, on worker thread
+typedef void (*job_fn)(void* user, int batch, int first, int last, int thread);
+
+// Batches not yet started, claimed from the front by their owner and stolen from the back
+typedef struct {
+    int first;
+    int last;
+    SDL_mutex* lock;
+} job_queue;
+
+// Splits a range into batches dealt out to one queue per thread. A thread that runs out
+// steals from the others, so uneven batches still finish together.
+typedef struct {
+    int threads;
+    SDL_Thread* workers[MAX_JOB_THREADS - 1];
+    job_queue queues[MAX_JOB_THREADS];
+    Uint32 steals[MAX_JOB_THREADS]; // Batches each thread took from another queue
+
+    SDL_mutex* lock;
+    SDL_cond* wake;    // Workers wait here for the next run
+    SDL_cond* idle;    // run_jobs waits here for them to finish it
+    Uint32 generation; // Bumped per run
+    int busy;          // Workers still on this run
+    int quitting;
+    int joined; // Workers started so far, each owning the next queue
+
+    job_fn fn; // The current run
+    void* user;
+    int count;
+    int batch_size;
+} job_pool;
+
+int init_jobs(job_pool* p, int threads); // threads <= 1 runs every batch on the caller
+// Returns once fn has run over every item; single-batch runs stay on the caller
+void run_jobs(job_pool* p, int count, int batch_size, job_fn fn, void* user);
+Uint32 job_steals(const job_pool* p);
+void free_jobs(job_pool* p);
+
+#endif
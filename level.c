@@ -0,0 +1,89 @@
+#include "level.h"
+#include "log.h"
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int encode_chunk(const Uint8 *tiles, int pitch, Uint8 *runs) {
+    int size = 0;
+    int count = 0;
+    Uint8 tile = 0;
+    for (int i = 0; i < CHUNK_TILE_COUNT; i++) {
+        Uint8 t = tiles[(i / CHUNK_TILES) * pitch + i % CHUNK_TILES];
+        if (count > 0 && (t != tile || count == 255)) {
+            runs[size++] = (Uint8)count;
+            runs[size++] = tile;
+            count = 0;
+        }
+        tile = t;
+        count++;
+    }
+    runs[size++] = (Uint8)count;
+    runs[size++] = tile;
+    return size;
+}
+
+int decode_chunk(const Uint8 *runs, int size, Uint8 *tiles) {
+    int filled = 0;
+    for (int i = 0; i + 1 < size; i += 2) {
+        int count = runs[i];
+        if (count == 0 || runs[i + 1] >= TILE_KIND_COUNT || filled + count > CHUNK_TILE_COUNT) return -1;
+        memset(tiles + filled, runs[i + 1], count);
+        filled += count;
+    }
+    return filled == CHUNK_TILE_COUNT && size % 2 == 0 ? 0 : -1;
+}
+
+int save_level(const char *path, const Uint8 *tiles, int width_chunks, int height_chunks) {
+    int chunk_count = width_chunks * height_chunks;
+    Uint32 *offsets = malloc((chunk_count + 1) * sizeof(Uint32));
+    Uint8 *runs = malloc((size_t)chunk_count * CHUNK_RUNS_MAX);
+    if (!offsets || !runs) {
+        LOG_ERROR(LOG_CORE, "Out of memory saving a %dx%d chunk level\n", width_chunks, height_chunks);
+        free(offsets);
+        free(runs);
+        return -1;
+    }
+
+    int pitch = width_chunks * CHUNK_TILES;
+    Uint32 offset = sizeof(level_header) + (chunk_count + 1) * sizeof(Uint32);
+    Uint32 used = 0;
+    for (int c = 0; c < chunk_count; c++) {
+        const Uint8 *first = tiles + (c / width_chunks) * CHUNK_TILES * pitch + (c % width_chunks) * CHUNK_TILES;
+        offsets[c] = offset + used;
+        used += encode_chunk(first, pitch, runs + used);
+    }
+    offsets[chunk_count] = offset + used;
+
+    level_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LEVEL_MAGIC, 8);
+    header.version = LEVEL_VERSION;
+    header.width_chunks = width_chunks;
+    header.height_chunks = height_chunks;
+    header.tile_size = TILE_SIZE;
+    header.chunk_tiles = CHUNK_TILES;
+
+    // Written aside and renamed, so a running game never streams half a level
+    char temp[256];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE *out = fopen(temp, "wb");
+    int status = -1;
+    if (out) {
+        fwrite(&header, sizeof(header), 1, out);
+        fwrite(offsets, sizeof(Uint32), chunk_count + 1, out);
+        fwrite(runs, 1, used, out);
+        status = fclose(out) == 0 && rename(temp, path) == 0 ? 0 : -1;
+        if (status != 0) remove(temp);
+    }
+    if (status != 0) {
+        LOG_ERROR(LOG_CORE, "Failed to write level %s\n", path);
+    } else {
+        LOG_INFO(LOG_CORE, "Level saved to %s: %dx%d chunks, %lu bytes of runs\n", path, width_chunks, height_chunks,
+                 (unsigned long)used);
+    }
+    free(offsets);
+    free(runs);
+    return status;
+}
@@ -0,0 +1,44 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <SDL/SDL.h>
+
+#define LEVEL_FILE "level.map"
+#define LEVEL_MAGIC "PTPLEVL\n"
+#define LEVEL_VERSION 1
+#define TILE_SIZE 16   // Pixels per tile side
+#define CHUNK_TILES 16 // Tiles per chunk side
+#define CHUNK_SIZE (TILE_SIZE * CHUNK_TILES)
+#define CHUNK_TILE_COUNT (CHUNK_TILES * CHUNK_TILES)
+#define CHUNK_RUNS_MAX (2 * CHUNK_TILE_COUNT) // Every tile its own run
+#define LEVEL_MAX_CHUNKS 127 // Per side, so every position fits SDL_Rect's Sint16
+#define LEVEL_GROUND_ROW 33 // Tile row under the characters' feet at GROUND_LEVEL
+
+typedef enum {
+    TILE_EMPTY, // Sky
+    TILE_GRASS,
+    TILE_DIRT,
+    TILE_STONE,
+    TILE_BRICK,
+    TILE_HILL,  // Scenery behind the fight
+    TILE_KIND_COUNT
+} tile_kind;
+
+// File layout: the header, then width_chunks * height_chunks + 1 offsets from the start of
+// the file, chunks row by row, the last one where the final chunk ends. Each chunk is a list
+// of (count, tile) byte pairs covering its tiles row by row, so one can be read and decoded
+// without touching the rest of the level.
+typedef struct {
+    char magic[8];
+    Uint32 version;
+    Uint32 width_chunks, height_chunks;
+    Uint32 tile_size, chunk_tiles; // Checked against this build's
+    Uint32 reserved;
+} level_header;
+
+// tiles holds the whole level row by row, width_chunks * CHUNK_TILES tiles across
+int save_level(const char* path, const Uint8* tiles, int width_chunks, int height_chunks);
+int encode_chunk(const Uint8* tiles, int pitch, Uint8* runs); // Returns the bytes written
+int decode_chunk(const Uint8* runs, int size, Uint8* tiles); // -1 unless the runs cover the chunk exactly
+
+#endif
@@ -0,0 +1,214 @@
+#include "loader.h"
+#include "log.h"
+#include "timing.h"
+#include <SDL/SDL.h>
+#include <SDL/SDL_image.h>
+#include <SDL/SDL_thread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Slots are claimed and freed by the main thread only; the lists below are shared with the worker
+static load_request jobs[MAX_LOAD_JOBS];
+static int job_used[MAX_LOAD_JOBS];
+static int pending = 0;
+static Uint32 next_sequence = 0;
+
+static load_request *queue[MAX_LOAD_JOBS]; // Max-heap on priority
+static int queue_count = 0;
+static load_request *done[MAX_LOAD_JOBS];  // Decoded, waiting for the main thread
+static int done_count = 0;
+
+static SDL_mutex *lock = NULL;
+static SDL_cond *wake = NULL;
+static SDL_Thread *worker = NULL;
+static int quitting = 0;
+
+static int before(const load_request *a, const load_request *b) {
+    if (a->priority != b->priority) return a->priority > b->priority;
+    return (Sint32)(a->sequence - b->sequence) < 0;
+}
+
+static void heap_push(load_request *r) {
+    int i = queue_count++;
+    while (i > 0 && before(r, queue[(i - 1) / 2])) {
+        queue[i] = queue[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    queue[i] = r;
+}
+
+static load_request *heap_pop(void) {
+    load_request *top = queue[0];
+    load_request *last = queue[--queue_count];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= queue_count) break;
+        if (child + 1 < queue_count && before(queue[child + 1], queue[child])) child++;
+        if (!before(queue[child], last)) break;
+        queue[i] = queue[child];
+        i = child;
+    }
+    if (queue_count > 0) queue[i] = last;
+    return top;
+}
+
+static void decode(load_request *r) {
+    if (r->kind == LOAD_IMAGE) {
+        r->result = IMG_Load(r->filename);
+        if (!r->result) {
+            LOG_ERROR(LOG_CORE, "Error loading %s: %s\n", r->filename, IMG_GetError());
+        }
+        return;
+    }
+
+    FILE *f = fopen(r->filename, "rb");
+    if (!f) {
+        LOG_ERROR(LOG_CORE, "Failed to open %s\n", r->filename);
+        return;
+    }
+    fseek(f, 0, SEEK_END);
+    r->size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    r->result = malloc(r->size > 0 ? r->size : 1);
+    if (!r->result || fread(r->result, 1, r->size, f) != (size_t)r->size) {
+        LOG_ERROR(LOG_CORE, "Failed to read %s\n", r->filename);
+        free(r->result);
+        r->result = NULL;
+        r->size = 0;
+    }
+    fclose(f);
+}
+
+static int loader_thread(void *unused) {
+    (void)unused;
+    SDL_mutexP(lock);
+    while (!quitting) {
+        if (queue_count == 0) {
+            SDL_CondWait(wake, lock);
+            continue;
+        }
+        load_request *r = heap_pop();
+        SDL_mutexV(lock);
+
+        decode(r);
+        LOG_DEBUG(LOG_CORE, "Loader decoded %s\n", r->filename);
+
+        SDL_mutexP(lock);
+        done[done_count++] = r;
+    }
+    SDL_mutexV(lock);
+    return 0;
+}
+
+int init_loader(void) {
+    if (worker) return 0;
+    lock = SDL_CreateMutex();
+    wake = SDL_CreateCond();
+    quitting = 0;
+    worker = lock && wake ? SDL_CreateThread(loader_thread, NULL) : NULL;
+    if (!worker) {
+        LOG_ERROR(LOG_CORE, "Failed to start the loader thread: %s\n", SDL_GetError());
+        if (wake) SDL_DestroyCond(wake);
+        if (lock) SDL_DestroyMutex(lock);
+        wake = NULL;
+        lock = NULL;
+        return -1;
+    }
+    LOG_INFO(LOG_CORE, "Loader thread started\n");
+    return 0;
+}
+
+int loader_running(void) {
+    return worker != NULL;
+}
+
+int queue_load(const char *filename, load_kind kind, int priority, load_finish_fn finish, void *user) {
+    if (!worker) return -1;
+
+    int slot = -1;
+    for (int i = 0; i < MAX_LOAD_JOBS && slot < 0; i++) {
+        if (!job_used[i]) slot = i;
+    }
+    if (slot < 0) {
+        LOG_ERROR(LOG_CORE, "Loader queue full (max %d), cannot load %s\n", MAX_LOAD_JOBS, filename);
+        return -1;
+    }
+
+    load_request *r = &jobs[slot];
+    memset(r, 0, sizeof(*r));
+    strncpy(r->filename, filename, sizeof(r->filename) - 1);
+    r->kind = kind;
+    r->priority = priority;
+    r->sequence = next_sequence++;
+    r->finish = finish;
+    r->user = user;
+    job_used[slot] = 1;
+    pending++;
+
+    SDL_mutexP(lock);
+    heap_push(r);
+    SDL_CondSignal(wake);
+    SDL_mutexV(lock);
+    return 0;
+}
+
+static void finish_job(load_request *r) {
+    r->finish(r, r->result, r->size);
+    job_used[r - jobs] = 0;
+    pending--;
+}
+
+int pump_loader(double budget_seconds) {
+    if (!worker) return 0;
+
+    // At least one job per call, so a slow conversion can't stall loading entirely
+    double start = clock_now();
+    do {
+        SDL_mutexP(lock);
+        load_request *r = NULL;
+        if (done_count > 0) {
+            r = done[0];
+            memmove(done, done + 1, --done_count * sizeof(done[0]));
+        }
+        SDL_mutexV(lock);
+        if (!r) break;
+        finish_job(r);
+    } while (clock_now() - start < budget_seconds);
+    return pending;
+}
+
+int loader_pending(void) {
+    return pending;
+}
+
+void wait_loader(void) {
+    while (pump_loader(1e9) > 0) {
+        SDL_Delay(1);
+    }
+}
+
+void shutdown_loader(void) {
+    if (!worker) return;
+
+    SDL_mutexP(lock);
+    quitting = 1;
+    SDL_CondSignal(wake);
+    SDL_mutexV(lock);
+    SDL_WaitThread(worker, NULL);
+    worker = NULL;
+
+    // Decoded jobs still finish normally; queued ones are cancelled
+    for (int i = 0; i < done_count; i++) {
+        finish_job(done[i]);
+    }
+    done_count = 0;
+    while (queue_count > 0) {
+        finish_job(heap_pop());
+    }
+    SDL_DestroyCond(wake);
+    SDL_DestroyMutex(lock);
+    wake = NULL;
+    lock = NULL;
+}
@@ -0,0 +1,44 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <SDL/SDL.h>
+
+#define MAX_LOAD_JOBS 64
+#define LOAD_BUDGET_MS 2.0 // Main-thread finishing work per frame
+
+// Loader priorities, higher first
+#define LOAD_PRIORITY_LOW 0
+#define LOAD_PRIORITY_NORMAL 50
+#define LOAD_PRIORITY_HIGH 100
+
+typedef enum {
+    LOAD_IMAGE, // Decoded with IMG_Load into a surface
+    LOAD_FILE   // Read whole into memory
+} load_kind;
+
+typedef struct load_request load_request;
+
+// Runs on the main thread once the worker is done; result is NULL on failure.
+// Owns the result: a surface for LOAD_IMAGE, malloc'd bytes for LOAD_FILE.
+typedef void (*load_finish_fn)(load_request* r, void* result, long size);
+
+struct load_request {
+    char filename[64];
+    load_kind kind;
+    int priority;
+    Uint32 sequence; // Keeps equal priorities first come, first served
+    load_finish_fn finish;
+    void* user;
+    void* result;
+    long size;
+};
+
+int init_loader(void); // Starts the worker thread
+int loader_running(void);
+int queue_load(const char* filename, load_kind kind, int priority, load_finish_fn finish, void* user);
+int pump_loader(double budget_seconds); // Finishes decoded jobs; returns how many are still pending
+int loader_pending(void);
+void wait_loader(void); // Finishes everything queued, however long it takes
+void shutdown_loader(void); // Unfinished jobs get a NULL result
+
+#endif
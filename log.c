@@ -0,0 +1,316 @@
+#include "log.h"
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_LINE_BYTES 512
+#define LOG_FORMAT_TABLE 1024 // Distinct format strings in a binary log
+
+// Bounded multi-producer queue (Vyukov): each cell's sequence number says
+// whether it is free for the producer at that position or ready to read
+typedef struct {
+    atomic_size_t seq;
+    log_record record;
+} log_cell;
+
+static log_cell ring[LOG_RING_SIZE];
+static atomic_size_t enqueue_pos;
+static size_t dequeue_pos;
+static atomic_int running = 0;
+static atomic_uint dropped;
+static SDL_Thread *writer = NULL;
+static FILE *binary_file = NULL;
+static FILE *text_stream = NULL;
+static const char *written_formats[LOG_FORMAT_TABLE];
+
+static const char *level_names[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR"};
+static const char *category_names[] = {"core", "render", "anim", "input", "physics"};
+
+const char *log_level_name(int level) {
+    return level >= 0 && level <= LOG_LEVEL_ERROR ? level_names[level] : "?";
+}
+
+const char *log_category_name(int category) {
+    return category >= 0 && category < LOG_CATEGORY_COUNT ? category_names[category] : "?";
+}
+
+// Walks one conversion spec starting after '%'; returns its conversion character.
+// *modifiers is left on the first length modifier, *fmt on the conversion
+static char parse_spec(const char **fmt, const char **modifiers, int *longs) {
+    const char *f = *fmt;
+    *longs = 0;
+    while (*f && strchr("-+ #0123456789.", *f)) f++;
+    *modifiers = f;
+    while (*f == 'l' || *f == 'h' || *f == 'z') {
+        if (*f == 'l' || *f == 'z') (*longs)++;
+        f++;
+    }
+    *fmt = f;
+    return *f;
+}
+
+static void capture_args(log_record *r, const char *fmt, va_list args) {
+    r->arg_count = 0;
+    r->strings_used = 0;
+    for (const char *f = fmt; *f; f++) {
+        if (*f != '%') continue;
+        f++;
+        if (*f == '%') continue;
+
+        const char *modifiers;
+        int longs;
+        char conv = parse_spec(&f, &modifiers, &longs);
+        if (!conv) break;
+        if (r->arg_count == LOG_MAX_ARGS) break;
+
+        log_arg *a = &r->args[r->arg_count++];
+        switch (conv) {
+            case 'd': case 'i': case 'c':
+                a->i = longs >= 2 ? va_arg(args, long long) : longs == 1 ? va_arg(args, long) : va_arg(args, int);
+                break;
+            case 'u': case 'x': case 'X': case 'o':
+                a->i = longs >= 2 ? (long long)va_arg(args, unsigned long long)
+                     : longs == 1 ? (long long)va_arg(args, unsigned long)
+                     : (long long)va_arg(args, unsigned int);
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+                a->f = va_arg(args, double);
+                break;
+            case 'p':
+                a->p = va_arg(args, void *);
+                break;
+            case 's': {
+                const char *s = va_arg(args, const char *);
+                if (!s) s = "(null)";
+                size_t room = LOG_STRING_BYTES - r->strings_used;
+                size_t len = strlen(s);
+                if (room == 0) {
+                    a->i = LOG_STRING_BYTES - 1;
+                    break;
+                }
+                if (len >= room) len = room - 1;
+                a->i = r->strings_used;
+                memcpy(r->strings + r->strings_used, s, len);
+                r->strings[r->strings_used + len] = '\0';
+                r->strings_used += len + 1;
+                break;
+            }
+            default:
+                a->i = 0;
+                break;
+        }
+    }
+}
+
+int log_format(const char *fmt, const log_arg *args, const char *strings, char *out, size_t size) {
+    size_t len = 0;
+    int n = 0;
+    for (const char *f = fmt; *f && len + 1 < size; f++) {
+        if (*f != '%') {
+            out[len++] = *f;
+            continue;
+        }
+        const char *start = f++;
+        if (*f == '%') {
+            out[len++] = '%';
+            continue;
+        }
+
+        const char *modifiers;
+        int longs;
+        char conv = parse_spec(&f, &modifiers, &longs);
+        if (!conv) break;
+        if (n == LOG_MAX_ARGS) break;
+        const log_arg *a = &args[n++];
+
+        // Rebuild the spec without its length modifier; integers are stored as long long
+        char spec[32];
+        size_t spec_len = (size_t)(modifiers - start);
+        if (spec_len > sizeof(spec) - 4) spec_len = sizeof(spec) - 4;
+        memcpy(spec, start, spec_len);
+        int is_integer = strchr("diuxXo", conv) != NULL;
+        if (is_integer) {
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = 'l';
+        }
+        spec[spec_len++] = conv;
+        spec[spec_len] = '\0';
+
+        int written;
+        switch (conv) {
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+                written = snprintf(out + len, size - len, spec, a->f);
+                break;
+            case 'p':
+                written = snprintf(out + len, size - len, spec, a->p);
+                break;
+            case 's':
+                written = snprintf(out + len, size - len, spec, strings + a->i);
+                break;
+            case 'c':
+                written = snprintf(out + len, size - len, spec, (int)a->i);
+                break;
+            default:
+                written = is_integer ? snprintf(out + len, size - len, spec, a->i) : 0;
+                break;
+        }
+        if (written > 0) len += (size_t)written < size - len ? (size_t)written : size - len - 1;
+    }
+    out[len] = '\0';
+    return (int)len;
+}
+
+static void write_text(const log_record *r) {
+    char line[LOG_LINE_BYTES];
+    log_format(r->fmt, r->args, r->strings, line, sizeof(line));
+    fprintf(text_stream ? text_stream : stdout, "%8u %-5s %-7s %s", r->time, log_level_name(r->level), log_category_name(r->category), line);
+}
+
+// Binary layout: 'F' id len text defines a format string, 'R' id time header args strings is a message
+static void write_binary(const log_record *r) {
+    Uint32 id = (Uint32)(((size_t)r->fmt >> 3) % LOG_FORMAT_TABLE);
+    while (written_formats[id] && written_formats[id] != r->fmt) {
+        id = (id + 1) % LOG_FORMAT_TABLE;
+    }
+    if (!written_formats[id]) {
+        Uint32 len = (Uint32)strlen(r->fmt);
+        written_formats[id] = r->fmt;
+        fputc('F', binary_file);
+        fwrite(&id, sizeof(id), 1, binary_file);
+        fwrite(&len, sizeof(len), 1, binary_file);
+        fwrite(r->fmt, 1, len, binary_file);
+    }
+    fputc('R', binary_file);
+    fwrite(&id, sizeof(id), 1, binary_file);
+    fwrite(&r->time, sizeof(r->time), 1, binary_file);
+    Uint8 header[4] = {r->level, r->category, r->arg_count, r->strings_used};
+    fwrite(header, 1, sizeof(header), binary_file);
+    fwrite(r->args, sizeof(log_arg), r->arg_count, binary_file);
+    fwrite(r->strings, 1, r->strings_used, binary_file);
+}
+
+static int drain(void) {
+    int count = 0;
+    for (;;) {
+        log_cell *cell = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        if ((long)(seq - (dequeue_pos + 1)) < 0) break;
+
+        if (binary_file) {
+            write_binary(&cell->record);
+        } else {
+            write_text(&cell->record);
+        }
+        atomic_store_explicit(&cell->seq, dequeue_pos + LOG_RING_SIZE, memory_order_release);
+        dequeue_pos++;
+        count++;
+    }
+
+    unsigned lost = atomic_exchange(&dropped, 0);
+    if (lost && !binary_file) {
+        fprintf(text_stream ? text_stream : stdout, "%8u %-5s %-7s %u messages dropped (log ring full)\n",
+                SDL_GetTicks(), "WARN", "core", lost);
+    }
+    if (count || lost) {
+        fflush(binary_file ? binary_file : text_stream ? text_stream : stdout);
+    }
+    return count;
+}
+
+static int log_thread(void *data) {
+    while (atomic_load(&running)) {
+        if (drain() == 0) {
+            SDL_Delay(1);
+        }
+    }
+    drain();
+    return 0;
+}
+
+void init_log(const char *binary_path) {
+    if (writer) return;
+
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+        atomic_init(&ring[i].seq, i);
+    }
+    atomic_store(&enqueue_pos, 0);
+    dequeue_pos = 0;
+
+    if (binary_path) {
+        binary_file = fopen(binary_path, "wb");
+        if (!binary_file) {
+            printf("Failed to open binary log %s, logging text instead\n", binary_path);
+        } else {
+            fwrite("PTPLOG1\n", 1, 8, binary_file);
+        }
+    }
+
+    atomic_store(&running, 1);
+    writer = SDL_CreateThread(log_thread, NULL);
+    if (!writer) {
+        atomic_store(&running, 0);
+        printf("Failed to start log thread: %s\n", SDL_GetError());
+        return;
+    }
+    atexit(shutdown_log);
+}
+
+void log_set_stream(FILE *stream) {
+    text_stream = stream;
+}
+
+void shutdown_log(void) {
+    if (!writer) return;
+    atomic_store(&running, 0);
+    SDL_WaitThread(writer, NULL);
+    writer = NULL;
+    if (binary_file) {
+        fclose(binary_file);
+        binary_file = NULL;
+    }
+}
+
+void log_write(int level, log_category category, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+
+    if (!atomic_load_explicit(&running, memory_order_relaxed)) {
+        // No writer thread yet (or already stopped): print synchronously
+        vfprintf(text_stream ? text_stream : stdout, fmt, args);
+        va_end(args);
+        return;
+    }
+
+    size_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    log_cell *cell;
+    for (;;) {
+        cell = &ring[pos & (LOG_RING_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        long diff = (long)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            va_end(args);
+            return;
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    log_record *r = &cell->record;
+    r->time = SDL_GetTicks();
+    r->level = (Uint8)level;
+    r->category = (Uint8)category;
+    r->fmt = fmt;
+    capture_args(r, fmt, args);
+    va_end(args);
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+}
@@ -0,0 +1,95 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <SDL/SDL.h>
+#include <stdio.h>
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARN 3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF 5
+
+// Messages below this level are compiled out entirely (set with make LOG_LEVEL=...)
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+typedef enum {
+    LOG_CORE,
+    LOG_RENDER,
+    LOG_ANIM,
+    LOG_INPUT,
+    LOG_PHYSICS,
+    LOG_CATEGORY_COUNT
+} log_category;
+
+// Bitmask of categories compiled in, one bit per log_category
+#ifndef LOG_CATEGORIES
+#define LOG_CATEGORIES 0xFF
+#endif
+
+#define LOG_MAX_ARGS 8
+#define LOG_STRING_BYTES 64
+#define LOG_RING_SIZE 4096 // Must be a power of two
+
+typedef union {
+    long long i;
+    double f;
+    const void* p;
+} log_arg;
+
+// Arguments are captured raw and only formatted on the writer thread or offline
+typedef struct {
+    Uint32 time;
+    Uint8 level;
+    Uint8 category;
+    Uint8 arg_count;
+    Uint8 strings_used;
+    const char* fmt; // Must be a string literal
+    log_arg args[LOG_MAX_ARGS];
+    char strings[LOG_STRING_BYTES]; // %s arguments, copied inline
+} log_record;
+
+void init_log(const char* binary_path); // NULL writes text to stdout
+void shutdown_log(void);
+void log_set_stream(FILE* stream); // Text output, stdout by default
+void log_write(int level, log_category category, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+int log_format(const char* fmt, const log_arg* args, const char* strings, char* out, size_t size);
+const char* log_level_name(int level);
+const char* log_category_name(int category);
+
+#define LOG_COMPILED(level, category) (LOG_LEVEL <= (level) && ((LOG_CATEGORIES >> (category)) & 1))
+
+#if LOG_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(category, ...) do { if (LOG_COMPILED(LOG_LEVEL_TRACE, category)) log_write(LOG_LEVEL_TRACE, category, __VA_ARGS__); } while (0)
+#else
+#define LOG_TRACE(category, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(category, ...) do { if (LOG_COMPILED(LOG_LEVEL_DEBUG, category)) log_write(LOG_LEVEL_DEBUG, category, __VA_ARGS__); } while (0)
+#else
+#define LOG_DEBUG(category, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(category, ...) do { if (LOG_COMPILED(LOG_LEVEL_INFO, category)) log_write(LOG_LEVEL_INFO, category, __VA_ARGS__); } while (0)
+#else
+#define LOG_INFO(category, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(category, ...) do { if (LOG_COMPILED(LOG_LEVEL_WARN, category)) log_write(LOG_LEVEL_WARN, category, __VA_ARGS__); } while (0)
+#else
+#define LOG_WARN(category, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(category, ...) do { if (LOG_COMPILED(LOG_LEVEL_ERROR, category)) log_write(LOG_LEVEL_ERROR, category, __VA_ARGS__); } while (0)
+#else
+#define LOG_ERROR(category, ...) ((void)0)
+#endif
+
+#endif
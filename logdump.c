@@ -0,0 +1,69 @@
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_FORMATS 1024
+
+// Formats a binary log written with init_log(path) back into text
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <binary log>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        printf("Failed to open %s\n", argv[1]);
+        return 1;
+    }
+
+    char magic[8];
+    if (fread(magic, 1, 8, f) != 8 || memcmp(magic, "PTPLOG1\n", 8) != 0) {
+        printf("%s is not a binary log\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+
+    static char *formats[MAX_FORMATS];
+    long records = 0;
+    int tag;
+    while ((tag = fgetc(f)) != EOF) {
+        Uint32 id;
+        if (fread(&id, sizeof(id), 1, f) != 1 || id >= MAX_FORMATS) break;
+
+        if (tag == 'F') {
+            Uint32 len;
+            if (fread(&len, sizeof(len), 1, f) != 1) break;
+            free(formats[id]);
+            formats[id] = malloc(len + 1);
+            if (!formats[id] || fread(formats[id], 1, len, f) != len) break;
+            formats[id][len] = '\0';
+        } else if (tag == 'R') {
+            Uint32 time;
+            Uint8 header[4];
+            log_arg args[LOG_MAX_ARGS];
+            char strings[LOG_STRING_BYTES + 1];
+            if (fread(&time, sizeof(time), 1, f) != 1 || fread(header, 1, 4, f) != 4) break;
+            if (header[2] > LOG_MAX_ARGS || header[3] > LOG_STRING_BYTES) break;
+            if (fread(args, sizeof(log_arg), header[2], f) != header[2]) break;
+            if (fread(strings, 1, header[3], f) != header[3]) break;
+            strings[header[3]] = '\0';
+
+            char line[512];
+            log_format(formats[id] ? formats[id] : "<unknown format>\n", args, strings, line, sizeof(line));
+            printf("%8u %-5s %-7s %s", time, log_level_name(header[0]), log_category_name(header[1]), line);
+            records++;
+        } else {
+            printf("Corrupt record tag 0x%02x\n", tag);
+            break;
+        }
+    }
+
+    fclose(f);
+    for (int i = 0; i < MAX_FORMATS; i++) {
+        free(formats[i]);
+    }
+    fprintf(stderr, "%ld records\n", records);
+    return 0;
+}
@@ -1,32 +1,118 @@
 #include "perso.h"
+#include "assets.h"
+#include "hud.h"
+#include "text.h"
+#include "log.h"
+#include "timing.h"
+#include "input.h"
+#include "dirty.h"
+#include "blit.h"
+#include "pack.h"
+#include "loader.h"
+#include "profile.h"
+#include "combat.h"
+#include "scale.h"
+#include "compose.h"
+#include "match.h"
+#include "netplay.h"
+#include "replay.h"
+#include "world.h"
+#include "effects.h"
 #include <SDL/SDL.h>
 #include <SDL/SDL_image.h>
 #include <SDL/SDL_ttf.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define SCREEN_WIDTH 1024
-#define SCREEN_HEIGHT 767
-#define FULLSCREEN_WIDTH 1920	
+#define SCREEN_WIDTH 960
+#define SCREEN_HEIGHT 540
+#define FULLSCREEN_WIDTH 1920
 #define FULLSCREEN_HEIGHT 1080
 
+// One tick's commands: both players' keys plus what the event loop saw since the last tick
+static void sample_commands(match_commands *cmd, Uint8 attacks[2], Uint8 *events) {
+    cmd->inputs[0] = lire_input_clavier(1) | attacks[0];
+    cmd->inputs[1] = lire_input_clavier(2) | attacks[1];
+    cmd->events = *events;
+    attacks[0] = attacks[1] = 0;
+    *events = 0;
+}
+
+// A parameter rather than a local, so builds that compile LOG_INFO out don't warn it's unused
+static void log_fast_replay(const replay *r, Uint32 hash, double seconds) {
+    LOG_INFO(LOG_CORE, "Replay: %u ticks in %.3f s, %.0f ticks/s, state %08x %s\n", r->tick_count, seconds,
+             seconds > 0 ? r->tick_count / seconds : 0.0, hash,
+             hash == r->final_hash ? "as recorded" : "DIFFERS from the recording");
+}
+
 int main(int argc, char *argv[]) {
+    const char *binary_log = NULL;
+    int tick_rate = DEFAULT_TICK_RATE;
+    int frame_rate = DEFAULT_FRAME_RATE;
+    int use_dirty = 1;
+    scale_mode scaling = SCALE_INTEGER;
+    int compose_threads = compose_cpu_count();
+    int band_height = COMPOSE_BAND_HEIGHT;
+    const char *profile_csv = NULL;
+    int netplay_player = 0; // 1 or 2 to play against another process over loopback UDP
+    int netplay_port = NETPLAY_PORT;
+    int latency_ms = 0;
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    int replay_fast = 0; // As fast as possible with rendering off, then exit
+    const char *level_path = LEVEL_FILE;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--binlog") == 0 && i + 1 < argc) {
+            binary_log = argv[++i];
+        } else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+            tick_rate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            frame_rate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--full-redraw") == 0) {
+            use_dirty = 0;
+        } else if (strcmp(argv[i], "--fit") == 0) {
+            scaling = SCALE_FIT;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            compose_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--band-height") == 0 && i + 1 < argc) {
+            band_height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc) {
+            profile_csv = argv[++i];
+        } else if (strcmp(argv[i], "--netplay") == 0 && i + 1 < argc) {
+            netplay_player = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            netplay_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc) {
+            latency_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--fast") == 0) {
+            replay_fast = 1;
+        } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            level_path = argv[++i];
+        }
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        printf("SDL_Init failed: %s\n", SDL_GetError());
+        LOG_ERROR(LOG_CORE, "SDL_Init failed: %s\n", SDL_GetError());
         return 1;
     }
-    printf("SDL initialized\n");
+    init_log(binary_log);
+    LOG_INFO(LOG_CORE, "SDL initialized\n");
 
     if (TTF_Init() < 0) {
-        printf("TTF_Init failed: %s\n", TTF_GetError());
+        LOG_ERROR(LOG_CORE, "TTF_Init failed: %s\n", TTF_GetError());
         SDL_Quit();
         return 1;
     }
-    printf("SDL_ttf initialized\n");
+    LOG_INFO(LOG_CORE, "SDL_ttf initialized\n");
 
     TTF_Font *font = TTF_OpenFont("arial.ttf", 20);
     if (font == NULL) {
-        printf("Failed to load font: %s\n", TTF_GetError());
+        LOG_ERROR(LOG_CORE, "Failed to load font: %s\n", TTF_GetError());
         TTF_Quit();
         SDL_Quit();
         return 1;
@@ -35,56 +121,181 @@ int main(int argc, char *argv[]) {
     int is_fullscreen = 0;
     int current_width = SCREEN_WIDTH;
     int current_height = SCREEN_HEIGHT;
-    SDL_Surface *screen = SDL_SetVideoMode(current_width, current_height, 32, SDL_HWSURFACE | SDL_DOUBLEBUF);
+    // Frames are drawn into the scaler's back buffer and only scaled rects reach the screen
+    Uint32 video_flags = SDL_SWSURFACE;
+    SDL_Surface *screen = SDL_SetVideoMode(current_width, current_height, 32, video_flags);
     if (!screen) {
-        printf("SDL_SetVideoMode failed: %s\n", SDL_GetError());
+        LOG_ERROR(LOG_CORE, "SDL_SetVideoMode failed: %s\n", SDL_GetError());
         TTF_CloseFont(font);
         TTF_Quit();
         SDL_Quit();
         return 1;
     }
-    printf("Screen created: %dx%d, format=%d bpp\n", current_width, current_height, screen->format->BitsPerPixel);
+    LOG_INFO(LOG_CORE, "Screen created: %dx%d, format=%d bpp\n", current_width, current_height, screen->format->BitsPerPixel);
+    init_blit();
+
+    scaler scaler;
+    if (init_scaler(&scaler, screen, scaling) != 0) {
+        TTF_CloseFont(font);
+        TTF_Quit();
+        SDL_Quit();
+        return 1;
+    }
+    SDL_Surface *back = scaler.back;
+    set_asset_target(back);
+    compositor compose;
+    if (init_compositor(&compose, back, compose_threads, band_height) != 0) {
+        init_compositor(&compose, back, 1, band_height);
+    }
 
     if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
-        printf("IMG_Init failed: %s\n", IMG_GetError());
+        LOG_ERROR(LOG_CORE, "IMG_Init failed: %s\n", IMG_GetError());
+        free_compositor(&compose);
+        free_scaler(&scaler);
         TTF_CloseFont(font);
         TTF_Quit();
         SDL_Quit();
         return 1;
     }
-    printf("SDL_image initialized\n");
-
-    perso player1, player2;
-    init_perso(&player1);
-    init_perso(&player2);
-    player2.pos.x = 662;
-    int player2_visible = 0;
-
-    SDL_Surface *optimized1[6];
-    SDL_Surface *optimized2[6];
-    for (int i = 0; i < 6; i++) {
-        optimized1[i] = SDL_DisplayFormat(player1.images[i]);
-        optimized2[i] = SDL_DisplayFormat(player2.images[i]);
-        if (optimized1[i] && optimized2[i]) {
-            SDL_FreeSurface(player1.images[i]);
-            SDL_FreeSurface(player2.images[i]);
-            player1.images[i] = optimized1[i];
-            player2.images[i] = optimized2[i];
-        } else {
-            printf("Warning: Failed to optimize sprite surfaces for state %d\n", i);
+    LOG_INFO(LOG_CORE, "SDL_image initialized\n");
+
+    if (init_loader() != 0) {
+        LOG_WARN(LOG_CORE, "Warning: loading assets on the main thread\n");
+    }
+
+    match game;
+    if (init_match(&game) != 0) {
+        shutdown_loader();
+        free_compositor(&compose);
+        free_scaler(&scaler);
+        TTF_CloseFont(font);
+        IMG_Quit();
+        TTF_Quit();
+        SDL_Quit();
+        return 1;
+    }
+
+    // Without a level the fight stays on one screen, as before there were levels
+    world level;
+    load_world(&level, level_path, back);
+    if (level.file) game.map = &level.solid;
+    camera view = {0, 0, LOGICAL_WIDTH, LOGICAL_HEIGHT};
+    SDL_Rect painted = {-1, -1, 0, 0}; // View the dirty tracker's background holds
+    effects fx;
+    init_effects(&fx, 0, back, compose.band_height);
+
+    perso *player1 = &game.players[0];
+    perso *player2 = &game.players[1];
+    netplay net;
+    int use_netplay = netplay_player == 1 || netplay_player == 2;
+    if (use_netplay && init_netplay(&net, netplay_player, netplay_port, latency_ms) != 0) {
+        LOG_WARN(LOG_CORE, "Warning: netplay unavailable, playing locally\n");
+        use_netplay = 0;
+    }
+    // Over the network both players are always in, and everything that changes the match
+    // goes through the inputs
+    game.player2_visible = use_netplay;
+    Uint8 attacks[2] = {0, 0}; // INPUT_ATTACK until the next tick takes it
+    Uint8 events = 0;          // MATCH_* until the next tick takes them
+
+    replay playback, recording;
+    int playing = 0, recording_on = 0;
+    Uint32 replay_diverged = 0;
+    if (replay_path && !use_netplay) {
+        playing = load_replay(&playback, replay_path) == 0;
+        if (playing && playback.tick_count == 0) {
+            free_replay(&playback);
+            playing = 0;
+        }
+        if (playing) {
+            // The level it was recorded on, whatever --level says
+            const char *recorded = playback.level[0] ? playback.level : NULL;
+            if (!recorded != !level.file || (recorded && strcmp(recorded, level_path) != 0)) {
+                free_world(&level);
+                load_world(&level, recorded, back);
+                game.map = level.file ? &level.solid : screen_collision();
+            }
+            if (check_replay_level(&playback, game.map) != 0) {
+                free_replay(&playback);
+                playing = 0;
+            }
+        }
+        if (playing) {
+            tick_rate = playback.tick_rate;
+            game.player2_visible = playback.player2_visible;
         }
     }
-    printf("Sprite surfaces optimized\n");
-    printf("Players initialized: p1.x=%d, p1.y=%d, p2.x=%d, p2.y=%d\n", 
-           player1.pos.x, player1.pos.y, player2.pos.x, player2.pos.y);
+    if (record_path && !use_netplay) {
+        init_replay(&recording, tick_rate, game.player2_visible, level.file ? level_path : NULL, game.map);
+        recording_on = 1;
+    }
+    // Sheets still loading change how hits resolve, so a reproducible match waits for them
+    int wait_for_assets = use_netplay || playing || recording_on;
+
+    int assets_logged = 0;
+    LOG_INFO(LOG_CORE, "Players initialized: p1.x=%d, p1.y=%d, p2.x=%d, p2.y=%d\n",
+             player1->pos.x, player1->pos.y, player2->pos.x, player2->pos.y);
+
+    if (init_text("arial.ttf") != 0) {
+        LOG_WARN(LOG_CORE, "Warning: debug text disabled\n");
+    }
+    SDL_Color debug_color = {255, 255, 0};
+    text_font *debug_font = NULL; // Fetched once the font has loaded
+    int show_fps = 0;
+    int show_profile = 0;
+    int frames = 0;
+    int fps = 0;
+    Uint32 fps_timer = SDL_GetTicks();
+
+    hud hud1, hud2;
+    init_hud(&hud1, 1, font);
+    init_hud(&hud2, 2, font);
+
+    engine_clock frame_clock;
+    init_clock(&frame_clock, tick_rate, frame_rate);
+
+    dirty_tracker dirty;
+    if (use_dirty && init_dirty(&dirty, back) != 0) {
+        LOG_WARN(LOG_RENDER, "Warning: dirty rects disabled\n");
+        use_dirty = 0;
+    }
+
+    if (profile_csv) prof_open_csv(profile_csv);
 
     int running = 1;
+    int status = 0;
+    if (playing && replay_fast) {
+        // Throughput run: every tick back to back, nothing drawn
+        while (pump_loader(1.0) > 0) {
+            SDL_Delay(1);
+        }
+        if (!archetype_ready(player1->archetype)) {
+            LOG_ERROR(LOG_CORE, "Replay: character sheets failed to load\n");
+            status = 1;
+        } else {
+            double start = clock_now();
+            Uint32 hash = play_replay(&playback, &game, &frame_clock, 0, playback.tick_count, &replay_diverged);
+            log_fast_replay(&playback, hash, clock_now() - start);
+            if (replay_diverged) LOG_WARN(LOG_CORE, "Warning: replay diverged by tick %u\n", replay_diverged);
+            status = hash == playback.final_hash && !replay_diverged ? 0 : 1;
+        }
+        running = 0;
+    } else if (replay_path && replay_fast) {
+        status = 1; // Nothing to fast-forward; the error is already logged
+        running = 0;
+    }
     SDL_Event event;
     while (running) {
+        PROF_FRAME_BEGIN();
+        PROF_BEGIN(PROF_EVENTS);
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
                 running = 0;
+            } else if (event.type == SDL_KEYDOWN && playing) {
+                // The replay drives the match; only leaving is up to the keyboard
+                if (event.key.keysym.sym == SDLK_ESCAPE) running = 0;
             } else if (event.type == SDL_KEYDOWN) {
+                LOG_DEBUG(LOG_INPUT, "Key down: %d\n", event.key.keysym.sym);
                 switch (event.key.keysym.sym) {
                     case SDLK_ESCAPE:
                         running = 0;
@@ -94,87 +305,269 @@ int main(int argc, char *argv[]) {
                         if (is_fullscreen) {
                             current_width = FULLSCREEN_WIDTH;
                             current_height = FULLSCREEN_HEIGHT;
-                            screen = SDL_SetVideoMode(current_width, current_height, 32, SDL_HWSURFACE | SDL_DOUBLEBUF | SDL_FULLSCREEN);
+                            screen = SDL_SetVideoMode(current_width, current_height, 32, video_flags | SDL_FULLSCREEN);
                         } else {
                             current_width = SCREEN_WIDTH;
                             current_height = SCREEN_HEIGHT;
-                            screen = SDL_SetVideoMode(current_width, current_height, 32, SDL_HWSURFACE | SDL_DOUBLEBUF);
+                            screen = SDL_SetVideoMode(current_width, current_height, 32, video_flags);
                         }
                         if (!screen) {
-                            printf("SDL_SetVideoMode failed: %s\n", SDL_GetError());
+                            LOG_ERROR(LOG_CORE, "SDL_SetVideoMode failed: %s\n", SDL_GetError());
+                            running = 0;
+                        } else if (reset_scaler(&scaler, screen) != 0) {
                             running = 0;
                         }
                         break;
-                    case SDLK_p:
-                        player2_visible = !player2_visible;
-                        if (!player2_visible) {
-                            player2.pos.x = 662;
-                            player2.state = IDLE;
-                            player2.currentFrame = 0;
+                    case SDLK_f:
+                        show_fps = !show_fps;
+                        break;
+                    case SDLK_o:
+                        show_profile = !show_profile;
+                        if (show_profile && !PROFILE) {
+                            LOG_WARN(LOG_CORE, "Warning: profiler compiled out, rebuild with make PROFILE=1\n");
                         }
                         break;
+                    case SDLK_p:
+                        if (!use_netplay) events |= MATCH_TOGGLE_PLAYER2;
+                        break;
                     case SDLK_LSHIFT:
-                        if (player2_visible) {
-                            attack_perso(&player2);
-                        }
+                        // Over the network this process's keys all drive its own player
+                        attacks[use_netplay ? net.local : 1] = INPUT_ATTACK;
                         break;
                     case SDLK_j:
-                        trigger_hit(&player1);
+                        if (!use_netplay) events |= MATCH_HIT_PLAYER1;
                         break;
                     case SDLK_k:
-                        if (player2_visible) {
-                            trigger_hit(&player2);
-                        }
+                        if (!use_netplay) events |= MATCH_HIT_PLAYER2;
                         break;
                     default:
                         break;
                 }
-            } else if (event.type == SDL_MOUSEBUTTONDOWN) {
+            } else if (event.type == SDL_MOUSEBUTTONDOWN && !playing) {
                 if (event.button.button == SDL_BUTTON_LEFT) {
-                    attack_perso(&player1);
+                    attacks[use_netplay ? net.local : 0] = INPUT_ATTACK;
                 }
             }
         }
 
-        deplacer_perso(&player1, current_width);
-        jump_perso(&player1);
-        if (player2_visible) {
-            deplacer_perso1(&player2, current_width);
-            jump_perso1(&player2);
-            animer_perso(&player2);
+        PROF_END(PROF_EVENTS);
+
+        PROF_BEGIN(PROF_LOADER);
+        int loading = pump_loader(LOAD_BUDGET_MS / 1000.0);
+        PROF_END(PROF_LOADER);
+        if (loading == 0 && wait_for_assets && !archetype_ready(player1->archetype)) {
+            // Nothing left to load, so the match would wait for the sheets forever
+            LOG_ERROR(LOG_CORE, "%s: character sheets failed to load\n",
+                      use_netplay ? "Netplay" : playing ? "Replay" : "Recording");
+            if (recording_on) {
+                free_replay(&recording);
+                recording_on = 0;
+            }
+            status = 1;
+            break;
+        }
+        if (loading == 0 && !assets_logged) {
+            // Only logged, and each total comes with an out-parameter logged beside it
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+            int asset_count = 0;
+            size_t asset_bytes = assets_memory_usage(&asset_count);
+            LOG_INFO(LOG_CORE, "Sprite assets shared: %d sheets, %lu KB of surfaces\n", asset_count, (unsigned long)(asset_bytes / 1024));
+            size_t raw_frame_bytes = 0;
+            size_t rle_bytes = assets_rle_usage(&raw_frame_bytes);
+            LOG_INFO(LOG_CORE, "Run-length frames: %lu KB, against %lu KB as raw pixels\n",
+                     (unsigned long)(rle_bytes / 1024), (unsigned long)(raw_frame_bytes / 1024));
+            LOG_INFO(LOG_CORE, "Collision masks: %lu KB\n", (unsigned long)(assets_mask_usage() / 1024));
+#endif
+            assets_logged = 1;
         }
-        animer_perso(&player1);
 
-        SDL_FillRect(screen, NULL, SDL_MapRGB(screen->format, 0, 0, 0));
-        printf("Screen cleared to black\n");
+        int ticks = clock_begin_frame(&frame_clock);
+        Uint32 first_tick = frame_clock.tick;
+        PROF_BEGIN(PROF_SIM);
+        if (use_netplay) {
+            poll_netplay(&net);
+            if (archetype_ready(player1->archetype)) {
+                rollback_netplay(&net, &game, &frame_clock);
+                // The ticks simulated again were already shown, effects included
+                player1->events = 0;
+                player2->events = 0;
+                for (int t = 0; t < ticks; t++) {
+                    Uint8 input = lire_input_clavier(1) | attacks[net.local];
+                    if (!advance_netplay(&net, &game, &frame_clock, input)) {
+                        // Waiting for the remote; don't owe those ticks once it catches up
+                        clock_hold(&frame_clock);
+                        break;
+                    }
+                    attacks[net.local] = 0;
+                }
+            }
+            send_netplay(&net);
+        } else if (!wait_for_assets || archetype_ready(player1->archetype)) {
+            for (int t = 0; t < ticks; t++) {
+                match_commands cmd;
+                if (playing) {
+                    cmd = playback.ticks[frame_clock.tick];
+                } else {
+                    sample_commands(&cmd, attacks, &events);
+                }
+                apply_match_events(&game, cmd.events);
+                step_match(&game, cmd.inputs);
+                clock_step(&frame_clock);
+                if (recording_on && record_replay(&recording, &cmd, &game) != 0) recording_on = 0;
+                if (playing && !replay_diverged && check_replay(&playback, frame_clock.tick, &game) != 0) {
+                    LOG_WARN(LOG_CORE, "Warning: replay diverged from the recording by tick %u\n", frame_clock.tick);
+                    replay_diverged = frame_clock.tick;
+                }
 
-        SDL_Rect render_pos1 = {player1.pos.x, player1.pos.y, 0, 0};
-        SDL_Rect render_pos2 = {player2.pos.x, player2.pos.y, 0, 0};
-        printf("Render: p1.x=%d, p1.y=%d, p2.x=%d, p2.y=%d\n", 
-               render_pos1.x, render_pos1.y, render_pos2.x, render_pos2.y);
+                if (playing && frame_clock.tick == playback.tick_count) {
+                    LOG_INFO(LOG_CORE, "Replay finished after %u ticks: state %08x, %s\n", frame_clock.tick,
+                             hash_match(&game),
+                             hash_match(&game) == playback.final_hash ? "as recorded" : "DIFFERS from the recording");
+                    free_replay(&playback);
+                    playing = 0; // The keyboard takes over from here
+                }
+            }
+        } else {
+            clock_hold(&frame_clock);
+        }
+        PROF_END(PROF_SIM);
+
+        float alpha = clock_alpha(&frame_clock);
+        SDL_Rect render_pos1, render_pos2;
+        interpoler_perso(player1, alpha, &render_pos1);
+        interpoler_perso(player2, alpha, &render_pos2);
+        LOG_TRACE(LOG_RENDER, "Render: p1.x=%d, p1.y=%d, p2.x=%d, p2.y=%d\n",
+                  render_pos1.x, render_pos1.y, render_pos2.x, render_pos2.y);
+
+        PROF_BEGIN(PROF_WORLD);
+        // This process's player first, so it is the one kept in view
+        SDL_Rect focus[2] = {{render_pos1.x, render_pos1.y, player1->pos.w, player1->pos.h},
+                             {render_pos2.x, render_pos2.y, player2->pos.w, player2->pos.h}};
+        if (use_netplay && net.local == 1) {
+            SDL_Rect local = focus[1];
+            focus[1] = focus[0];
+            focus[0] = local;
+        }
+        follow_camera(&view, &level, focus, game.player2_visible ? 2 : 1);
+        int streamed = stream_world(&level, &view);
+        if (use_dirty && (streamed > 0 || view.x != painted.x || view.y != painted.y)) {
+            paint_world(&level, &view, dirty.background);
+            dirty_redraw(&dirty);
+            painted.x = view.x;
+            painted.y = view.y;
+        }
+        render_pos1.x -= view.x;
+        render_pos1.y -= view.y;
+        render_pos2.x -= view.x;
+        render_pos2.y -= view.y;
+        PROF_END(PROF_WORLD);
+
+        PROF_BEGIN(PROF_CLEAR);
+        if (use_dirty) {
+            dirty_begin_frame(&dirty, back);
+        } else {
+            draw_world(&level, &view, &compose);
+            LOG_TRACE(LOG_RENDER, "Background drawn at %d,%d\n", view.x, view.y);
+        }
+        PROF_END(PROF_CLEAR);
+
+        PROF_BEGIN(PROF_DRAW);
+        afficher_perso(player1, &compose, &render_pos1);
+        if (use_dirty) dirty_add(&dirty, back, &render_pos1);
+        if (game.player2_visible) {
+            afficher_perso(player2, &compose, &render_pos2);
+            if (use_dirty) dirty_add(&dirty, back, &render_pos2);
+        }
 
-        afficher_perso(&player1, screen, &render_pos1);
-        if (player2_visible) {
-            afficher_perso(&player2, screen, &render_pos2);
+        PROF_END(PROF_DRAW);
+
+        PROF_BEGIN(PROF_EFFECTS);
+        // Particles move with the simulation, so they stop when it waits
+        SDL_Rect fx_area;
+        perso_effects(&fx, player1);
+        perso_effects(&fx, player2);
+        update_effects(&fx, (float)((frame_clock.tick - first_tick) * frame_clock.tick_seconds));
+        draw_effects(&fx, view.x, view.y, &compose, &fx_area);
+        if (use_dirty && fx_area.w > 0) dirty_add(&dirty, back, &fx_area);
+        PROF_END(PROF_EFFECTS);
+
+        PROF_BEGIN(PROF_HUD);
+        SDL_Rect hud_area;
+        afficher_hud(&hud1, player1, &compose);
+        if (use_dirty && hud_bounds(&hud1, player1, back, &hud_area)) dirty_add(&dirty, back, &hud_area);
+        if (game.player2_visible) {
+            afficher_hud(&hud2, player2, &compose);
+            if (use_dirty && hud_bounds(&hud2, player2, back, &hud_area)) dirty_add(&dirty, back, &hud_area);
         }
+        PROF_END(PROF_HUD);
 
-        afficher_score_vie(&player1, screen, 1, font);
-        if (player2_visible) {
-            afficher_score_vie(&player2, screen, 2, font);
+        frames++;
+        if (SDL_GetTicks() - fps_timer >= 1000) {
+            fps = frames;
+            frames = 0;
+            fps_timer = SDL_GetTicks();
+        }
+        PROF_BEGIN(PROF_TEXT);
+        if ((show_fps || show_profile) && !debug_font && text_ready()) {
+            debug_font = get_text_font(14, debug_color);
+        }
+        if (show_fps && debug_font) {
+            queue_text(debug_font, 10, LOGICAL_HEIGHT - 20, "FPS: %d", fps);
+            if (use_netplay) {
+                queue_text(debug_font, 10, LOGICAL_HEIGHT - 40, "Rollback: %d ticks, %.2f ms", net.frame_depth,
+                           net.frame_resim_ms);
+            }
         }
+        if (show_profile && PROFILE && debug_font) {
+            prof_overlay(debug_font, 10, 80);
+        }
+        SDL_Rect text_area;
+        if (use_dirty && text_batch_bounds(&text_area)) dirty_add(&dirty, back, &text_area);
+        flush_text(&compose);
+        PROF_END(PROF_TEXT);
+
+        PROF_BEGIN(PROF_COMPOSE);
+        compose_flush(&compose);
+        PROF_END(PROF_COMPOSE);
 
-        SDL_Flip(screen);
-        printf("Screen updated\n");
+        PROF_BEGIN(PROF_PRESENT);
+        int update_count = use_dirty ? dirty_end_frame(&dirty, back) : -1;
+        present_scaled(&scaler, screen, update_count < 0 ? NULL : dirty.update, update_count);
+        LOG_TRACE(LOG_RENDER, "Screen updated\n");
+        PROF_END(PROF_PRESENT);
 
-        SDL_Delay(16);
+        PROF_BEGIN(PROF_WAIT);
+        clock_end_frame(&frame_clock);
+        PROF_END(PROF_WAIT);
+        PROF_FRAME_END();
     }
 
-    free_perso(&player1);
-    free_perso(&player2);
+    prof_close_csv();
+
+    if (recording_on) {
+        save_replay(&recording, record_path, hash_match(&game));
+        free_replay(&recording);
+    }
+    if (playing) free_replay(&playback);
+    if (use_netplay) {
+        log_netplay_stats(&net);
+        free_netplay(&net);
+    }
+    shutdown_loader();
+    free_match(&game);
+    free_world(&level);
+    free_effects(&fx);
+    free_hud(&hud1);
+    free_hud(&hud2);
+    free_text();
+    close_pack();
+    if (use_dirty) free_dirty(&dirty);
+    free_compositor(&compose);
+    free_scaler(&scaler);
     TTF_CloseFont(font);
     IMG_Quit();
     TTF_Quit();
     SDL_Quit();
-    printf("Cleanup complete\n");
-    return 0;
+    LOG_INFO(LOG_CORE, "Cleanup complete (%u ticks, %u frames dropped)\n", frame_clock.tick, frame_clock.dropped_frames);
+    return status;
 }
@@ -0,0 +1,79 @@
+#include "level.h"
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LEVEL_HEIGHT_CHUNKS 3
+#define DIRT_ROWS 6 // Under the grass, stone below that
+#define FLAT_COLUMNS 64 // Where the characters start, a screen's width and a bit
+#define WALL_COLUMNS 2  // Brick at both ends of the level
+#define PLATFORM_RISE 6 // Rows above the ground under it, in reach of a jump
+
+static Uint32 next_random(Uint32 *seed) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return *seed >> 8;
+}
+
+// Generates a level: flat ground at the characters' feet, then steps up and down, floating
+// brick platforms and rolling hills behind it all, walled in at both ends
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <level> [width in chunks] [seed]\n", argv[0]);
+        return 1;
+    }
+    int width_chunks = argc > 2 ? atoi(argv[2]) : 64;
+    Uint32 seed = argc > 3 ? (Uint32)atoi(argv[3]) : 1;
+    if (width_chunks < 1 || width_chunks > LEVEL_MAX_CHUNKS) {
+        printf("Width must be 1 to %d chunks\n", LEVEL_MAX_CHUNKS);
+        return 1;
+    }
+
+    int cols = width_chunks * CHUNK_TILES;
+    int rows = LEVEL_HEIGHT_CHUNKS * CHUNK_TILES;
+    Uint8 *tiles = calloc((size_t)cols * rows, 1);
+    if (!tiles) {
+        printf("Out of memory for a %dx%d tile level\n", cols, rows);
+        return 1;
+    }
+    int hill = 6;
+    int ground = LEVEL_GROUND_ROW;
+    int segment = FLAT_COLUMNS; // Columns left at this height
+    int platform = 0;           // Columns left of the current platform
+    for (int x = 0; x < cols; x++) {
+        if (x % 2 == 0) {
+            hill += (int)(next_random(&seed) % 3) - 1;
+            if (hill < 2) hill = 2;
+            if (hill > 12) hill = 12;
+        }
+        if (--segment <= 0) {
+            // Steps of up to three tiles, so walking into one stops a character but a jump clears it
+            ground += (int)(next_random(&seed) % 7) - 3;
+            if (ground < LEVEL_GROUND_ROW - 8) ground = LEVEL_GROUND_ROW - 8;
+            if (ground > LEVEL_GROUND_ROW + 4) ground = LEVEL_GROUND_ROW + 4;
+            segment = 8 + (int)(next_random(&seed) % 9);
+            if (platform <= 0 && next_random(&seed) % 3 == 0) platform = 4 + (int)(next_random(&seed) % 5);
+        }
+        int wall = x < WALL_COLUMNS || x >= cols - WALL_COLUMNS;
+        for (int y = 0; y < rows; y++) {
+            Uint8 t = TILE_EMPTY;
+            if (y > ground + DIRT_ROWS) {
+                t = TILE_STONE;
+            } else if (wall || (platform > 0 && y == ground - PLATFORM_RISE)) {
+                t = TILE_BRICK;
+            } else if (y > ground) {
+                t = TILE_DIRT;
+            } else if (y == ground) {
+                t = TILE_GRASS;
+            } else if (y >= ground - hill) {
+                t = TILE_HILL;
+            }
+            tiles[y * cols + x] = t;
+        }
+        platform--;
+    }
+
+    int status = save_level(argv[1], tiles, width_chunks, LEVEL_HEIGHT_CHUNKS);
+    free(tiles);
+    return status == 0 ? 0 : 1;
+}
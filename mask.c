@@ -0,0 +1,130 @@
+#include "mask.h"
+#include "log.h"
+#include <SDL/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+static Uint32 read_pixel(const Uint8 *p, int bpp) {
+    switch (bpp) {
+        case 1: return *p;
+        case 2: return *(const Uint16 *)p;
+        case 3:
+            if (SDL_BYTEORDER == SDL_BIG_ENDIAN) return p[0] << 16 | p[1] << 8 | p[2];
+            return p[0] | p[1] << 8 | p[2] << 16;
+        default: return *(const Uint32 *)p;
+    }
+}
+
+sprite_mask *build_mask(SDL_Surface *src, const SDL_Rect *frame) {
+    SDL_PixelFormat *f = src->format;
+    int x0 = frame->x < 0 ? 0 : frame->x;
+    int y0 = frame->y < 0 ? 0 : frame->y;
+    int x1 = frame->x + frame->w < src->w ? frame->x + frame->w : src->w;
+    int y1 = frame->y + frame->h < src->h ? frame->y + frame->h : src->h;
+    if (x1 <= x0 || y1 <= y0) return NULL;
+    int w = x1 - x0;
+    int h = y1 - y0;
+    int words = (w + 63) / 64 + 1;
+
+    sprite_mask *m = calloc(1, sizeof(sprite_mask) + 2 * (size_t)h * words * sizeof(Uint64));
+    if (!m) {
+        LOG_ERROR(LOG_CORE, "Out of memory masking a %dx%d frame\n", w, h);
+        return NULL;
+    }
+    m->w = w;
+    m->h = h;
+    m->words = words;
+    m->bits = (Uint64 *)(m + 1);
+    m->mirrored = m->bits + (size_t)h * words;
+
+    int keyed = (src->flags & SDL_SRCCOLORKEY) != 0;
+    int alpha = (src->flags & SDL_SRCALPHA) && f->Amask;
+    Uint32 key = f->colorkey & ~f->Amask;
+    if (SDL_MUSTLOCK(src) && SDL_LockSurface(src) < 0) {
+        free(m);
+        return NULL;
+    }
+
+    int bx0 = w, by0 = h, bx1 = -1, by1 = -1;
+    for (int y = 0; y < h; y++) {
+        const Uint8 *row = (const Uint8 *)src->pixels + (y0 + y) * src->pitch + x0 * f->BytesPerPixel;
+        Uint64 *bits = m->bits + (size_t)y * words;
+        Uint64 *flipped = m->mirrored + (size_t)y * words;
+        for (int x = 0; x < w; x++) {
+            Uint32 pixel = read_pixel(row + x * f->BytesPerPixel, f->BytesPerPixel);
+            if (keyed && (pixel & ~f->Amask) == key) continue;
+            if (alpha && (pixel & f->Amask) == 0) continue;
+            bits[x >> 6] |= 1ULL << (x & 63);
+            flipped[(w - 1 - x) >> 6] |= 1ULL << ((w - 1 - x) & 63);
+            if (x < bx0) bx0 = x;
+            if (x > bx1) bx1 = x;
+            if (y < by0) by0 = y;
+            by1 = y;
+        }
+    }
+    if (SDL_MUSTLOCK(src)) SDL_UnlockSurface(src);
+
+    if (bx1 >= 0) {
+        m->bounds.x = bx0;
+        m->bounds.y = by0;
+        m->bounds.w = bx1 - bx0 + 1;
+        m->bounds.h = by1 - by0 + 1;
+    }
+    return m;
+}
+
+void free_mask(sprite_mask *m) {
+    free(m);
+}
+
+size_t mask_size(const sprite_mask *m) {
+    return sizeof(sprite_mask) + 2 * (size_t)m->h * m->words * sizeof(Uint64);
+}
+
+void mask_bounds(const sprite_mask *m, int x, int y, int mirror, SDL_Rect *out) {
+    out->x = x + (mirror ? m->w - m->bounds.x - m->bounds.w : m->bounds.x);
+    out->y = y + m->bounds.y;
+    out->w = m->bounds.w;
+    out->h = m->bounds.h;
+}
+
+// 64 bits of a row starting at bit offset; the spare zero word covers the tail
+static inline Uint64 row_bits(const Uint64 *row, int offset) {
+    int word = offset >> 6;
+    int shift = offset & 63;
+    if (shift == 0) return row[word];
+    return row[word] >> shift | row[word + 1] << (64 - shift);
+}
+
+int masks_overlap(const sprite_mask *a, int ax, int ay, int amirror,
+                  const sprite_mask *b, int bx, int by, int bmirror, const SDL_Rect *clip) {
+    if (a->bounds.w == 0 || b->bounds.w == 0) return 0;
+
+    // Only the intersection of the tight boxes, and of the clip, can hold a shared pixel
+    SDL_Rect ra, rb;
+    mask_bounds(a, ax, ay, amirror, &ra);
+    mask_bounds(b, bx, by, bmirror, &rb);
+    int x0 = ra.x > rb.x ? ra.x : rb.x;
+    int y0 = ra.y > rb.y ? ra.y : rb.y;
+    int x1 = ra.x + ra.w < rb.x + rb.w ? ra.x + ra.w : rb.x + rb.w;
+    int y1 = ra.y + ra.h < rb.y + rb.h ? ra.y + ra.h : rb.y + rb.h;
+    if (clip) {
+        if (clip->x > x0) x0 = clip->x;
+        if (clip->y > y0) y0 = clip->y;
+        if (clip->x + clip->w < x1) x1 = clip->x + clip->w;
+        if (clip->y + clip->h < y1) y1 = clip->y + clip->h;
+    }
+    if (x1 <= x0 || y1 <= y0) return 0;
+
+    const Uint64 *abits = amirror ? a->mirrored : a->bits;
+    const Uint64 *bbits = bmirror ? b->mirrored : b->bits;
+    for (int y = y0; y < y1; y++) {
+        const Uint64 *arow = abits + (size_t)(y - ay) * a->words;
+        const Uint64 *brow = bbits + (size_t)(y - by) * b->words;
+        for (int x = x0; x < x1; x += 64) {
+            Uint64 keep = x1 - x >= 64 ? ~0ULL : (1ULL << (x1 - x)) - 1;
+            if (row_bits(arow, x - ax) & row_bits(brow, x - bx) & keep) return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef MASK_H
+#define MASK_H
+
+#include <SDL/SDL.h>
+
+// Opaque pixels of one frame, a bit each. Bit x of a row is bit x % 64 of word x / 64.
+typedef struct {
+    int w, h;
+    int words;        // Per row, including a zero word so shifted reads never leave the row
+    SDL_Rect bounds;  // Tight box around the set bits, frame-relative and facing right; w=0 if none
+    Uint64* bits;     // h rows
+    Uint64* mirrored; // The same rows flipped left to right
+} sprite_mask;
+
+// Colour-keyed pixels and, with per-pixel alpha, fully transparent ones are left clear
+sprite_mask* build_mask(SDL_Surface* src, const SDL_Rect* frame);
+void free_mask(sprite_mask* m);
+size_t mask_size(const sprite_mask* m);
+void mask_bounds(const sprite_mask* m, int x, int y, int mirror, SDL_Rect* out); // Tight box in world space
+
+// Whether two masks, with their frames' top-left corners at (ax, ay) and (bx, by), share a set
+// pixel; only pixels inside clip count unless it is NULL. Meant for after a rect test passed.
+int masks_overlap(const sprite_mask* a, int ax, int ay, int amirror,
+                  const sprite_mask* b, int bx, int by, int bmirror, const SDL_Rect* clip);
+
+#endif
@@ -0,0 +1,104 @@
+#include "match.h"
+#include "input.h"
+#include "profile.h"
+#include <SDL/SDL.h>
+#include <string.h>
+
+int init_match(match *m) {
+    memset(m, 0, sizeof(*m));
+    if (init_combat(&m->combat, 2) != 0) return -1;
+    m->map = screen_collision();
+    init_perso(&m->players[0]);
+    init_perso(&m->players[1]);
+    m->players[1].pos.x = PLAYER2_START_X;
+    m->players[1].prev_pos = m->players[1].pos;
+    return 0;
+}
+
+void apply_match_events(match *m, Uint8 events) {
+    perso *player2 = &m->players[1];
+    if (events & MATCH_TOGGLE_PLAYER2) {
+        m->player2_visible = !m->player2_visible;
+        if (!m->player2_visible) {
+            player2->pos.x = PLAYER2_START_X;
+            player2->prev_pos = player2->pos;
+            changer_etat_perso(player2, IDLE);
+        }
+    }
+    if (events & MATCH_HIT_PLAYER1) trigger_hit(&m->players[0]);
+    if ((events & MATCH_HIT_PLAYER2) && m->player2_visible) trigger_hit(player2);
+}
+
+void step_match(match *m, const Uint8 inputs[2]) {
+    int count = m->player2_visible ? 2 : 1;
+    for (int i = 0; i < 2; i++) {
+        perso *p = &m->players[i];
+        p->prev_pos = p->pos;
+        p->input = inputs[i] & ~INPUT_ATTACK;
+        if (i < count && (inputs[i] & INPUT_ATTACK)) attack_perso(p);
+    }
+
+    PROF_BEGIN(PROF_MOVE);
+    int queries = 0;
+    for (int i = 0; i < count; i++) {
+        queries += deplacer_perso(&m->players[i], m->map);
+        queries += jump_perso(&m->players[i], m->map);
+    }
+    PROF_COUNT(PROF_COLLIDE, queries);
+    PROF_COUNT(PROF_TICKS, 1);
+    PROF_END(PROF_MOVE);
+    PROF_BEGIN(PROF_ANIM);
+    for (int i = 0; i < count; i++) {
+        animer_perso(&m->players[i]);
+    }
+    PROF_END(PROF_ANIM);
+
+    PROF_BEGIN(PROF_COMBAT);
+    combat_body body;
+    perso_combat_body(&m->players[0], &body);
+    set_combat_body(&m->combat, 0, &body);
+    if (m->player2_visible) {
+        perso_combat_body(&m->players[1], &body);
+        set_combat_body(&m->combat, 1, &body);
+    } else {
+        remove_combat_body(&m->combat, 1);
+    }
+    int hit_count = resolve_combat(&m->combat, m->hits, MAX_COMBAT_HITS);
+    for (int h = 0; h < hit_count; h++) {
+        if (trigger_hit(&m->players[m->hits[h].target])) {
+            m->players[m->hits[h].attacker].score += HIT_SCORE;
+        }
+    }
+    PROF_END(PROF_COMBAT);
+}
+
+void save_match(const match *m, Uint32 tick, match_snapshot *out) {
+    memset(out, 0, sizeof(*out));
+    out->tick = tick;
+    out->player2_visible = (Uint8)m->player2_visible;
+    save_perso(&m->players[0], &out->players[0]);
+    save_perso(&m->players[1], &out->players[1]);
+}
+
+void load_match(match *m, const match_snapshot *s) {
+    m->player2_visible = s->player2_visible;
+    load_perso(&m->players[0], &s->players[0]);
+    load_perso(&m->players[1], &s->players[1]);
+}
+
+Uint32 hash_match(const match *m) {
+    match_snapshot s;
+    save_match(m, 0, &s);
+    const Uint8 *bytes = (const Uint8 *)&s;
+    Uint32 hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(s); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void free_match(match *m) {
+    free_perso(&m->players[0]);
+    free_perso(&m->players[1]);
+    free_combat(&m->combat);
+}
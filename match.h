@@ -0,0 +1,45 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include <SDL/SDL.h>
+#include "perso.h"
+#include "combat.h"
+
+#define PLAYER2_START_X 662
+
+// The two-player fight, advanced one tick at a time from both players' inputs
+typedef struct {
+    perso players[2];
+    int player2_visible;
+    const collision_map* map; // The level's solid tiles, the single screen's floor unless set
+    combat_grid combat; // Rebuilt from the players every tick, so snapshots leave it out
+    combat_hit hits[MAX_COMBAT_HITS];
+} match;
+
+// Debug keys, applied at the start of the next tick so recordings replay them
+#define MATCH_TOGGLE_PLAYER2 0x01
+#define MATCH_HIT_PLAYER1 0x02
+#define MATCH_HIT_PLAYER2 0x04
+
+// Everything that drives one tick: both players' INPUT_* bits and the MATCH_* events
+typedef struct {
+    Uint8 inputs[2];
+    Uint8 events;
+} match_commands;
+
+// The whole match at the start of one tick
+typedef struct {
+    Uint32 tick;
+    Uint8 player2_visible;
+    perso_snapshot players[2];
+} match_snapshot;
+
+int init_match(match* m);
+void apply_match_events(match* m, Uint8 events);
+void step_match(match* m, const Uint8 inputs[2]); // INPUT_* bits per player
+void save_match(const match* m, Uint32 tick, match_snapshot* out);
+void load_match(match* m, const match_snapshot* s);
+Uint32 hash_match(const match* m); // Of the snapshot, to check a replay ends where it did
+void free_match(match* m);
+
+#endif
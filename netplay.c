@@ -0,0 +1,198 @@
+#include "netplay.h"
+#include "log.h"
+#include "profile.h"
+#include <SDL/SDL.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// Packet: "RB", ack, first tick, count, then count inputs from the first tick on
+#define PACKET_HEADER 11
+
+static void put_u32(Uint8 *p, Uint32 v) {
+    p[0] = (Uint8)(v >> 24);
+    p[1] = (Uint8)(v >> 16);
+    p[2] = (Uint8)(v >> 8);
+    p[3] = (Uint8)v;
+}
+
+static Uint32 get_u32(const Uint8 *p) {
+    return ((Uint32)p[0] << 24) | ((Uint32)p[1] << 16) | ((Uint32)p[2] << 8) | p[3];
+}
+
+int init_netplay(netplay *n, int player, int base_port, int latency_ms) {
+    memset(n, 0, sizeof(*n));
+    n->local = player == 2 ? 1 : 0;
+    n->latency_ms = latency_ms > 0 ? latency_ms : 0;
+    n->remote_port = (Uint16)(base_port + !n->local);
+
+    n->socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (n->socket < 0) {
+        LOG_ERROR(LOG_CORE, "Netplay socket failed: %s\n", strerror(errno));
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((Uint16)(base_port + n->local));
+    if (bind(n->socket, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        fcntl(n->socket, F_SETFL, fcntl(n->socket, F_GETFL) | O_NONBLOCK) != 0) {
+        LOG_ERROR(LOG_CORE, "Netplay port %d unavailable: %s\n", base_port + n->local, strerror(errno));
+        close(n->socket);
+        n->socket = -1;
+        return -1;
+    }
+    LOG_INFO(LOG_CORE, "Netplay: player %d on port %d, remote on %d, %d ms added latency\n",
+             n->local + 1, base_port + n->local, n->remote_port, n->latency_ms);
+    return 0;
+}
+
+static void send_packet(netplay *n, const Uint8 *data, int size) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(n->remote_port);
+    // Nobody listening yet is fine: the next packet carries the same inputs again
+    sendto(n->socket, data, size, 0, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+static void receive_packet(netplay *n, const Uint8 *data, int size) {
+    if (size < PACKET_HEADER || data[0] != 'R' || data[1] != 'B') return;
+    Uint32 ack = get_u32(data + 2);
+    Uint32 first = get_u32(data + 6);
+    int count = data[10];
+    if (size < PACKET_HEADER + count) return;
+
+    // Packets can arrive out of order; only ever move forward
+    if (ack > n->remote_ack && ack <= n->tick) n->remote_ack = ack;
+    for (int i = 0; i < count; i++) {
+        Uint32 t = first + i;
+        if (t < n->confirmed) continue;
+        if (t > n->confirmed) break; // A gap; the remote resends from our ack
+        Uint8 input = data[PACKET_HEADER + i];
+        Uint8 *slot = &n->remote_inputs[t % NETPLAY_HISTORY];
+        if (t < n->tick && *slot != input && (!n->rollback_pending || t < n->rollback_from)) {
+            n->rollback_from = t;
+            n->rollback_pending = 1;
+        }
+        *slot = input;
+        n->last_remote = input;
+        n->confirmed = t + 1;
+    }
+}
+
+void poll_netplay(netplay *n) {
+    Uint8 data[NETPLAY_PACKET_MAX];
+    for (;;) {
+        ssize_t size = recv(n->socket, data, sizeof(data), 0);
+        if (size < 0) break;
+        receive_packet(n, data, (int)size);
+    }
+
+    double now = clock_now();
+    while (n->delayed_count > 0 && n->delayed[n->delayed_first].due <= now) {
+        send_packet(n, n->delayed[n->delayed_first].data, n->delayed[n->delayed_first].size);
+        n->delayed_first = (n->delayed_first + 1) % NETPLAY_DELAY_SLOTS;
+        n->delayed_count--;
+    }
+}
+
+// The guess for a tick the remote hasn't sent yet is written into its slot, so a
+// rollback can tell whether the real input differs
+static Uint8 remote_input(netplay *n, Uint32 tick) {
+    Uint8 *slot = &n->remote_inputs[tick % NETPLAY_HISTORY];
+    if (tick >= n->confirmed) *slot = n->last_remote;
+    return *slot;
+}
+
+static void step(netplay *n, match *m, engine_clock *c, Uint32 tick) {
+    clock_seek(c, tick); // Simulation time is global, and a replay may have moved it
+    Uint8 inputs[2];
+    inputs[n->local] = n->local_inputs[tick % NETPLAY_HISTORY];
+    inputs[!n->local] = remote_input(n, tick);
+    step_match(m, inputs);
+}
+
+void rollback_netplay(netplay *n, match *m, engine_clock *c) {
+    n->frames++;
+    n->frame_depth = 0;
+    n->frame_resim_ms = 0;
+    if (!n->rollback_pending) return;
+
+    PROF_BEGIN(PROF_ROLLBACK);
+    double start = clock_now();
+    Uint32 from = n->rollback_from;
+    load_match(m, &n->snapshots[from % NETPLAY_WINDOW]);
+    for (Uint32 t = from; t < n->tick; t++) {
+        if (t != from) save_match(m, t, &n->snapshots[t % NETPLAY_WINDOW]);
+        step(n, m, c, t);
+    }
+    clock_seek(c, n->tick);
+    n->rollback_pending = 0;
+
+    double seconds = clock_now() - start;
+    n->frame_depth = (int)(n->tick - from);
+    n->frame_resim_ms = seconds * 1000.0;
+    n->rollbacks++;
+    n->resim_ticks += n->frame_depth;
+    n->resim_seconds += seconds;
+    if ((Uint32)n->frame_depth > n->max_depth) n->max_depth = n->frame_depth;
+    PROF_END(PROF_ROLLBACK);
+    LOG_DEBUG(LOG_CORE, "Netplay rollback: %d ticks from %u, %.3f ms\n", n->frame_depth, from, n->frame_resim_ms);
+}
+
+int advance_netplay(netplay *n, match *m, engine_clock *c, Uint8 input) {
+    // The oldest snapshot a late input could need, and the oldest input the remote could ask for
+    if (n->tick - n->confirmed >= NETPLAY_WINDOW - 1 || n->tick - n->remote_ack >= NETPLAY_HISTORY - 1) {
+        n->stalls++;
+        return 0;
+    }
+    save_match(m, n->tick, &n->snapshots[n->tick % NETPLAY_WINDOW]);
+    n->local_inputs[n->tick % NETPLAY_HISTORY] = input;
+    step(n, m, c, n->tick);
+    clock_step(c);
+    n->tick++;
+    return 1;
+}
+
+void send_netplay(netplay *n) {
+    Uint8 data[NETPLAY_PACKET_MAX];
+    Uint32 first = n->remote_ack;
+    int count = (int)(n->tick - first);
+    data[0] = 'R';
+    data[1] = 'B';
+    put_u32(data + 2, n->confirmed);
+    put_u32(data + 6, first);
+    data[10] = (Uint8)count;
+    for (int i = 0; i < count; i++) {
+        data[PACKET_HEADER + i] = n->local_inputs[(first + i) % NETPLAY_HISTORY];
+    }
+
+    int size = PACKET_HEADER + count;
+    if (n->latency_ms == 0 || n->delayed_count == NETPLAY_DELAY_SLOTS) {
+        send_packet(n, data, size);
+        return;
+    }
+    int slot = (n->delayed_first + n->delayed_count) % NETPLAY_DELAY_SLOTS;
+    n->delayed[slot].due = clock_now() + n->latency_ms / 1000.0;
+    n->delayed[slot].size = size;
+    memcpy(n->delayed[slot].data, data, size);
+    n->delayed_count++;
+}
+
+void log_netplay_stats(const netplay *n) {
+    LOG_INFO(LOG_CORE, "Netplay: %u ticks, %u of %u frames rolled back, depth avg %.1f max %u, re-sim %.3f ms avg, %u stalls\n",
+             n->tick, n->rollbacks, n->frames, n->rollbacks ? (double)n->resim_ticks / n->rollbacks : 0.0, n->max_depth,
+             n->rollbacks ? n->resim_seconds * 1000.0 / n->rollbacks : 0.0, n->stalls);
+}
+
+void free_netplay(netplay *n) {
+    if (n->socket >= 0) close(n->socket);
+    n->socket = -1;
+}
@@ -0,0 +1,59 @@
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include <SDL/SDL.h>
+#include "match.h"
+#include "timing.h"
+
+#define NETPLAY_PORT 7001      // Player 1 listens here, player 2 on the next port
+#define NETPLAY_WINDOW 32      // Snapshots kept, and how many ticks past the remote's last input a side may run
+#define NETPLAY_HISTORY 256    // Inputs kept per player, for resending and re-simulating
+#define NETPLAY_DELAY_SLOTS 128 // Packets held back for the artificial latency
+#define NETPLAY_PACKET_MAX (11 + NETPLAY_HISTORY)
+
+// Two processes on one machine, each running the whole match and sending only its own
+// player's inputs. The remote player's input is guessed until it arrives; a wrong guess
+// rolls back to that tick's snapshot and simulates up to the present again.
+typedef struct {
+    int socket;
+    int local; // Index of the player this process controls
+    Uint16 remote_port;
+    int latency_ms; // Added to every packet sent
+
+    Uint32 tick;          // Next tick to simulate
+    Uint32 confirmed;     // Remote inputs are known for every tick before this
+    Uint32 remote_ack;    // The remote has our inputs for every tick before this
+    Uint32 rollback_from; // Earliest tick simulated with a wrong guess
+    int rollback_pending;
+    Uint8 last_remote;    // The guess: the remote keeps doing what it last did
+    Uint8 local_inputs[NETPLAY_HISTORY];
+    Uint8 remote_inputs[NETPLAY_HISTORY]; // Received, or the guess simulated with
+    match_snapshot snapshots[NETPLAY_WINDOW]; // State at the start of each tick
+
+    struct {
+        double due;
+        int size;
+        Uint8 data[NETPLAY_PACKET_MAX];
+    } delayed[NETPLAY_DELAY_SLOTS];
+    int delayed_first;
+    int delayed_count;
+
+    int frame_depth;       // Ticks re-simulated this frame
+    double frame_resim_ms; // What they cost
+    Uint32 frames;
+    Uint32 rollbacks;      // Frames that re-simulated
+    Uint32 resim_ticks;
+    Uint32 max_depth;
+    double resim_seconds;
+    Uint32 stalls;         // Ticks held back waiting for the remote
+} netplay;
+
+int init_netplay(netplay* n, int player, int base_port, int latency_ms); // player is 1 or 2
+void poll_netplay(netplay* n); // Reads what arrived and sends what is due, once per frame
+void rollback_netplay(netplay* n, match* m, engine_clock* c); // Replays from a wrong guess, if any
+int advance_netplay(netplay* n, match* m, engine_clock* c, Uint8 input); // 0 when too far ahead
+void send_netplay(netplay* n); // Our inputs the remote hasn't acknowledged, after the frame's ticks
+void log_netplay_stats(const netplay* n);
+void free_netplay(netplay* n);
+
+#endif
@@ -0,0 +1,111 @@
+#include "pack.h"
+#include "log.h"
+#include <SDL/SDL.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static Uint8 *pack_data = NULL;
+static size_t pack_size = 0;
+static int pack_tried = 0;
+
+static int map_pack(void) {
+    if (pack_tried) return pack_data != NULL;
+    pack_tried = 1;
+
+    int fd = open(PACK_FILE, O_RDONLY);
+    if (fd < 0) {
+        LOG_INFO(LOG_CORE, "No %s, loading assets from their source files\n", PACK_FILE);
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(pack_header)) {
+        LOG_WARN(LOG_CORE, "Warning: %s is truncated, ignoring it\n", PACK_FILE);
+        close(fd);
+        return 0;
+    }
+    // Private and writable so a stray write to a surface copies the page instead of faulting
+    void *p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        LOG_WARN(LOG_CORE, "Warning: failed to map %s\n", PACK_FILE);
+        return 0;
+    }
+
+    const pack_header *h = p;
+    size_t size = st.st_size;
+    int valid = memcmp(h->magic, PACK_MAGIC, 8) == 0 && h->version == PACK_VERSION &&
+                sizeof(pack_header) + (size_t)h->entry_count * sizeof(pack_entry) <= size;
+    const pack_entry *e = (const pack_entry *)(h + 1);
+    for (Uint32 i = 0; valid && i < h->entry_count; i++) {
+        valid = e[i].offset <= size && e[i].size <= size - e[i].offset &&
+                (e[i].type != PACK_SHEET || (Uint64)e[i].pitch * e[i].h <= e[i].size);
+    }
+    if (!valid) {
+        LOG_WARN(LOG_CORE, "Warning: %s is not a version %d pack, ignoring it\n", PACK_FILE, PACK_VERSION);
+        munmap(p, size);
+        return 0;
+    }
+
+    pack_data = p;
+    pack_size = size;
+    LOG_INFO(LOG_CORE, "Asset pack mapped: %s (%u entries, %lu KB)\n", PACK_FILE, h->entry_count,
+             (unsigned long)(size / 1024));
+    return 1;
+}
+
+static const pack_entry *find_entry(const char *name, Uint32 type) {
+    if (!map_pack()) return NULL;
+
+    const pack_header *h = (const pack_header *)pack_data;
+    const pack_entry *e = (const pack_entry *)(h + 1);
+    for (Uint32 i = 0; i < h->entry_count; i++) {
+        if (e[i].type != type || strncmp(e[i].name, name, sizeof(e[i].name)) != 0) continue;
+
+        // A source edited since packing wins over the baked copy
+        struct stat st;
+        if (stat(name, &st) == 0 &&
+            ((Sint64)st.st_mtime != e[i].source_mtime || (Uint64)st.st_size != e[i].source_size)) {
+            LOG_WARN(LOG_CORE, "Warning: %s changed since %s was built, loading the source\n", name, PACK_FILE);
+            return NULL;
+        }
+        return &e[i];
+    }
+    return NULL;
+}
+
+SDL_Surface *pack_sheet(const char *name) {
+    const pack_entry *e = find_entry(name, PACK_SHEET);
+    if (!e) return NULL;
+
+    const pack_header *h = (const pack_header *)pack_data;
+    SDL_Surface *s = SDL_CreateRGBSurfaceFrom(pack_data + e->offset, e->w, e->h, 32, e->pitch,
+                                              h->Rmask, h->Gmask, h->Bmask, 0);
+    if (!s) {
+        LOG_ERROR(LOG_CORE, "Failed to wrap packed %s: %s\n", name, SDL_GetError());
+    }
+    return s;
+}
+
+FILE *pack_open(const char *name) {
+    const pack_entry *e = find_entry(name, PACK_RAW);
+    if (!e) return NULL;
+    return fmemopen(pack_data + e->offset, e->size, "r");
+}
+
+FILE *open_asset_file(const char *name) {
+    FILE *f = pack_open(name);
+    return f ? f : fopen(name, "r");
+}
+
+void close_pack(void) {
+    if (pack_data) {
+        munmap(pack_data, pack_size);
+    }
+    pack_data = NULL;
+    pack_size = 0;
+    pack_tried = 0;
+}
@@ -0,0 +1,40 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <SDL/SDL.h>
+#include <stdio.h>
+
+#define PACK_FILE "assets.pak"
+#define PACK_MAGIC "PTPPACK\n"
+#define PACK_VERSION 1
+#define PACK_ALIGN 64
+
+// pack_entry.type
+#define PACK_SHEET 1 // 32-bit pixels, rows pitch bytes apart
+#define PACK_RAW 2   // File copied as is
+
+typedef struct {
+    char magic[8];
+    Uint32 version;
+    Uint32 entry_count;
+    Uint32 Rmask, Gmask, Bmask; // Layout of every sheet's pixels
+    Uint32 reserved;
+} pack_header;
+
+typedef struct {
+    char name[64]; // Source file name
+    Uint32 type;
+    Uint32 w, h, pitch;
+    Uint64 offset; // From the start of the pack, PACK_ALIGN aligned
+    Uint64 size;
+    Sint64 source_mtime; // Source file when packed, to spot stale entries
+    Uint64 source_size;
+} pack_entry;
+
+// The pack is mapped on first use and these return NULL for anything missing or stale
+SDL_Surface* pack_sheet(const char* name); // Wraps the mapped pixels, no copy
+FILE* pack_open(const char* name);         // Read-only stream over a raw entry
+FILE* open_asset_file(const char* name);   // Packed copy if fresh, else the file itself
+void close_pack(void); // Every surface from pack_sheet must be freed first
+
+#endif
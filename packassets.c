@@ -0,0 +1,159 @@
+#include "pack.h"
+#include <SDL/SDL.h>
+#include <SDL/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define MAX_PACK_ENTRIES 64
+
+// Pixel layout the game's 32-bit display format uses on common desktops
+#define PACK_RMASK 0x00ff0000
+#define PACK_GMASK 0x0000ff00
+#define PACK_BMASK 0x000000ff
+
+static pack_entry entries[MAX_PACK_ENTRIES];
+static void *payloads[MAX_PACK_ENTRIES];
+static int entry_count = 0;
+
+static pack_entry *add_entry(const char *name, Uint32 type) {
+    for (int i = 0; i < entry_count; i++) {
+        if (strcmp(entries[i].name, name) == 0) return NULL; // Already packed
+    }
+    if (entry_count == MAX_PACK_ENTRIES || strlen(name) >= sizeof(entries[0].name)) {
+        printf("Cannot pack %s: too many entries or name too long\n", name);
+        exit(1);
+    }
+
+    struct stat st;
+    if (stat(name, &st) != 0) {
+        printf("Cannot pack %s: file not found\n", name);
+        exit(1);
+    }
+    pack_entry *e = &entries[entry_count];
+    memset(e, 0, sizeof(*e));
+    strcpy(e->name, name);
+    e->type = type;
+    e->source_mtime = (Sint64)st.st_mtime;
+    e->source_size = (Uint64)st.st_size;
+    return e;
+}
+
+static void add_raw(const char *name) {
+    pack_entry *e = add_entry(name, PACK_RAW);
+    if (!e) return;
+
+    FILE *f = fopen(name, "rb");
+    void *data = malloc(e->source_size + 1);
+    if (!f || !data || fread(data, 1, e->source_size, f) != e->source_size) {
+        printf("Cannot read %s\n", name);
+        exit(1);
+    }
+    fclose(f);
+    e->size = e->source_size;
+    payloads[entry_count++] = data;
+}
+
+// Converted the way SDL_DisplayFormat would, so the game can blit the mapped pixels directly
+static void add_sheet(const char *name) {
+    pack_entry *e = add_entry(name, PACK_SHEET);
+    if (!e) return;
+
+    SDL_Surface *png = IMG_Load(name);
+    if (!png) {
+        printf("Cannot decode %s: %s\n", name, IMG_GetError());
+        exit(1);
+    }
+    SDL_Surface *pixels = SDL_CreateRGBSurface(SDL_SWSURFACE, png->w, png->h, 32, PACK_RMASK, PACK_GMASK, PACK_BMASK, 0);
+    if (!pixels) {
+        printf("Cannot convert %s: %s\n", name, SDL_GetError());
+        exit(1);
+    }
+    SDL_SetAlpha(png, 0, 255);
+    SDL_SetColorKey(png, 0, 0);
+    SDL_BlitSurface(png, NULL, pixels, NULL);
+
+    e->w = pixels->w;
+    e->h = pixels->h;
+    e->pitch = pixels->w * 4;
+    e->size = (Uint64)e->pitch * e->h;
+    Uint8 *data = malloc(e->size);
+    if (!data) {
+        printf("Out of memory packing %s\n", name);
+        exit(1);
+    }
+    for (int y = 0; y < pixels->h; y++) {
+        memcpy(data + y * e->pitch, (Uint8 *)pixels->pixels + y * pixels->pitch, e->pitch);
+    }
+    payloads[entry_count++] = data;
+    SDL_FreeSurface(pixels);
+    SDL_FreeSurface(png);
+    printf("%-16s %4ux%-4u %6lu KB\n", name, e->w, e->h, (unsigned long)(e->size / 1024));
+}
+
+static Uint64 align(Uint64 offset) {
+    return (offset + PACK_ALIGN - 1) & ~(Uint64)(PACK_ALIGN - 1);
+}
+
+// Bakes the animation file and every sheet its clips use into one pack
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("Usage: %s <animation file> <pack>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *anims = fopen(argv[1], "r");
+    if (!anims) {
+        printf("Failed to open %s\n", argv[1]);
+        return 1;
+    }
+    add_raw(argv[1]);
+    char line[256];
+    while (fgets(line, sizeof(line), anims)) {
+        char name[16], sheet[64];
+        if (sscanf(line, "clip %15s %63s", name, sheet) == 2) {
+            add_sheet(sheet);
+        }
+    }
+    fclose(anims);
+
+    pack_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PACK_MAGIC, 8);
+    header.version = PACK_VERSION;
+    header.entry_count = entry_count;
+    header.Rmask = PACK_RMASK;
+    header.Gmask = PACK_GMASK;
+    header.Bmask = PACK_BMASK;
+    Uint64 offset = align(sizeof(header) + entry_count * sizeof(pack_entry));
+    for (int i = 0; i < entry_count; i++) {
+        entries[i].offset = offset;
+        offset = align(offset + entries[i].size);
+    }
+
+    // Written aside and renamed, so a running game never maps half a pack
+    char temp[256];
+    snprintf(temp, sizeof(temp), "%s.tmp", argv[2]);
+    FILE *out = fopen(temp, "wb");
+    if (!out) {
+        printf("Failed to create %s\n", temp);
+        return 1;
+    }
+    static const Uint8 zeros[PACK_ALIGN];
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(entries, sizeof(pack_entry), entry_count, out);
+    for (int i = 0; i < entry_count; i++) {
+        fwrite(zeros, 1, entries[i].offset - ftell(out), out);
+        fwrite(payloads[i], 1, entries[i].size, out);
+        free(payloads[i]);
+    }
+    fwrite(zeros, 1, offset - ftell(out), out);
+    if (fclose(out) != 0 || rename(temp, argv[2]) != 0) {
+        printf("Failed to write %s\n", argv[2]);
+        remove(temp);
+        return 1;
+    }
+    printf("Wrote %s: %d entries, %lu KB\n", argv[2], entry_count, (unsigned long)(offset / 1024));
+    return 0;
+}
@@ -1,459 +1,348 @@
 #include "perso.h"
+#include "log.h"
+#include "timing.h"
+#include "input.h"
+#include "assets.h"
+#include "blit.h"
 #include <SDL/SDL.h>
-#include <SDL/SDL_image.h>
-#include <SDL/SDL_ttf.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define SCREEN_WIDTH 1024
-#define ACCELERATION 0.1
-#define ACCEL_DELAY 500
+// The knight every character uses today; per-instance state lives in perso
+perso_archetype default_archetype = {"anims.txt"};
 
-void init_perso(perso *p) {
-    // Load each state's spritesheet
-    const char* filenames[6] = {
-        "Idle.png",   // IDLE
-        "Run.png",    // RUN
-        "Attack.png", // ATTACK
-        "Jump.png",   // JUMP
-        "Hurt.png",   // HURT
-        "Dead.png"    // DEAD
-    };
+int acquire_archetype(perso_archetype *a) {
+    static const char *state_clips[6] = {"idle", "run", "attack", "jump", "hurt", "dead"};
 
+    if (a->users++ > 0) return 0;
+    a->anims = load_anim_library(a->anim_file);
+    if (!a->anims) {
+        a->users = 0;
+        return -1;
+    }
     for (int i = 0; i < 6; i++) {
-        p->images[i] = IMG_Load(filenames[i]);
-        if (!p->images[i]) {
-            printf("Error loading %s: %s\n", filenames[i], IMG_GetError());
-            // Free any previously loaded surfaces before exiting
-            for (int j = 0; j < i; j++) {
-                SDL_FreeSurface(p->images[j]);
-            }
-            exit(1);
+        a->clips[i] = find_clip(a->anims, state_clips[i]);
+        if (a->clips[i] < 0) {
+            LOG_ERROR(LOG_ANIM, "%s: missing clip \"%s\"\n", a->anim_file, state_clips[i]);
+            free_anim_library(a->anims);
+            a->anims = NULL;
+            a->users = 0;
+            return -1;
         }
+    }
+    return 0;
+}
 
-        // Set transparency (white background: RGB 255,255,255)
-        Uint32 colorkey = SDL_MapRGB(p->images[i]->format, 255, 255, 255);
-        if (SDL_SetColorKey(p->images[i], SDL_SRCCOLORKEY, colorkey) != 0) {
-            printf("Error setting colorkey for %s: %s\n", filenames[i], SDL_GetError());
-        }
-        if (p->images[i]->format->Amask) {
-            SDL_SetAlpha(p->images[i], SDL_SRCALPHA, 255);
-        }
+void release_archetype(perso_archetype *a) {
+    if (a->users <= 0 || --a->users > 0) return;
+    free_anim_library(a->anims);
+    a->anims = NULL;
+}
+
+int archetype_ready(const perso_archetype *a) {
+    if (!a->anims) return 0;
+    for (int i = 0; i < a->anims->clip_count; i++) {
+        if (a->anims->clips[i].sheet->ready != 1) return 0;
+    }
+    return 1;
+}
+
+void init_perso(perso *p) {
+    p->archetype = &default_archetype;
+    if (acquire_archetype(p->archetype) != 0) {
+        exit(1);
     }
 
     p->pos.x = 50;
     p->pos.y = GROUND_LEVEL;
     p->pos.w = 128;
     p->pos.h = 128;
-
-    p->frameRect.x = 0;
-    p->frameRect.y = 0;
-    p->frameRect.w = 128;
-    p->frameRect.h = 128;
+    p->prev_pos = p->pos;
 
     p->state = IDLE;
     p->direction = 0;
-    p->currentFrame = 0;
-    p->frameCounts[IDLE] = 13;
-    p->frameCounts[RUN] = 10;
-    p->frameCounts[ATTACK] = 6;
-    p->frameCounts[JUMP] = 10;
-    p->frameCounts[HURT] = 3;
-    p->frameCounts[DEAD] = 5;
-
-    p->animSpeeds[IDLE] = 80;
-    p->animSpeeds[RUN] = 60;
-    p->animSpeeds[ATTACK] = 50;
-    p->animSpeeds[JUMP] = 70;
-    p->animSpeeds[HURT] = 100;
-    p->animSpeeds[DEAD] = 120;
-
-    p->lastUpdate = SDL_GetTicks();
+    p->input = 0;
+    play_clip(&p->anim, p->archetype->clips[IDLE]);
+    p->anim_events = 0;
 
     p->vie = 100;
     p->score = 0;
-    p->last_hit_time = 0;
+    p->last_hit_time = (Uint32)-HIT_COOLDOWN; // So the cooldown is already over when the match starts
     p->velocity_y = 0;
+    p->speed = 4.0;
+    p->frac_x = 0;
+    p->frac_y = 0;
+    p->move_start = 0;
+    p->moving = 0;
     p->is_jumping = 0;
     p->played_dead = 0;
     p->is_dead = 0;
-    printf("Perso init: x=%d, y=%d, state=%d\n", p->pos.x, p->pos.y, p->state);
+    p->events = 0;
+    LOG_INFO(LOG_CORE, "Perso init: x=%d, y=%d, state=%d\n", p->pos.x, p->pos.y, p->state);
+}
+
+void changer_etat_perso(perso *p, PersoState state) {
+    p->state = state;
+    play_clip(&p->anim, p->archetype->clips[state]);
 }
 
 void animer_perso(perso *p) {
+    p->anim_events = 0;
     if (p->is_dead && p->played_dead) return;
 
-    Uint32 currentTime = SDL_GetTicks();
-    if (currentTime - p->lastUpdate < p->animSpeeds[p->state]) return;
-
-    p->currentFrame = (p->currentFrame + 1) % p->frameCounts[p->state];
-    p->frameRect.x = p->currentFrame * 128;
-    p->frameRect.y = 0; // Each surface contains only one row
-
-    if (p->state == HURT && p->currentFrame == p->frameCounts[HURT] - 1) {
-        p->state = p->vie > 0 ? IDLE : DEAD;
-        p->currentFrame = 0;
+    const perso_archetype *a = p->archetype;
+    int clip = a->clips[p->state];
+    if (p->anim.clip != clip) {
+        // The state changed since the last tick
+        play_clip(&p->anim, clip);
     }
-    if (p->state == ATTACK && p->currentFrame == p->frameCounts[ATTACK] - 1) {
-        p->state = IDLE;
-        p->currentFrame = 0;
+
+    p->anim_events = advance_anim(a->anims, &p->anim, sim_dt() * 1000.0f);
+    if (p->anim.clip != clip) {
+        // A one-shot handed over to its next clip; follow it with the state
+        for (int i = 0; i < 6; i++) {
+            if (a->clips[i] == p->anim.clip) {
+                p->state = (PersoState)i;
+                break;
+            }
+        }
     }
-    if (p->state == DEAD && p->currentFrame == p->frameCounts[DEAD] - 1) {
+    if (p->state == DEAD && (p->anim_events & ANIM_EVENT_END)) {
         p->played_dead = 1;
         p->is_dead = 1;
+        p->events |= PERSO_EVENT_DIED;
     }
 
-    p->lastUpdate = currentTime;
-    printf("Perso anim: state=%d, frame=%d, x=%d, y=%d, direction=%d, played_dead=%d\n", 
-           p->state, p->currentFrame, p->frameRect.x, p->frameRect.y, p->direction, p->played_dead);
+    LOG_TRACE(LOG_ANIM, "Perso anim: state=%d, clip=%d, frame=%d, direction=%d, played_dead=%d\n",
+              p->state, p->anim.clip, p->anim.frame, p->direction, p->played_dead);
 }
 
-void deplacer_perso(perso *p, int screen_width) {
-    if (p->is_dead || p->state == DEAD || p->state == ATTACK || p->state == HURT) return;
+// Rounds down, so a fraction left behind is never negative; (int) alone rounds those up
+static int whole_pixels(float distance) {
+    int whole = (int)distance;
+    return whole > distance ? whole - 1 : whole;
+}
 
-    const Uint8 *keys = SDL_GetKeyState(NULL);
-    static Uint32 last_move_time = 0;
-    static int moving = 0;
-    static float speed = 4.0;
-    float dt = 16.0 / 1000.0;
+int deplacer_perso(perso *p, const collision_map *map) {
+    if (p->is_dead || p->state == DEAD || p->state == ATTACK || p->state == HURT) return 0;
+
+    float dt = sim_dt();
+    float step = dt * REFERENCE_TICK_RATE;
     int moved = 0;
 
-    if (keys[SDLK_LEFT]) {
-        if (!moving) {
-            last_move_time = SDL_GetTicks();
-            moving = 1;
-            speed = 4.0;
+    if (p->input & (INPUT_LEFT | INPUT_RIGHT)) {
+        if (!p->moving) {
+            p->move_start = sim_time_ms();
+            p->moving = 1;
+            p->speed = 4.0;
         }
-        Uint32 current_time = SDL_GetTicks();
-        if (current_time - last_move_time > ACCEL_DELAY) {
-            speed += ACCELERATION * (current_time - last_move_time - ACCEL_DELAY) * dt;
-            if (speed > 8.0) speed = 8.0;
+        Uint32 current_time = sim_time_ms();
+        if (current_time - p->move_start > ACCEL_DELAY) {
+            p->speed += ACCELERATION * (current_time - p->move_start - ACCEL_DELAY) * dt;
+            if (p->speed > 8.0) p->speed = 8.0;
         }
-        p->pos.x -= (int)speed;
-        p->direction = 1;
-        if (!p->is_jumping) p->state = RUN;
-        moved = 1;
-        printf("Perso moving left: x=%d, direction=%d, state=%d, speed=%f\n", p->pos.x, p->direction, p->state, speed);
-    }
-    else if (keys[SDLK_RIGHT]) {
-        if (!moving) {
-            last_move_time = SDL_GetTicks();
-            moving = 1;
-            speed = 4.0;
-        }
-        Uint32 current_time = SDL_GetTicks();
-        if (current_time - last_move_time > ACCEL_DELAY) {
-            speed += ACCELERATION * (current_time - last_move_time - ACCEL_DELAY) * dt;
-            if (speed > 8.0) speed = 8.0;
+        // Whole pixels move and collide; the rest carries over, so the speed holds at any tick rate
+        float target = p->frac_x + ((p->input & INPUT_LEFT) ? -p->speed : p->speed) * step;
+        int dx = whole_pixels(target);
+        int top = p->pos.y + BODY_Y;
+        int moved;
+        if (p->input & INPUT_LEFT) {
+            moved = -collide_left(map, top, top + BODY_H, p->pos.x + BODY_X, -dx);
+            p->direction = 1;
+        } else {
+            moved = collide_right(map, top, top + BODY_H, p->pos.x + BODY_X + BODY_W, dx);
+            p->direction = 0;
         }
-        p->pos.x += (int)speed;
-        p->direction = 0;
+        p->pos.x += moved;
+        p->frac_x = moved == dx ? target - dx : 0; // Against a wall, flush with it
         if (!p->is_jumping) p->state = RUN;
         moved = 1;
-        printf("Perso moving right: x=%d, direction=%d, state=%d, speed=%f\n", p->pos.x, p->direction, p->state, speed);
+        LOG_TRACE(LOG_PHYSICS, "Perso moving: x=%d, direction=%d, state=%d, speed=%f\n", p->pos.x, p->direction, p->state, p->speed);
     }
     else {
-        moving = 0;
-        speed = 4.0;
+        p->moving = 0;
+        p->speed = 4.0;
     }
 
-    if (p->pos.x < 0) p->pos.x = 0;
-    if (p->pos.x + p->pos.w > screen_width) p->pos.x = screen_width - p->pos.w;
-
     if (!moved && !p->is_jumping && p->state != ATTACK) {
         p->state = IDLE;
     }
 
-    printf("Perso move: x=%d, state=%d, direction=%d\n", p->pos.x, p->state, p->direction);
+    LOG_TRACE(LOG_PHYSICS, "Perso move: x=%d, state=%d, direction=%d\n", p->pos.x, p->state, p->direction);
+    return moved; // One query per step taken
 }
 
-void jump_perso(perso *p) {
-    if (p->is_dead || p->state == DEAD || p->state == ATTACK || p->state == HURT) return;
+int jump_perso(perso *p, const collision_map *map) {
+    if (p->is_dead || p->state == DEAD || p->state == ATTACK || p->state == HURT) return 0;
 
-    const Uint8 *keys = SDL_GetKeyState(NULL);
-    if (keys[SDLK_UP] && !p->is_jumping) {
+    int left = p->pos.x + BODY_X;
+    int feet = p->pos.y + BODY_Y + BODY_H;
+    int queries = 0;
+    if ((p->input & INPUT_JUMP) && !p->is_jumping) {
         p->velocity_y = -15;
         p->is_jumping = 1;
-        p->state = JUMP;
-        p->currentFrame = 0;
-        printf("Perso jump: y=%d, velocity_y=%f\n", p->pos.y, p->velocity_y);
-    }
-
-    if (p->is_jumping) {
-        p->pos.y += p->velocity_y;
-        p->velocity_y += 0.5;
-
-        if (p->pos.y >= GROUND_LEVEL) {
-            p->pos.y = GROUND_LEVEL;
+        changer_etat_perso(p, JUMP);
+        LOG_DEBUG(LOG_PHYSICS, "Perso jump: y=%d, velocity_y=%f\n", p->pos.y, p->velocity_y);
+    } else if (!p->is_jumping) {
+        queries++;
+        if (collide_down(map, left, left + BODY_W, feet, 1) > 0) {
+            // Nothing underfoot: walked off a ledge
             p->velocity_y = 0;
-            p->is_jumping = 0;
-            p->state = IDLE;
-            p->currentFrame = 0;
-            printf("Perso land: y=%d\n", p->pos.y);
+            p->is_jumping = 1;
+            changer_etat_perso(p, JUMP);
+            LOG_DEBUG(LOG_PHYSICS, "Perso fall: x=%d, y=%d\n", p->pos.x, p->pos.y);
         }
     }
-}
-
-void deplacer_perso1(perso *p, int screen_width) {
-    if (p->is_dead || p->state == DEAD || p->state == ATTACK || p->state == HURT) return;
-
-    const Uint8 *keys = SDL_GetKeyState(NULL);
-    static Uint32 last_move_time = 0;
-    static int moving = 0;
-    static float speed = 4.0;
-    float dt = 16.0 / 1000.0;
-    int moved = 0;
 
-    if (keys[SDLK_q]) {
-        if (!moving) {
-            last_move_time = SDL_GetTicks();
-            moving = 1;
-            speed = 4.0;
-        }
-        Uint32 current_time = SDL_GetTicks();
-        if (current_time - last_move_time > ACCEL_DELAY) {
-            speed += ACCELERATION * (current_time - last_move_time - ACCEL_DELAY) * dt;
-            if (speed > 8.0) speed = 8.0;
-        }
-        p->pos.x -= (int)speed;
-        p->direction = 1;
-        if (!p->is_jumping) p->state = RUN;
-        moved = 1;
-        printf("Perso1 moving left: x=%d, direction=%d, state=%d, speed=%f\n", p->pos.x, p->direction, p->state, speed);
-    }
-    else if (keys[SDLK_d]) {
-        if (!moving) {
-            last_move_time = SDL_GetTicks();
-            moving = 1;
-            speed = 4.0;
-        }
-        Uint32 current_time = SDL_GetTicks();
-        if (current_time - last_move_time > ACCEL_DELAY) {
-            speed += ACCELERATION * (current_time - last_move_time - ACCEL_DELAY) * dt;
-            if (speed > 8.0) speed = 8.0;
+    if (p->is_jumping) {
+        float step = sim_dt() * REFERENCE_TICK_RATE;
+        // The tick's exact distance under constant gravity, so the arc is the same at any tick rate
+        float target = p->frac_y + (p->velocity_y + 0.25f * step) * step;
+        int dy = whole_pixels(target);
+        p->velocity_y += 0.5 * step;
+        p->frac_y = target - dy;
+        queries++;
+        if (dy >= 0) {
+            // A tick too slow to move still feels a pixel down, so it can land
+            int reach = dy > 0 ? dy : 1;
+            int fall = collide_down(map, left, left + BODY_W, feet, reach);
+            if (dy > 0) p->pos.y += fall;
+            if (fall < reach) {
+                p->velocity_y = 0;
+                p->frac_y = 0;
+                p->is_jumping = 0;
+                p->events |= PERSO_EVENT_LANDED;
+                changer_etat_perso(p, IDLE);
+                LOG_DEBUG(LOG_PHYSICS, "Perso land: y=%d\n", p->pos.y);
+            }
+        } else {
+            int rise = collide_up(map, left, left + BODY_W, feet - BODY_H, -dy);
+            p->pos.y -= rise;
+            if (rise < -dy) {
+                // Head against a ceiling
+                p->velocity_y = 0;
+                p->frac_y = 0;
+            }
         }
-        p->pos.x += (int)speed;
-        p->direction = 0;
-        if (!p->is_jumping) p->state = RUN;
-        moved = 1;
-        printf("Perso1 moving right: x=%d, direction=%d, state=%d, speed=%f\n", p->pos.x, p->direction, p->state, speed);
     }
-    else {
-        moving = 0;
-        speed = 4.0;
-    }
-
-    if (p->pos.x < 0) p->pos.x = 0;
-    if (p->pos.x + p->pos.w > screen_width) p->pos.x = screen_width - p->pos.w;
-
-    if (!moved && !p->is_jumping && p->state != ATTACK) {
-        p->state = IDLE;
-    }
-
-    printf("Perso1 move: x=%d, state=%d, direction=%d\n", p->pos.x, p->state, p->direction);
+    return queries;
 }
 
-void jump_perso1(perso *p) {
-    if (p->is_dead || p->state == DEAD || p->state == ATTACK || p->state == HURT) return;
-
-    const Uint8 *keys = SDL_GetKeyState(NULL);
-    if (keys[SDLK_z] && !p->is_jumping) {
-        p->velocity_y = -15;
-        p->is_jumping = 1;
-        p->state = JUMP;
-        p->currentFrame = 0;
-        printf("Perso1 jump: y=%d, velocity_y=%f\n", p->pos.y, p->velocity_y);
-    }
-
-    if (p->is_jumping) {
-        p->pos.y += p->velocity_y;
-        p->velocity_y += 0.5;
-
-        if (p->pos.y >= GROUND_LEVEL) {
-            p->pos.y = GROUND_LEVEL;
-            p->velocity_y = 0;
-            p->is_jumping = 0;
-            p->state = IDLE;
-            p->currentFrame = 0;
-            printf("Perso1 land: y=%d\n", p->pos.y);
-        }
-    }
+int update_perso(perso *p, const collision_map *map) {
+    int queries = deplacer_perso(p, map);
+    queries += jump_perso(p, map);
+    animer_perso(p);
+    return queries;
 }
 
-void trigger_hit(perso *p) {
-    if (p->is_dead || p->state == DEAD || p->state == HURT) return;
-    Uint32 current_time = SDL_GetTicks();
-    if (current_time - p->last_hit_time < HIT_COOLDOWN) return;
+int trigger_hit(perso *p) {
+    if (p->is_dead || p->state == DEAD || p->state == HURT) return 0;
+    Uint32 current_time = sim_time_ms();
+    if (current_time - p->last_hit_time < HIT_COOLDOWN) return 0;
 
-    p->state = HURT;
-    p->currentFrame = 0;
-    p->lastUpdate = current_time;
-    p->vie -= 20;
+    changer_etat_perso(p, HURT);
+    p->vie -= HIT_DAMAGE;
     p->last_hit_time = current_time;
-    printf("Perso hit: vie=%d\n", p->vie);
+    p->events |= PERSO_EVENT_HIT;
+    LOG_DEBUG(LOG_PHYSICS, "Perso hit: vie=%d\n", p->vie);
     if (p->vie <= 0) {
         p->vie = 0;
-        p->state = DEAD;
-        p->currentFrame = 0;
+        changer_etat_perso(p, DEAD);
         p->is_dead = 1;
-        printf("Perso died\n");
+        LOG_DEBUG(LOG_PHYSICS, "Perso died\n");
     }
+    return 1;
 }
 
 void attack_perso(perso *p) {
     if (p->is_dead || p->state == DEAD || p->state == ATTACK || p->state == HURT) return;
 
-    p->state = ATTACK;
-    p->currentFrame = 0;
-    p->lastUpdate = SDL_GetTicks();
-    printf("Perso attack: state=%d\n", p->state);
+    changer_etat_perso(p, ATTACK);
+    p->anim_events = 0;
+    LOG_DEBUG(LOG_ANIM, "Perso attack: state=%d\n", p->state);
 }
 
-void afficher_perso(perso *p, SDL_Surface *screen, SDL_Rect *render_pos) {
-    SDL_Surface *current_image = p->images[p->state];
-    if (!current_image || !screen) {
-        printf("Perso render error: invalid surface (image=%p, screen=%p)\n", current_image, screen);
-        return;
-    }
-
-    SDL_Rect src_rect = p->frameRect;
-    if (p->direction == 1) {
-        SDL_Surface *flipped = SDL_CreateRGBSurface(current_image->flags, src_rect.w, src_rect.h, 
-                                                   current_image->format->BitsPerPixel, 
-                                                   current_image->format->Rmask, current_image->format->Gmask, 
-                                                   current_image->format->Bmask, current_image->format->Amask);
-        if (!flipped) {
-            printf("Perso render error: failed to create flipped surface\n");
-            return;
-        }
-
-        Uint32 colorkey = SDL_MapRGB(flipped->format, 255, 255, 255);
-        SDL_SetColorKey(flipped, SDL_SRCCOLORKEY, colorkey);
-        if (current_image->format->Amask) {
-            SDL_SetAlpha(flipped, SDL_SRCALPHA, 255);
-        }
-
-        SDL_LockSurface(current_image);
-        SDL_LockSurface(flipped);
-        for (int x = 0; x < src_rect.w; x++) {
-            for (int y = 0; y < src_rect.h; y++) {
-                Uint32 pixel = get_pixel(current_image, src_rect.x + x, src_rect.y + y);
-                put_pixel(flipped, src_rect.w - 1 - x, y, pixel);
-            }
-        }
-        SDL_UnlockSurface(current_image);
-        SDL_UnlockSurface(flipped);
+void perso_combat_body(const perso *p, combat_body *out) {
+    anim_combat_body(p->archetype->anims, &p->anim, p->pos.x, p->pos.y, p->direction == 1, out);
+}
 
-        int result = SDL_BlitSurface(flipped, NULL, screen, render_pos);
-        SDL_FreeSurface(flipped);
-        if (result != 0) {
-            printf("Perso render error: SDL_BlitSurface failed for flipped: %s\n", SDL_GetError());
-        } else {
-            printf("Perso render (flipped): x=%d, y=%d, state=%d, frame_x=%d, frame_y=%d\n", 
-                   render_pos->x, render_pos->y, p->state, src_rect.x, src_rect.y);
-        }
-    } else {
-        int result = SDL_BlitSurface(current_image, &src_rect, screen, render_pos);
-        if (result != 0) {
-            printf("Perso render error: SDL_BlitSurface failed: %s\n", SDL_GetError());
-        } else {
-            printf("Perso render: x=%d, y=%d, state=%d, frame_x=%d, frame_y=%d\n", 
-                   render_pos->x, render_pos->y, p->state, src_rect.x, src_rect.y);
-        }
-    }
+void save_perso(const perso *p, perso_snapshot *out) {
+    memset(out, 0, sizeof(*out)); // Padding too, so snapshots compare with memcmp
+    out->x = p->pos.x;
+    out->y = p->pos.y;
+    out->prev_x = p->prev_pos.x;
+    out->prev_y = p->prev_pos.y;
+    out->anim = p->anim;
+    out->velocity_y = p->velocity_y;
+    out->speed = p->speed;
+    out->frac_x = p->frac_x;
+    out->frac_y = p->frac_y;
+    out->move_start = p->move_start;
+    out->last_hit_time = p->last_hit_time;
+    out->score = p->score;
+    out->vie = (Sint16)p->vie;
+    out->state = (Uint8)p->state;
+    out->direction = (Uint8)p->direction;
+    out->input = p->input;
+    out->anim_events = p->anim_events;
+    out->flags = (p->moving ? PERSO_MOVING : 0) | (p->is_jumping ? PERSO_JUMPING : 0) |
+                 (p->played_dead ? PERSO_PLAYED_DEAD : 0) | (p->is_dead ? PERSO_DEAD : 0);
 }
 
-void afficher_score_vie(perso *p, SDL_Surface *screen, int player_num, TTF_Font *font) {
-    if (p->is_dead && p->played_dead) return;
+void load_perso(perso *p, const perso_snapshot *s) {
+    p->pos.x = s->x;
+    p->pos.y = s->y;
+    p->prev_pos.x = s->prev_x;
+    p->prev_pos.y = s->prev_y;
+    p->anim = s->anim;
+    p->velocity_y = s->velocity_y;
+    p->speed = s->speed;
+    p->frac_x = s->frac_x;
+    p->frac_y = s->frac_y;
+    p->move_start = s->move_start;
+    p->last_hit_time = s->last_hit_time;
+    p->score = s->score;
+    p->vie = s->vie;
+    p->state = (PersoState)s->state;
+    p->direction = s->direction;
+    p->input = s->input;
+    p->anim_events = s->anim_events;
+    p->moving = (s->flags & PERSO_MOVING) != 0;
+    p->is_jumping = (s->flags & PERSO_JUMPING) != 0;
+    p->played_dead = (s->flags & PERSO_PLAYED_DEAD) != 0;
+    p->is_dead = (s->flags & PERSO_DEAD) != 0;
+}
 
-    SDL_Color text_color = {255, 255, 255};
-    char player_label[10];
-    sprintf(player_label, "Player %d", player_num);
-    SDL_Surface *player_text = TTF_RenderText_Solid(font, player_label, text_color);
-    if (player_text == NULL) {
-        printf("Failed to render player label: %s\n", TTF_GetError());
-        return;
-    }
+void interpoler_perso(perso *p, float alpha, SDL_Rect *render_pos) {
+    render_pos->x = (Sint16)(p->prev_pos.x + (p->pos.x - p->prev_pos.x) * alpha + 0.5f);
+    render_pos->y = (Sint16)(p->prev_pos.y + (p->pos.y - p->prev_pos.y) * alpha + 0.5f);
+    render_pos->w = 0;
+    render_pos->h = 0;
+}
 
-    char score_label[20];
-    sprintf(score_label, "Score: %d", p->score);
-    SDL_Surface *score_text = TTF_RenderText_Solid(font, score_label, text_color);
-    if (score_text == NULL) {
-        printf("Failed to render score label: %s\n", TTF_GetError());
-        SDL_FreeSurface(player_text);
+void afficher_perso(perso *p, compositor *c, SDL_Rect *render_pos) {
+    const anim_library *lib = p->archetype->anims;
+    sprite_asset *sheet = lib->clips[p->anim.clip].sheet;
+    // A sheet still streaming in is drawn as a placeholder by draw_sprite
+    if (!c->target) {
+        LOG_ERROR(LOG_RENDER, "Perso render error: no screen surface\n");
         return;
     }
 
-    int health_bar_width = 100;
-    SDL_Rect health_pos;
-    SDL_Rect text_pos;
-    SDL_Rect score_pos;
-    if (player_num == 1) {
-        health_pos.x = 10;
-        text_pos.x = 10;
-        score_pos.x = 10;
+    int result = compose_sprite(c, sheet, anim_sheet_frame(lib, &p->anim), p->direction == 1, render_pos);
+    if (result != 0) {
+        LOG_ERROR(LOG_RENDER, "Perso render error: draw_sprite failed: %s\n", SDL_GetError());
     } else {
-        health_pos.x = screen->w - health_bar_width - 10;
-        text_pos.x = screen->w - health_bar_width - 10;
-        score_pos.x = screen->w - health_bar_width - 10;
-    }
-    health_pos.y = 30;
-    health_pos.w = health_bar_width;
-    health_pos.h = 10;
-    text_pos.y = 5;
-    score_pos.y = 45;
-
-    SDL_Surface *health_bar_bg = SDL_CreateRGBSurface(0, health_bar_width, 10, 32, 0, 0, 0, 0);
-    if (health_bar_bg == NULL) {
-        printf("Failed to create health bar background surface: %s\n", SDL_GetError());
-        SDL_FreeSurface(player_text);
-        SDL_FreeSurface(score_text);
-        return;
-    }
-    SDL_FillRect(health_bar_bg, NULL, SDL_MapRGB(health_bar_bg->format, 255, 0, 0));
-
-    int health_width = p->vie > 0 ? p->vie : 0;
-    SDL_Surface *health_bar = SDL_CreateRGBSurface(0, health_width, 10, 32, 0, 0, 0, 0);
-    if (health_bar == NULL) {
-        printf("Failed to create health bar surface: %s\n", SDL_GetError());
-        SDL_FreeSurface(health_bar_bg);
-        SDL_FreeSurface(player_text);
-        SDL_FreeSurface(score_text);
-        return;
-    }
-    SDL_FillRect(health_bar, NULL, SDL_MapRGB(health_bar->format, 0, 255, 0));
-
-    SDL_Surface *border = SDL_CreateRGBSurface(0, health_bar_width + 2, 12, 32, 0, 0, 0, 0);
-    if (border == NULL) {
-        printf("Failed to create border surface: %s\n", SDL_GetError());
-        SDL_FreeSurface(health_bar);
-        SDL_FreeSurface(health_bar_bg);
-        SDL_FreeSurface(player_text);
-        SDL_FreeSurface(score_text);
-        return;
+        LOG_TRACE(LOG_RENDER, "Perso render: x=%d, y=%d, state=%d, direction=%d, frame_x=%d, frame_y=%d\n",
+                  render_pos->x, render_pos->y, p->state, p->direction, anim_rect(lib, &p->anim)->x,
+                  anim_rect(lib, &p->anim)->y);
     }
-    SDL_FillRect(border, NULL, SDL_MapRGB(border->format, 255, 255, 255));
-
-    SDL_Rect inner = {1, 1, health_bar_width, 10};
-    SDL_BlitSurface(health_bar_bg, NULL, border, &inner);
-
-    inner.w = health_width;
-    SDL_BlitSurface(health_bar, NULL, border, &inner);
-
-    SDL_BlitSurface(player_text, NULL, screen, &text_pos);
-    SDL_BlitSurface(border, NULL, screen, &health_pos);
-    SDL_BlitSurface(score_text, NULL, screen, &score_pos);
-
-    SDL_FreeSurface(health_bar);
-    SDL_FreeSurface(health_bar_bg);
-    SDL_FreeSurface(border);
-    SDL_FreeSurface(player_text);
-    SDL_FreeSurface(score_text);
 }
 
 Uint32 get_pixel(SDL_Surface *surface, int x, int y) {
     if (x < 0 || x >= surface->w || y < 0 || y >= surface->h) {
-        printf("get_pixel: out of bounds x=%d, y=%d\n", x, y);
+        LOG_WARN(LOG_RENDER, "get_pixel: out of bounds x=%d, y=%d\n", x, y);
         return 0;
     }
 
@@ -469,7 +358,7 @@ Uint32 get_pixel(SDL_Surface *surface, int x, int y) {
 
 void put_pixel(SDL_Surface *surface, int x, int y, Uint32 pixel) {
     if (x < 0 || x >= surface->w || y < 0 || y >= surface->h) {
-        printf("put_pixel: out of bounds x=%d, y=%d\n", x, y);
+        LOG_WARN(LOG_RENDER, "put_pixel: out of bounds x=%d, y=%d\n", x, y);
         return;
     }
 
@@ -483,10 +372,8 @@ void put_pixel(SDL_Surface *surface, int x, int y, Uint32 pixel) {
 }
 
 void free_perso(perso *p) {
-    for (int i = 0; i < 6; i++) {
-        if (p->images[i]) {
-            SDL_FreeSurface(p->images[i]);
-            p->images[i] = NULL;
-        }
+    if (p->archetype) {
+        release_archetype(p->archetype);
+        p->archetype = NULL;
     }
 }
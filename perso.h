@@ -2,10 +2,26 @@
 #define PERSO_H
 
 #include <SDL/SDL.h>
-#include <SDL/SDL_ttf.h>
+#include "assets.h"
+#include "anim.h"
+#include "combat.h"
+#include "compose.h"
+#include "collide.h"
 
-#define GROUND_LEVEL 900 // Fits within 767-pixel world
+#define GROUND_LEVEL 400 // Feet at the bottom of the logical screen, less a small margin
 #define HIT_COOLDOWN 1000
+#define HIT_SCORE 10 // Awarded to the attacker for each hit that lands
+#define HIT_DAMAGE 20
+#define ACCELERATION 0.1
+#define ACCEL_DELAY 500
+#define REFERENCE_TICK_RATE 60.0f // Speeds and gravity are tuned per 60 Hz tick
+
+// What stops against level tiles, sprite-relative: the hurtboxes' extent, centred so it is
+// the same box whichever way the character faces
+#define BODY_X 44
+#define BODY_Y 58
+#define BODY_W 40
+#define BODY_H 70
 
 typedef enum {
     IDLE,
@@ -16,37 +32,86 @@ typedef enum {
     DEAD
 } PersoState;
 
+// Data shared by every character of one kind
 typedef struct {
-    SDL_Surface* images[6]; // One surface per state
+    const char* anim_file;
+    anim_library* anims; // Loaded by the first user, freed by the last
+    int clips[6];        // Clip played in each PersoState
+    int users;
+} perso_archetype;
+
+extern perso_archetype default_archetype;
+
+typedef struct {
+    perso_archetype* archetype;
     SDL_Rect pos;
-    SDL_Rect frameRect;
+    SDL_Rect prev_pos; // Position at the start of the current tick
     PersoState state;
     int direction; // 0: right, 1: left
-    int currentFrame;
-    int frameCounts[6];
-    int animSpeeds[6];
-    Uint32 lastUpdate;
+    Uint8 input; // INPUT_* bits for the current tick
+    anim_state anim;
+    Uint8 anim_events; // ANIM_EVENT_* raised during the last animer_perso
     int vie;
     int score;
     Uint32 last_hit_time;
     float velocity_y;
+    float speed;       // Run speed, accelerates while a direction is held
+    float frac_x, frac_y; // Sub-pixel part of the position, 0 to 1 past pos; only whole pixels collide
+    Uint32 move_start; // When the current run started
+    int moving;
     int is_jumping;
     int played_dead;
     int is_dead;
+    Uint8 events; // PERSO_EVENT_* since whoever shows them last cleared them; not simulation state
 } perso;
 
+// Everything a tick reads or writes, packed and pointer-free so rollback can copy it
+typedef struct {
+    Sint16 x, y;
+    Sint16 prev_x, prev_y;
+    anim_state anim;
+    float velocity_y;
+    float speed;
+    float frac_x, frac_y;
+    Uint32 move_start;
+    Uint32 last_hit_time;
+    Sint32 score;
+    Sint16 vie;
+    Uint8 state;
+    Uint8 direction;
+    Uint8 input;
+    Uint8 anim_events;
+    Uint8 flags; // PERSO_* below
+} perso_snapshot;
+
+#define PERSO_MOVING 0x01
+#define PERSO_JUMPING 0x02
+#define PERSO_PLAYED_DEAD 0x04
+#define PERSO_DEAD 0x08
+
+#define PERSO_EVENT_HIT 0x01    // trigger_hit landed
+#define PERSO_EVENT_DIED 0x02   // The death animation finished
+#define PERSO_EVENT_LANDED 0x04 // jump_perso touched down
+
+int acquire_archetype(perso_archetype* a); // Loads the clips on first use
+void release_archetype(perso_archetype* a);
+int archetype_ready(const perso_archetype* a); // Every sheet loaded
 void init_perso(perso* p);
+void changer_etat_perso(perso* p, PersoState state); // Restarts the state's clip
 void animer_perso(perso* p);
-void deplacer_perso(perso* p, int screen_width);
-void jump_perso(perso* p);
-void deplacer_perso1(perso* p, int screen_width);
-void jump_perso1(perso* p);
-void trigger_hit(perso* p);
+// These return the collision queries they made, for the profiler
+int deplacer_perso(perso* p, const collision_map* map);
+int jump_perso(perso* p, const collision_map* map); // Also starts the fall off a ledge
+int update_perso(perso* p, const collision_map* map); // One tick of the above; touches only p
+int trigger_hit(perso* p); // 1 if the hit landed, 0 if cooldown or state ignored it
 void attack_perso(perso* p);
-void afficher_perso(perso* p, SDL_Surface* screen, SDL_Rect* render_pos);
-void afficher_score_vie(perso* p, SDL_Surface* screen, int player_num, TTF_Font* font);
+void perso_combat_body(const perso* p, combat_body* out);
+void save_perso(const perso* p, perso_snapshot* out);
+void load_perso(perso* p, const perso_snapshot* s); // Keeps p's archetype and size
+void interpoler_perso(perso* p, float alpha, SDL_Rect* render_pos);
+void afficher_perso(perso* p, compositor* c, SDL_Rect* render_pos); // render_pos gets the drawn size
 Uint32 get_pixel(SDL_Surface *surface, int x, int y);
 void put_pixel(SDL_Surface *surface, int x, int y, Uint32 pixel);
-void free_perso(perso* p); // Add function to free surfaces
+void free_perso(perso* p); // Releases the shared archetype
 
 #endif
@@ -0,0 +1,173 @@
+#include "profile.h"
+#include "log.h"
+#include "timing.h"
+#if PROFILE
+#include "alloc_count.h"
+#else
+#define alloc_count() 0UL // The game links the counting malloc only with PROFILE=1
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+Uint32 prof_counters[PROF_COUNTER_COUNT];
+
+static const char *stage_names[PROF_STAGE_COUNT] = {
+    "frame", "events", "loader", "sim", "move", "anim", "combat", "rollback", "world", "clear", "draw", "effects", "hud", "text", "compose", "present", "wait"
+};
+
+static const char *counter_names[PROF_COUNTER_COUNT] = {"blits", "glyphs", "pairs", "chunks", "collide", "ticks", "particles"};
+
+static double stage_time[PROF_STAGE_COUNT]; // Seconds spent this frame, nested stages included
+static int stage_depth[PROF_STAGE_COUNT];
+
+static struct {
+    prof_stage stage;
+    double start;
+} stack[PROF_MAX_DEPTH];
+static int stack_depth = 0;
+static int unbalanced = 0;
+
+static float history[PROF_STAGE_COUNT][PROF_HISTORY]; // Milliseconds, one ring per stage
+static int history_count = 0;
+static int history_next = 0;
+
+static Uint32 window_counts[PROF_COUNTER_COUNT]; // Since the overlay last refreshed
+
+static FILE *csv = NULL;
+static Uint32 frame_index = 0;
+static unsigned long last_allocs = 0;
+
+void prof_begin(prof_stage stage) {
+    if (stack_depth == PROF_MAX_DEPTH) {
+        unbalanced = 1;
+        return;
+    }
+    stage_depth[stage] = stack_depth;
+    stack[stack_depth].stage = stage;
+    stack[stack_depth].start = clock_now();
+    stack_depth++;
+}
+
+void prof_end(prof_stage stage) {
+    if (stack_depth == 0 || stack[stack_depth - 1].stage != stage) {
+        unbalanced = 1;
+        return;
+    }
+    stack_depth--;
+    stage_time[stage] += clock_now() - stack[stack_depth].start;
+}
+
+void prof_begin_frame(void) {
+    memset(stage_time, 0, sizeof(stage_time));
+    memset(prof_counters, 0, sizeof(prof_counters));
+    stack_depth = 0;
+    prof_begin(PROF_FRAME);
+}
+
+void prof_end_frame(void) {
+    prof_end(PROF_FRAME);
+    if (unbalanced) {
+        LOG_WARN(LOG_CORE, "Warning: profiler scopes do not nest, check PROF_BEGIN/PROF_END pairs\n");
+        unbalanced = 0;
+    }
+
+    for (int s = 0; s < PROF_STAGE_COUNT; s++) {
+        history[s][history_next] = (float)(stage_time[s] * 1000.0);
+    }
+    history_next = (history_next + 1) % PROF_HISTORY;
+    if (history_count < PROF_HISTORY) history_count++;
+
+    for (int c = 0; c < PROF_COUNTER_COUNT; c++) {
+        window_counts[c] += prof_counters[c];
+    }
+
+    unsigned long allocs = alloc_count();
+    if (csv) {
+        fprintf(csv, "%u", frame_index);
+        for (int s = 0; s < PROF_STAGE_COUNT; s++) {
+            fprintf(csv, ",%.3f", stage_time[s] * 1000.0);
+        }
+        fprintf(csv, ",%lu", allocs - last_allocs);
+        for (int c = 0; c < PROF_COUNTER_COUNT; c++) {
+            fprintf(csv, ",%u", prof_counters[c]);
+        }
+        fprintf(csv, "\n");
+    }
+    last_allocs = allocs;
+    frame_index++;
+}
+
+int prof_open_csv(const char *filename) {
+    if (!PROFILE) {
+        LOG_WARN(LOG_CORE, "Warning: profiler compiled out, rebuild with make PROFILE=1 for %s\n", filename);
+        return -1;
+    }
+    csv = fopen(filename, "w");
+    if (!csv) {
+        LOG_ERROR(LOG_CORE, "Failed to create %s\n", filename);
+        return -1;
+    }
+    fprintf(csv, "frame");
+    for (int s = 0; s < PROF_STAGE_COUNT; s++) {
+        fprintf(csv, ",%s_ms", stage_names[s]);
+    }
+    fprintf(csv, ",allocs");
+    for (int c = 0; c < PROF_COUNTER_COUNT; c++) {
+        fprintf(csv, ",%s", counter_names[c]);
+    }
+    fprintf(csv, "\n");
+    LOG_INFO(LOG_CORE, "Profiling frames to %s\n", filename);
+    return 0;
+}
+
+void prof_close_csv(void) {
+    if (csv) fclose(csv);
+    csv = NULL;
+}
+
+static int compare_float(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+void prof_stage_stats(prof_stage stage, prof_stats *out) {
+    memset(out, 0, sizeof(*out));
+    out->depth = stage_depth[stage];
+    if (history_count == 0) return;
+
+    float sorted[PROF_HISTORY];
+    memcpy(sorted, history[stage], history_count * sizeof(float));
+    qsort(sorted, history_count, sizeof(float), compare_float);
+    out->p50 = sorted[(history_count - 1) * 50 / 100];
+    out->p95 = sorted[(history_count - 1) * 95 / 100];
+    out->p99 = sorted[(history_count - 1) * 99 / 100];
+    out->max = sorted[history_count - 1];
+}
+
+const char *prof_stage_name(prof_stage stage) {
+    return stage_names[stage];
+}
+
+void prof_overlay(text_font *f, int x, int y) {
+    static prof_stats shown[PROF_STAGE_COUNT];
+    static Uint32 shown_frame = 0;
+    static double shown_collide = 0; // Queries per tick
+    if (shown_frame == 0 || frame_index - shown_frame >= PROF_OVERLAY_REFRESH) {
+        for (int s = 0; s < PROF_STAGE_COUNT; s++) {
+            prof_stage_stats(s, &shown[s]);
+        }
+        if (window_counts[PROF_TICKS]) shown_collide = (double)window_counts[PROF_COLLIDE] / window_counts[PROF_TICKS];
+        memset(window_counts, 0, sizeof(window_counts));
+        shown_frame = frame_index ? frame_index : 1;
+    }
+
+    int line = f->height;
+    queue_text(f, x + 110, y, "p50     p95     p99     max (ms)");
+    for (int s = 0; s < PROF_STAGE_COUNT; s++) {
+        const prof_stats *st = &shown[s];
+        y += line;
+        queue_text(f, x + st->depth * 10, y, "%s", stage_names[s]);
+        queue_text(f, x + 110, y, "%.2f   %.2f   %.2f   %.2f", st->p50, st->p95, st->p99, st->max);
+    }
+    queue_text(f, x, y + line, "collide %.1f per tick", shown_collide);
+}
@@ -0,0 +1,80 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include "text.h"
+
+// Probes are compiled out unless built with make PROFILE=1
+#ifndef PROFILE
+#define PROFILE 0
+#endif
+
+#define PROF_HISTORY 256 // Frames kept per stage for the percentiles
+#define PROF_MAX_DEPTH 8
+#define PROF_OVERLAY_REFRESH 30 // Frames between overlay updates, so the numbers stay readable
+
+typedef enum {
+    PROF_FRAME,    // Whole frame, pacing included
+    PROF_EVENTS,   // SDL_PollEvent loop
+    PROF_LOADER,   // Finishing streamed assets
+    PROF_SIM,      // Every tick this frame
+    PROF_MOVE,     // deplacer_perso and jump_perso, against the level's tiles
+    PROF_ANIM,     // animer_perso
+    PROF_COMBAT,   // Hitboxes against hurtboxes
+    PROF_ROLLBACK, // Netplay: simulating again from a wrong guess of the remote's input
+    PROF_WORLD,    // Streaming level chunks in and painting the background after a scroll
+    PROF_CLEAR,    // Full-screen fill or background restore
+    PROF_DRAW,     // afficher_perso, recording only when the compositor is banded
+    PROF_EFFECTS,  // Emitting, moving and recording the particles
+    PROF_HUD,      // afficher_hud
+    PROF_TEXT,     // Glyph batch
+    PROF_COMPOSE,  // Running the recorded draws, band by band
+    PROF_PRESENT,  // Scaling to the screen and updating it
+    PROF_WAIT,     // Sleeping until the next frame
+    PROF_STAGE_COUNT
+} prof_stage;
+
+typedef enum {
+    PROF_BLITS,   // Sprite, HUD and background copies to the screen
+    PROF_GLYPHS,  // Counted apart from the blits
+    PROF_PAIRS,   // Combat candidate pairs from the broad phase
+    PROF_CHUNKS,  // Level chunks read, decoded and drawn
+    PROF_COLLIDE, // Swept moves checked against the level's tiles
+    PROF_TICKS,   // Simulation ticks, resimulated ones included
+    PROF_PARTICLES, // Effect squares drawn
+    PROF_COUNTER_COUNT
+} prof_counter;
+
+typedef struct {
+    double p50, p95, p99, max; // Milliseconds over the last PROF_HISTORY frames
+    int depth;                 // Nesting under PROF_FRAME
+} prof_stats;
+
+#if PROFILE
+#define PROF_BEGIN(stage) prof_begin(stage)
+#define PROF_END(stage) prof_end(stage)
+#define PROF_COUNT(counter, n) (prof_counters[counter] += (n))
+#define PROF_FRAME_BEGIN() prof_begin_frame()
+#define PROF_FRAME_END() prof_end_frame()
+#else
+#define PROF_BEGIN(stage) ((void)0)
+#define PROF_END(stage) ((void)0)
+#define PROF_COUNT(counter, n) ((void)0)
+#define PROF_FRAME_BEGIN() ((void)0)
+#define PROF_FRAME_END() ((void)0)
+#endif
+
+extern Uint32 prof_counters[PROF_COUNTER_COUNT]; // This frame's counts
+
+void prof_begin(prof_stage stage); // Scopes nest and must end in reverse order
+void prof_end(prof_stage stage);
+void prof_begin_frame(void);
+void prof_end_frame(void); // Files the frame's times and writes its CSV row
+int prof_open_csv(const char* filename); // One row per frame from then on
+void prof_close_csv(void);
+void prof_stage_stats(prof_stage stage, prof_stats* out);
+const char* prof_stage_name(prof_stage stage);
+void prof_overlay(text_font* f, int x, int y); // Queues a line of percentiles per stage, then collision queries per tick
+
+#endif
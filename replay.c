@@ -0,0 +1,235 @@
+#include "replay.h"
+#include "log.h"
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLAY_MAGIC "PTPREP2\n"
+#define REPLAY_HEADER 24 // Magic, tick rate, player 2, tick count, final hash, level hash, level path length
+
+static void put_u32(Uint8 *p, Uint32 v) {
+    p[0] = (Uint8)v;
+    p[1] = (Uint8)(v >> 8);
+    p[2] = (Uint8)(v >> 16);
+    p[3] = (Uint8)(v >> 24);
+}
+
+static Uint32 get_u32(const Uint8 *p) {
+    return p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+void init_replay(replay *r, int tick_rate, int player2_visible, const char *level, const collision_map *map) {
+    memset(r, 0, sizeof(*r));
+    r->tick_rate = tick_rate;
+    r->player2_visible = (Uint8)player2_visible;
+    if (level && strlen(level) >= sizeof(r->level)) {
+        // Played back without its level it fails check_replay_level rather than diverging
+        LOG_WARN(LOG_CORE, "Warning: level path too long to record, the replay won't find %s\n", level);
+    } else if (level) {
+        strcpy(r->level, level);
+    }
+    r->level_hash = hash_collision(map);
+}
+
+int record_replay(replay *r, const match_commands *c, const match *after) {
+    if (r->tick_count == r->capacity) {
+        Uint32 capacity = r->capacity ? r->capacity * 2 : 4096;
+        match_commands *grown = realloc(r->ticks, capacity * sizeof(match_commands));
+        Uint32 *checkpoints = grown ? realloc(r->checkpoints, (capacity / REPLAY_CHECKPOINT + 1) * sizeof(Uint32)) : NULL;
+        if (grown) r->ticks = grown;
+        if (!checkpoints) {
+            LOG_ERROR(LOG_CORE, "Out of memory recording tick %u\n", r->tick_count);
+            return -1;
+        }
+        r->checkpoints = checkpoints;
+        r->capacity = capacity;
+    }
+    r->ticks[r->tick_count++] = *c;
+    if (r->tick_count % REPLAY_CHECKPOINT == 0) r->checkpoints[r->checkpoint_count++] = hash_match(after);
+    return 0;
+}
+
+static int same_commands(const match_commands *a, const match_commands *b) {
+    return a->inputs[0] == b->inputs[0] && a->inputs[1] == b->inputs[1] && a->events == b->events;
+}
+
+int save_replay(replay *r, const char *path, Uint32 final_hash) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        LOG_ERROR(LOG_CORE, "Failed to write replay %s\n", path);
+        return -1;
+    }
+    r->final_hash = final_hash;
+    Uint8 header[REPLAY_HEADER];
+    memcpy(header, REPLAY_MAGIC, 8);
+    header[8] = (Uint8)r->tick_rate;
+    header[9] = (Uint8)(r->tick_rate >> 8);
+    header[10] = r->player2_visible;
+    put_u32(header + 11, r->tick_count);
+    put_u32(header + 15, final_hash);
+    put_u32(header + 19, r->level_hash);
+    header[23] = (Uint8)strlen(r->level);
+    fwrite(header, 1, sizeof(header), f);
+    fwrite(r->level, 1, header[23], f);
+
+    // Runs: the length as a base-128 varint, then the commands repeated that many ticks
+    long runs = 0;
+    for (Uint32 t = 0; t < r->tick_count;) {
+        Uint32 length = 1;
+        while (t + length < r->tick_count && same_commands(&r->ticks[t], &r->ticks[t + length])) {
+            length++;
+        }
+        Uint8 run[8];
+        int size = 0;
+        for (Uint32 v = length; ; v >>= 7) {
+            run[size++] = (Uint8)((v & 0x7f) | (v > 0x7f ? 0x80 : 0));
+            if (v <= 0x7f) break;
+        }
+        run[size++] = r->ticks[t].inputs[0];
+        run[size++] = r->ticks[t].inputs[1];
+        run[size++] = r->ticks[t].events;
+        fwrite(run, 1, size, f);
+        t += length;
+        runs++;
+    }
+    for (Uint32 i = 0; i < r->checkpoint_count; i++) {
+        Uint8 hash[4];
+        put_u32(hash, r->checkpoints[i]);
+        fwrite(hash, 1, sizeof(hash), f);
+    }
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+    long bytes = ftell(f); // Only logged
+#endif
+    if (fclose(f) != 0) {
+        LOG_ERROR(LOG_CORE, "Failed to write replay %s\n", path);
+        return -1;
+    }
+    LOG_INFO(LOG_CORE, "Replay saved to %s: %u ticks in %ld runs, %ld bytes\n", path, r->tick_count, runs, bytes);
+    return 0;
+}
+
+// Walks the runs that make up tick_count ticks, writing them to ticks unless it is NULL.
+// Returns the bytes they take, or -1 if one is malformed or the data ends first.
+static long decode_runs(const Uint8 *data, long size, Uint32 tick_count, match_commands *ticks) {
+    long at = 0;
+    for (Uint32 t = 0; t < tick_count;) {
+        Uint32 length = 0;
+        Uint8 c;
+        int n = 0;
+        do {
+            // A Uint32 takes at most 5 bytes, the last holding its top 4 bits
+            if (at == size || n == 5) return -1;
+            c = data[at++];
+            if (n == 4 && (c & 0x7f) > 0x0f) return -1;
+            length |= (Uint32)(c & 0x7f) << (7 * n++);
+        } while (c & 0x80);
+        if (length == 0 || length > tick_count - t || size - at < 3) return -1;
+        if (ticks) {
+            match_commands cmd = {{data[at], data[at + 1]}, data[at + 2]};
+            for (Uint32 i = 0; i < length; i++) {
+                ticks[t + i] = cmd;
+            }
+        }
+        at += 3;
+        t += length;
+    }
+    return at;
+}
+
+int load_replay(replay *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        LOG_ERROR(LOG_CORE, "Failed to open replay %s\n", path);
+        return -1;
+    }
+    Uint8 header[REPLAY_HEADER];
+    if (fread(header, 1, sizeof(header), f) != sizeof(header) || memcmp(header, REPLAY_MAGIC, 8) != 0) {
+        LOG_ERROR(LOG_CORE, "%s: not a replay\n", path);
+        fclose(f);
+        return -1;
+    }
+    r->tick_rate = header[8] | (header[9] << 8);
+    r->player2_visible = header[10];
+    Uint32 tick_count = get_u32(header + 11);
+    r->final_hash = get_u32(header + 15);
+    r->level_hash = get_u32(header + 19);
+    if (fread(r->level, 1, header[23], f) != header[23]) {
+        LOG_ERROR(LOG_CORE, "%s: truncated in its level path\n", path);
+        fclose(f);
+        return -1;
+    }
+    r->level[header[23]] = '\0';
+
+    // The runs and checkpoints, read whole and checked before anything is sized from tick_count,
+    // so a corrupt header can't ask for gigabytes
+    long body_start = ftell(f);
+    long size = fseek(f, 0, SEEK_END) == 0 ? ftell(f) - body_start : -1;
+    Uint8 *body = size >= 0 && fseek(f, body_start, SEEK_SET) == 0 ? malloc(size ? size : 1) : NULL;
+    if (!body || fread(body, 1, size, f) != (size_t)size) {
+        LOG_ERROR(LOG_CORE, "Failed to read replay %s\n", path);
+        free(body);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    // save_replay writes a checkpoint every REPLAY_CHECKPOINT ticks, which bounds tick_count by
+    // the file size even when one run claims them all
+    long runs_size = decode_runs(body, size, tick_count, NULL);
+    if (runs_size < 0 || (size - runs_size) / 4 < tick_count / REPLAY_CHECKPOINT) {
+        LOG_ERROR(LOG_CORE, "%s: malformed or truncated for its %u ticks\n", path, tick_count);
+        free(body);
+        return -1;
+    }
+
+    r->ticks = malloc((tick_count ? tick_count : 1) * sizeof(match_commands));
+    r->checkpoints = malloc((tick_count / REPLAY_CHECKPOINT + 1) * sizeof(Uint32));
+    if (!r->ticks || !r->checkpoints) {
+        LOG_ERROR(LOG_CORE, "Out of memory for a replay of %u ticks\n", tick_count);
+        free(body);
+        free_replay(r);
+        return -1;
+    }
+    r->capacity = tick_count;
+    decode_runs(body, size, tick_count, r->ticks);
+    r->tick_count = tick_count;
+    while (r->checkpoint_count < tick_count / REPLAY_CHECKPOINT) {
+        r->checkpoints[r->checkpoint_count] = get_u32(body + runs_size + 4 * r->checkpoint_count);
+        r->checkpoint_count++;
+    }
+    free(body);
+    LOG_INFO(LOG_CORE, "Replay %s: %u ticks at %d Hz\n", path, r->tick_count, r->tick_rate);
+    return 0;
+}
+
+int check_replay(const replay *r, Uint32 tick, const match *m) {
+    if (tick == 0 || tick % REPLAY_CHECKPOINT != 0 || tick / REPLAY_CHECKPOINT > r->checkpoint_count) return 0;
+    return hash_match(m) == r->checkpoints[tick / REPLAY_CHECKPOINT - 1] ? 0 : -1;
+}
+
+int check_replay_level(const replay *r, const collision_map *map) {
+    Uint32 hash = hash_collision(map);
+    if (hash == r->level_hash) return 0;
+    LOG_ERROR(LOG_CORE, "Replay recorded on %s (tiles %08x), but the level here has tiles %08x\n",
+              r->level[0] ? r->level : "the single screen", r->level_hash, hash);
+    return -1;
+}
+
+Uint32 play_replay(const replay *r, match *m, engine_clock *c, Uint32 from, Uint32 to, Uint32 *diverged) {
+    if (to > r->tick_count) to = r->tick_count;
+    *diverged = 0;
+    for (Uint32 t = from; t < to; t++) {
+        apply_match_events(m, r->ticks[t].events);
+        step_match(m, r->ticks[t].inputs);
+        clock_step(c);
+        if (!*diverged && check_replay(r, t + 1, m) != 0) *diverged = t + 1;
+    }
+    return hash_match(m);
+}
+
+void free_replay(replay *r) {
+    free(r->ticks);
+    free(r->checkpoints);
+    memset(r, 0, sizeof(*r));
+}
@@ -0,0 +1,40 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <SDL/SDL.h>
+#include "match.h"
+#include "timing.h"
+#include "collide.h"
+
+#define REPLAY_CHECKPOINT 600 // Ticks between state hashes, so a divergence shows where it started
+#define REPLAY_LEVEL_MAX 256  // Level path, terminator included
+
+// A session as the commands of every tick, enough to play the match again exactly.
+// On disk each run of identical ticks is stored once with its length, so held keys
+// cost a few bytes however long they are held.
+typedef struct {
+    int tick_rate;
+    Uint8 player2_visible; // At the first tick
+    char level[REPLAY_LEVEL_MAX]; // Played on, "" for the single screen
+    Uint32 level_hash;            // hash_collision of its solid tiles, which steer the match
+    Uint32 tick_count;
+    match_commands* ticks;
+    Uint32 capacity;
+    Uint32* checkpoints; // hash_match after every REPLAY_CHECKPOINT ticks
+    Uint32 checkpoint_count;
+    Uint32 final_hash; // hash_match after the last tick, 0 when not saved yet
+} replay;
+
+// level is the path map was loaded from, NULL for the single screen
+void init_replay(replay* r, int tick_rate, int player2_visible, const char* level, const collision_map* map);
+int record_replay(replay* r, const match_commands* c, const match* after); // Appends the tick c just ran
+int save_replay(replay* r, const char* path, Uint32 final_hash);
+int load_replay(replay* r, const char* path); // -1 when missing or malformed
+int check_replay(const replay* r, Uint32 tick, const match* m); // -1 if m differs from a checkpoint after tick
+int check_replay_level(const replay* r, const collision_map* map); // -1, logged, unless map is the recorded level's
+// Runs ticks [from, to) as fast as it can and returns hash_match afterwards. *diverged gets
+// the first checkpoint that didn't match, 0 if none.
+Uint32 play_replay(const replay* r, match* m, engine_clock* c, Uint32 from, Uint32 to, Uint32* diverged);
+void free_replay(replay* r);
+
+#endif
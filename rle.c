@@ -0,0 +1,141 @@
+#include "rle.h"
+#include "log.h"
+#include <SDL/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_RUN 0xffff
+
+rle_sprite *encode_rle(SDL_Surface *src, const SDL_Rect *frame) {
+    SDL_PixelFormat *f = src->format;
+    if (f->BytesPerPixel != 4 || !(src->flags & SDL_SRCCOLORKEY)) return NULL;
+    if ((src->flags & SDL_SRCALPHA) && f->Amask) return NULL;
+
+    int x0 = frame->x < 0 ? 0 : frame->x;
+    int y0 = frame->y < 0 ? 0 : frame->y;
+    int x1 = frame->x + frame->w < src->w ? frame->x + frame->w : src->w;
+    int y1 = frame->y + frame->h < src->h ? frame->y + frame->h : src->h;
+    if (x1 <= x0 || y1 <= y0) return NULL;
+    int w = x1 - x0;
+    int h = y1 - y0;
+    Uint32 mask = ~f->Amask;
+    Uint32 key = f->colorkey & mask;
+
+    if (SDL_MUSTLOCK(src) && SDL_LockSurface(src) < 0) return NULL;
+
+    // First pass sizes the single allocation, second pass fills it
+    int runs = 0;
+    int pixels = 0;
+    for (int y = y0; y < y1; y++) {
+        const Uint32 *row = (const Uint32 *)((const Uint8 *)src->pixels + y * src->pitch);
+        int x = x0;
+        while (x < x1) {
+            while (x < x1 && (row[x] & mask) == key) x++;
+            if (x == x1) break;
+            int start = x;
+            while (x < x1 && (row[x] & mask) != key && x - start < MAX_RUN) x++;
+            pixels += x - start;
+            runs++;
+        }
+    }
+
+    size_t bytes = sizeof(rle_sprite) + 2 * (h + 1) * sizeof(Uint32) + runs * sizeof(rle_run) + pixels * sizeof(Uint32);
+    rle_sprite *s = malloc(bytes);
+    if (!s) {
+        if (SDL_MUSTLOCK(src)) SDL_UnlockSurface(src);
+        LOG_ERROR(LOG_RENDER, "Out of memory encoding a %dx%d frame\n", w, h);
+        return NULL;
+    }
+    s->w = w;
+    s->h = h;
+    s->run_count = runs;
+    s->pixel_count = pixels;
+    s->row_runs = (Uint32 *)(s + 1);
+    s->row_pixels = s->row_runs + h + 1;
+    s->pixels = s->row_pixels + h + 1;
+    s->runs = (rle_run *)(s->pixels + pixels);
+
+    runs = 0;
+    pixels = 0;
+    for (int y = y0; y < y1; y++) {
+        const Uint32 *row = (const Uint32 *)((const Uint8 *)src->pixels + y * src->pitch);
+        s->row_runs[y - y0] = runs;
+        s->row_pixels[y - y0] = pixels;
+        int x = x0;
+        int last = x0;
+        while (x < x1) {
+            while (x < x1 && (row[x] & mask) == key) x++;
+            if (x == x1) break;
+            int start = x;
+            while (x < x1 && (row[x] & mask) != key && x - start < MAX_RUN) x++;
+            s->runs[runs].skip = start - last;
+            s->runs[runs].count = x - start;
+            memcpy(s->pixels + pixels, row + start, (x - start) * sizeof(Uint32));
+            pixels += x - start;
+            runs++;
+            last = x;
+        }
+    }
+    s->row_runs[h] = runs;
+    s->row_pixels[h] = pixels;
+
+    if (SDL_MUSTLOCK(src)) SDL_UnlockSurface(src);
+    return s;
+}
+
+void free_rle(rle_sprite *s) {
+    free(s);
+}
+
+size_t rle_size(const rle_sprite *s) {
+    return sizeof(rle_sprite) + 2 * (s->h + 1) * sizeof(Uint32) + s->run_count * sizeof(rle_run) +
+           s->pixel_count * sizeof(Uint32);
+}
+
+int blit_rle(const rle_sprite *s, SDL_Surface *dst, SDL_Rect *dst_rect, int mirror) {
+    // Visible frame columns and rows, in destination order
+    const SDL_Rect *clip = &dst->clip_rect;
+    int dx = dst_rect->x;
+    int dy = dst_rect->y;
+    int x0 = clip->x - dx > 0 ? clip->x - dx : 0;
+    int y0 = clip->y - dy > 0 ? clip->y - dy : 0;
+    int x1 = clip->x + clip->w - dx < s->w ? clip->x + clip->w - dx : s->w;
+    int y1 = clip->y + clip->h - dy < s->h ? clip->y + clip->h - dy : s->h;
+    dst_rect->x = dx + x0;
+    dst_rect->y = dy + y0;
+    dst_rect->w = x1 > x0 ? x1 - x0 : 0;
+    dst_rect->h = y1 > y0 ? y1 - y0 : 0;
+    if (x1 <= x0 || y1 <= y0) return 0;
+
+    // A mirrored frame shows source column c at w - 1 - c
+    int c0 = mirror ? s->w - x1 : x0;
+    int c1 = mirror ? s->w - x0 : x1;
+
+    if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) < 0) return -1;
+    for (int y = y0; y < y1; y++) {
+        Uint32 *row = (Uint32 *)((Uint8 *)dst->pixels + (dy + y) * dst->pitch);
+        const rle_run *run = s->runs + s->row_runs[y];
+        const rle_run *end = s->runs + s->row_runs[y + 1];
+        const Uint32 *px = s->pixels + s->row_pixels[y];
+        int x = 0;
+        for (; run < end && x < c1; run++) {
+            x += run->skip;
+            int a = x > c0 ? x : c0;
+            int b = x + run->count < c1 ? x + run->count : c1;
+            if (a < b) {
+                if (!mirror) {
+                    memcpy(row + dx + a, px + (a - x), (b - a) * sizeof(Uint32));
+                } else {
+                    Uint32 *out = row + dx + s->w - 1 - a;
+                    for (int i = a; i < b; i++) {
+                        *out-- = px[i - x];
+                    }
+                }
+            }
+            px += run->count;
+            x += run->count;
+        }
+    }
+    if (SDL_MUSTLOCK(dst)) SDL_UnlockSurface(dst);
+    return 0;
+}
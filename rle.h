@@ -0,0 +1,31 @@
+#ifndef RLE_H
+#define RLE_H
+
+#include <SDL/SDL.h>
+
+typedef struct {
+    Uint16 skip;  // Transparent pixels before the run
+    Uint16 count; // Opaque pixels copied
+} rle_run;
+
+// One frame of a colour-keyed sheet, keeping only its visible pixels
+typedef struct {
+    int w, h;
+    int run_count;
+    int pixel_count;
+    Uint32* row_runs;   // First run of each row, h + 1 entries
+    Uint32* row_pixels; // First pixel of each row
+    rle_run* runs;
+    Uint32* pixels;     // Opaque pixels in row order, in the sheet's format
+} rle_sprite;
+
+// NULL unless src is a colour-keyed 32-bit surface without per-pixel alpha
+rle_sprite* encode_rle(SDL_Surface* src, const SDL_Rect* frame);
+void free_rle(rle_sprite* s);
+size_t rle_size(const rle_sprite* s);
+
+// Draws into a surface of the format it was encoded from, mirrored on request.
+// dst_rect gets the clipped area, like SDL_BlitSurface.
+int blit_rle(const rle_sprite* s, SDL_Surface* dst, SDL_Rect* dst_rect, int mirror);
+
+#endif
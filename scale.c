@@ -0,0 +1,229 @@
+#include "scale.h"
+#include "blit.h"
+#include "log.h"
+#include <SDL/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCALE_X86 1
+#endif
+
+#define MAX_PRESENT_RECTS 128 // More than this and the whole view is presented
+
+// Fills w pixels of one screen row, starting at view column col, from one back buffer row
+typedef void (*scale_row_fn)(Uint32 *dst, const Uint32 *src, const Uint16 *x_map, int col, int w);
+
+static void row_copy(Uint32 *dst, const Uint32 *src, const Uint16 *x_map, int col, int w) {
+    (void)x_map;
+    memcpy(dst, src + col, w * sizeof(Uint32));
+}
+
+static void row_nearest_scalar(Uint32 *dst, const Uint32 *src, const Uint16 *x_map, int col, int w) {
+    for (int i = 0; i < w; i++) {
+        dst[i] = src[x_map[col + i]];
+    }
+}
+
+#ifdef SCALE_X86
+// Each source pixel twice: four in, eight out
+__attribute__((target("sse2")))
+static void row_double_sse2(Uint32 *dst, const Uint32 *src, const Uint16 *x_map, int col, int w) {
+    int i = 0;
+    if ((col & 1) && w > 0) {
+        dst[0] = src[x_map[col]];
+        i = 1;
+    }
+    const Uint32 *s = src + (col + i) / 2;
+    for (; i + 8 <= w; i += 8, s += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)s);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi32(v, v));
+        _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi32(v, v));
+    }
+    row_nearest_scalar(dst + i, src, x_map, col + i, w - i);
+}
+
+__attribute__((target("avx2")))
+static void row_nearest_avx2(Uint32 *dst, const Uint32 *src, const Uint16 *x_map, int col, int w) {
+    int i = 0;
+    for (; i + 8 <= w; i += 8) {
+        __m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(x_map + col + i)));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_i32gather_epi32((const int *)src, index, 4));
+    }
+    _mm256_zeroupper();
+    row_nearest_scalar(dst + i, src, x_map, col + i, w - i);
+}
+#endif
+
+static scale_row_fn pick_row(const scaler *s) {
+    if (s->factor == 1) return row_copy;
+#ifdef SCALE_X86
+    blit_kernel k = current_blit_kernel();
+    if (s->factor == 2 && k >= BLIT_SSE2) return row_double_sse2;
+    if (k == BLIT_AVX2) return row_nearest_avx2;
+#endif
+    return row_nearest_scalar;
+}
+
+static int same_layout(SDL_Surface *a, SDL_Surface *b) {
+    SDL_PixelFormat *fa = a->format;
+    SDL_PixelFormat *fb = b->format;
+    return fa->BytesPerPixel == 4 && fb->BytesPerPixel == 4 && fa->Rmask == fb->Rmask && fa->Gmask == fb->Gmask &&
+           fa->Bmask == fb->Bmask;
+}
+
+int init_scaler(scaler *s, SDL_Surface *screen, scale_mode mode) {
+    memset(s, 0, sizeof(*s));
+    s->mode = mode;
+    SDL_PixelFormat *f = screen->format;
+    if (f->BytesPerPixel == 4) {
+        s->back = SDL_CreateRGBSurface(SDL_SWSURFACE, LOGICAL_WIDTH, LOGICAL_HEIGHT, 32, f->Rmask, f->Gmask, f->Bmask, 0);
+    } else {
+        s->back = SDL_CreateRGBSurface(SDL_SWSURFACE, LOGICAL_WIDTH, LOGICAL_HEIGHT, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0);
+    }
+    if (!s->back) {
+        LOG_ERROR(LOG_RENDER, "Failed to create the %dx%d back buffer: %s\n", LOGICAL_WIDTH, LOGICAL_HEIGHT, SDL_GetError());
+        return -1;
+    }
+    SDL_FillRect(s->back, NULL, SDL_MapRGB(s->back->format, 0, 0, 0));
+    if (reset_scaler(s, screen) != 0) {
+        free_scaler(s);
+        return -1;
+    }
+    return 0;
+}
+
+int reset_scaler(scaler *s, SDL_Surface *screen) {
+    int k = screen->w / LOGICAL_WIDTH < screen->h / LOGICAL_HEIGHT ? screen->w / LOGICAL_WIDTH : screen->h / LOGICAL_HEIGHT;
+    int vw, vh;
+    if (s->mode == SCALE_INTEGER && k >= 1) {
+        vw = LOGICAL_WIDTH * k;
+        vh = LOGICAL_HEIGHT * k;
+    } else if (screen->w * LOGICAL_HEIGHT <= screen->h * LOGICAL_WIDTH) {
+        vw = screen->w;
+        vh = screen->w * LOGICAL_HEIGHT / LOGICAL_WIDTH;
+    } else {
+        vh = screen->h;
+        vw = screen->h * LOGICAL_WIDTH / LOGICAL_HEIGHT;
+    }
+    s->view.x = (screen->w - vw) / 2;
+    s->view.y = (screen->h - vh) / 2;
+    s->view.w = vw;
+    s->view.h = vh;
+    s->factor = k >= 1 && vw == LOGICAL_WIDTH * k && vh == LOGICAL_HEIGHT * k ? k : 0;
+
+    free(s->x_map);
+    free(s->y_map);
+    s->x_map = malloc(vw * sizeof(Uint16));
+    s->y_map = malloc(vh * sizeof(Uint16));
+    if (s->stage) {
+        SDL_FreeSurface(s->stage);
+        s->stage = NULL;
+    }
+    if (!same_layout(s->back, screen)) {
+        // SDL converts the scaled view to the screen's format afterwards
+        SDL_PixelFormat *f = s->back->format;
+        s->stage = SDL_CreateRGBSurface(SDL_SWSURFACE, vw, vh, 32, f->Rmask, f->Gmask, f->Bmask, 0);
+    }
+    if (!s->x_map || !s->y_map || (!same_layout(s->back, screen) && !s->stage)) {
+        LOG_ERROR(LOG_RENDER, "Failed to set up scaling to %dx%d\n", vw, vh);
+        return -1;
+    }
+    for (int x = 0; x < vw; x++) {
+        s->x_map[x] = (Uint16)(x * LOGICAL_WIDTH / vw);
+    }
+    for (int y = 0; y < vh; y++) {
+        s->y_map[y] = (Uint16)(y * LOGICAL_HEIGHT / vh);
+    }
+    s->clear = 1;
+    LOG_INFO(LOG_RENDER, "Presenting %dx%d at %dx%d+%d+%d (%s)\n", LOGICAL_WIDTH, LOGICAL_HEIGHT, vw, vh,
+             s->view.x, s->view.y, s->factor ? "integer" : "nearest");
+    return 0;
+}
+
+static int ceil_div(int a, int b) {
+    return (a + b - 1) / b;
+}
+
+// Screen area whose nearest source pixels all lie in the back buffer rect r; 0 if empty
+static int map_rect(const scaler *s, const SDL_Rect *r, SDL_Rect *out) {
+    int x0 = r->x > 0 ? r->x : 0;
+    int y0 = r->y > 0 ? r->y : 0;
+    int x1 = r->x + r->w < LOGICAL_WIDTH ? r->x + r->w : LOGICAL_WIDTH;
+    int y1 = r->y + r->h < LOGICAL_HEIGHT ? r->y + r->h : LOGICAL_HEIGHT;
+    if (x1 <= x0 || y1 <= y0) return 0;
+
+    int vx0 = ceil_div(x0 * s->view.w, LOGICAL_WIDTH);
+    int vx1 = ceil_div(x1 * s->view.w, LOGICAL_WIDTH);
+    int vy0 = ceil_div(y0 * s->view.h, LOGICAL_HEIGHT);
+    int vy1 = ceil_div(y1 * s->view.h, LOGICAL_HEIGHT);
+    if (vx1 <= vx0 || vy1 <= vy0) return 0;
+    out->x = s->view.x + vx0;
+    out->y = s->view.y + vy0;
+    out->w = vx1 - vx0;
+    out->h = vy1 - vy0;
+    return 1;
+}
+
+// Scales one mapped area into dst, whose top-left pixel sits at screen (ox, oy)
+static void scale_area(const scaler *s, scale_row_fn row, SDL_Surface *dst, int ox, int oy, const SDL_Rect *r) {
+    Uint8 *out = (Uint8 *)dst->pixels + (r->y - oy) * dst->pitch + (r->x - ox) * sizeof(Uint32);
+    int col = r->x - s->view.x;
+    int previous = -1;
+    for (int y = 0; y < r->h; y++, out += dst->pitch) {
+        int sy = s->y_map[r->y - s->view.y + y];
+        if (sy == previous) {
+            // Rows repeated by the scale are copied from the one just made
+            memcpy(out, out - dst->pitch, r->w * sizeof(Uint32));
+            continue;
+        }
+        row((Uint32 *)out, (const Uint32 *)((const Uint8 *)s->back->pixels + sy * s->back->pitch), s->x_map, col, r->w);
+        previous = sy;
+    }
+}
+
+void present_scaled(scaler *s, SDL_Surface *screen, const SDL_Rect *rects, int count) {
+    SDL_Rect whole = {0, 0, LOGICAL_WIDTH, LOGICAL_HEIGHT};
+    if (s->clear || !rects || count > MAX_PRESENT_RECTS) {
+        rects = &whole;
+        count = 1;
+    }
+    if (s->clear) {
+        SDL_FillRect(screen, NULL, SDL_MapRGB(screen->format, 0, 0, 0));
+    }
+
+    SDL_Surface *dst = s->stage ? s->stage : screen;
+    int ox = s->stage ? s->view.x : 0;
+    int oy = s->stage ? s->view.y : 0;
+    if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) < 0) return;
+    scale_row_fn row = pick_row(s);
+    SDL_Rect mapped[MAX_PRESENT_RECTS];
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (!map_rect(s, &rects[i], &mapped[n])) continue;
+        scale_area(s, row, dst, ox, oy, &mapped[n]);
+        n++;
+    }
+    if (SDL_MUSTLOCK(dst)) SDL_UnlockSurface(dst);
+
+    for (int i = 0; s->stage && i < n; i++) {
+        SDL_Rect src = {mapped[i].x - ox, mapped[i].y - oy, mapped[i].w, mapped[i].h};
+        SDL_Rect to = mapped[i];
+        SDL_BlitSurface(s->stage, &src, screen, &to);
+    }
+    if (s->clear) {
+        SDL_UpdateRect(screen, 0, 0, 0, 0);
+        s->clear = 0;
+    } else {
+        SDL_UpdateRects(screen, n, mapped);
+    }
+}
+
+void free_scaler(scaler *s) {
+    if (s->back) SDL_FreeSurface(s->back);
+    if (s->stage) SDL_FreeSurface(s->stage);
+    free(s->x_map);
+    free(s->y_map);
+    memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,33 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <SDL/SDL.h>
+
+// The game always renders and simulates at this size, whatever the video mode
+#define LOGICAL_WIDTH 960
+#define LOGICAL_HEIGHT 540
+
+typedef enum {
+    SCALE_INTEGER, // Largest whole multiple that fits, nearest neighbour below 1x
+    SCALE_FIT      // Largest aspect-correct area, nearest neighbour
+} scale_mode;
+
+// Presents a fixed back buffer into the active mode, letterboxed
+typedef struct {
+    SDL_Surface* back;  // LOGICAL_WIDTH x LOGICAL_HEIGHT, everything draws here
+    SDL_Surface* stage; // Scaled copy in the back buffer's format, only when the screen's differs
+    scale_mode mode;
+    SDL_Rect view;      // Where the back buffer lands on screen
+    int factor;         // Whole multiple the view is of the back buffer, 0 if not one
+    Uint16* x_map;      // Source column of each view column
+    Uint16* y_map;      // Source row of each view row
+    int clear;          // Repaint the bars and the whole view at the next present
+} scaler;
+
+int init_scaler(scaler* s, SDL_Surface* screen, scale_mode mode); // Back buffer in the screen's format
+int reset_scaler(scaler* s, SDL_Surface* screen); // After a video mode change; the back buffer stays
+// Scales the given back buffer rects (all of it when rects is NULL) to the screen and updates them
+void present_scaled(scaler* s, SDL_Surface* screen, const SDL_Rect* rects, int count);
+void free_scaler(scaler* s);
+
+#endif
@@ -0,0 +1,232 @@
+#include "text.h"
+#include "log.h"
+#include "profile.h"
+#include "loader.h"
+#include <SDL/SDL.h>
+#include <SDL/SDL_ttf.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ATLAS_COLUMNS 16
+
+typedef struct {
+    text_font* font;
+    Uint8 glyph;
+    Sint16 x, y;
+} glyph_cmd;
+
+static void *font_data = NULL;
+static long font_size = 0;
+static text_font fonts[MAX_TEXT_FONTS];
+static int font_count = 0;
+static glyph_cmd batch[MAX_TEXT_GLYPHS];
+static int batch_count = 0;
+static int batch_x0, batch_y0, batch_x1, batch_y1; // Area covered by the batch
+
+static void finish_text(load_request *r, void *result, long size) {
+    if (!result) return;
+    font_data = result;
+    font_size = size;
+    LOG_INFO(LOG_RENDER, "Text engine initialized: %s (%ld bytes)\n", r->filename, font_size);
+}
+
+int init_text(const char *font_file) {
+    if (queue_load(font_file, LOAD_FILE, LOAD_PRIORITY_LOW, finish_text, NULL) == 0) {
+        return 0;
+    }
+
+    FILE *f = fopen(font_file, "rb");
+    if (!f) {
+        LOG_ERROR(LOG_RENDER, "Failed to open font %s\n", font_file);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    font_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    font_data = malloc(font_size);
+    if (!font_data || fread(font_data, 1, font_size, f) != (size_t)font_size) {
+        LOG_ERROR(LOG_RENDER, "Failed to read font %s\n", font_file);
+        free(font_data);
+        font_data = NULL;
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    LOG_INFO(LOG_RENDER, "Text engine initialized: %s (%ld bytes)\n", font_file, font_size);
+    return 0;
+}
+
+int text_ready(void) {
+    return font_data != NULL;
+}
+
+static int build_atlas(text_font *f, TTF_Font *ttf) {
+    SDL_Surface *cells[GLYPH_COUNT];
+    int cell_w = 1;
+    int cell_h = TTF_FontHeight(ttf);
+
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        char s[2] = {(char)(GLYPH_FIRST + i), '\0'};
+        int minx, maxx, miny, maxy;
+        cells[i] = TTF_RenderText_Solid(ttf, s, f->color);
+        if (TTF_GlyphMetrics(ttf, GLYPH_FIRST + i, &minx, &maxx, &miny, &maxy, &f->advance[i]) != 0) {
+            f->advance[i] = cells[i] ? cells[i]->w : 0;
+        }
+        if (cells[i] && cells[i]->w > cell_w) cell_w = cells[i]->w;
+        if (cells[i] && cells[i]->h > cell_h) cell_h = cells[i]->h;
+    }
+
+    int rows = (GLYPH_COUNT + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+    SDL_Surface *atlas = SDL_CreateRGBSurface(SDL_SWSURFACE, ATLAS_COLUMNS * cell_w, rows * cell_h, 32,
+                                              0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    if (!atlas) {
+        LOG_ERROR(LOG_RENDER, "Failed to create glyph atlas: %s\n", SDL_GetError());
+        for (int i = 0; i < GLYPH_COUNT; i++) {
+            if (cells[i]) SDL_FreeSurface(cells[i]);
+        }
+        return -1;
+    }
+
+    // Pick a key colour that can't clash with the text colour
+    Uint32 key = f->color.r == 255 && f->color.b == 255 ? SDL_MapRGB(atlas->format, 0, 255, 0)
+                                                        : SDL_MapRGB(atlas->format, 255, 0, 255);
+    SDL_FillRect(atlas, NULL, key);
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        SDL_Rect cell = {(i % ATLAS_COLUMNS) * cell_w, (i / ATLAS_COLUMNS) * cell_h, 0, 0};
+        f->glyphs[i].x = cell.x;
+        f->glyphs[i].y = cell.y;
+        f->glyphs[i].w = cells[i] ? cells[i]->w : 0;
+        f->glyphs[i].h = cells[i] ? cells[i]->h : 0;
+        if (cells[i]) {
+            SDL_BlitSurface(cells[i], NULL, atlas, &cell);
+            SDL_FreeSurface(cells[i]);
+        }
+    }
+    SDL_SetColorKey(atlas, SDL_SRCCOLORKEY, key);
+
+    SDL_Surface *optimized = SDL_GetVideoSurface() ? SDL_DisplayFormat(atlas) : NULL;
+    if (optimized) {
+        SDL_FreeSurface(atlas);
+        atlas = optimized;
+    }
+    f->atlas = atlas;
+    f->height = cell_h;
+
+    // Kerning is whatever the pair measures beyond the two glyphs on their own
+    for (int a = 0; a < GLYPH_COUNT; a++) {
+        for (int b = 0; b < GLYPH_COUNT; b++) {
+            char pair[3] = {(char)(GLYPH_FIRST + a), (char)(GLYPH_FIRST + b), '\0'};
+            int pair_w = 0, h = 0;
+            TTF_SizeText(ttf, pair, &pair_w, &h);
+            f->kerning[a][b] = (Sint8)(pair_w - f->advance[a] - f->glyphs[b].w);
+        }
+    }
+    return 0;
+}
+
+text_font *get_text_font(int ptsize, SDL_Color color) {
+    for (int i = 0; i < font_count; i++) {
+        if (fonts[i].ptsize == ptsize && fonts[i].color.r == color.r &&
+            fonts[i].color.g == color.g && fonts[i].color.b == color.b) {
+            return &fonts[i];
+        }
+    }
+    if (!font_data) {
+        if (!loader_running()) LOG_ERROR(LOG_RENDER, "Text engine not initialized\n");
+        return NULL;
+    }
+    if (font_count == MAX_TEXT_FONTS) {
+        LOG_ERROR(LOG_RENDER, "Too many text fonts (max %d)\n", MAX_TEXT_FONTS);
+        return NULL;
+    }
+
+    // Each size is opened from the in-memory copy and closed once rasterised
+    TTF_Font *ttf = TTF_OpenFontRW(SDL_RWFromConstMem(font_data, (int)font_size), 1, ptsize);
+    if (!ttf) {
+        LOG_ERROR(LOG_RENDER, "Failed to open font at size %d: %s\n", ptsize, TTF_GetError());
+        return NULL;
+    }
+
+    text_font *f = &fonts[font_count];
+    f->ptsize = ptsize;
+    f->color = color;
+    int result = build_atlas(f, ttf);
+    TTF_CloseFont(ttf);
+    if (result != 0) {
+        return NULL;
+    }
+    font_count++;
+    LOG_INFO(LOG_RENDER, "Glyph atlas built: size %d, %dx%d\n", ptsize, f->atlas->w, f->atlas->h);
+    return f;
+}
+
+int text_width(text_font *f, const char *s) {
+    int w = 0;
+    for (; *s; s++) {
+        int g = (Uint8)*s - GLYPH_FIRST;
+        if (g < 0 || g >= GLYPH_COUNT) continue;
+        w += f->advance[g];
+        int next = (Uint8)s[1] - GLYPH_FIRST;
+        if (next >= 0 && next < GLYPH_COUNT) w += f->kerning[g][next];
+    }
+    return w;
+}
+
+void queue_text(text_font *f, int x, int y, const char *fmt, ...) {
+    if (!f) return;
+
+    char buffer[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+
+    for (const char *s = buffer; *s && batch_count < MAX_TEXT_GLYPHS; s++) {
+        int g = (Uint8)*s - GLYPH_FIRST;
+        if (g < 0 || g >= GLYPH_COUNT) continue;
+        if (g != 0) {
+            batch[batch_count].font = f;
+            batch[batch_count].glyph = (Uint8)g;
+            batch[batch_count].x = x;
+            batch[batch_count].y = y;
+            if (batch_count == 0 || x < batch_x0) batch_x0 = x;
+            if (batch_count == 0 || y < batch_y0) batch_y0 = y;
+            if (batch_count == 0 || x + f->glyphs[g].w > batch_x1) batch_x1 = x + f->glyphs[g].w;
+            if (batch_count == 0 || y + f->glyphs[g].h > batch_y1) batch_y1 = y + f->glyphs[g].h;
+            batch_count++;
+        }
+        x += f->advance[g];
+        int next = (Uint8)s[1] - GLYPH_FIRST;
+        if (next >= 0 && next < GLYPH_COUNT) x += f->kerning[g][next];
+    }
+}
+
+int text_batch_bounds(SDL_Rect *r) {
+    if (batch_count == 0) return 0;
+    r->x = batch_x0;
+    r->y = batch_y0;
+    r->w = batch_x1 - batch_x0;
+    r->h = batch_y1 - batch_y0;
+    return 1;
+}
+
+void flush_text(compositor *c) {
+    for (int i = 0; i < batch_count; i++) {
+        glyph_cmd *g = &batch[i];
+        compose_blit(c, g->font->atlas, &g->font->glyphs[g->glyph], g->x, g->y);
+    }
+    PROF_COUNT(PROF_GLYPHS, batch_count);
+    batch_count = 0;
+}
+
+void free_text(void) {
+    for (int i = 0; i < font_count; i++) {
+        SDL_FreeSurface(fonts[i].atlas);
+        fonts[i].atlas = NULL;
+    }
+    font_count = 0;
+    batch_count = 0;
+    free(font_data);
+    font_data = NULL;
+}
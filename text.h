@@ -0,0 +1,33 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_ttf.h>
+#include "compose.h"
+
+#define GLYPH_FIRST 32 // Printable ASCII only
+#define GLYPH_COUNT 95
+#define MAX_TEXT_FONTS 8
+#define MAX_TEXT_GLYPHS 4096 // Glyphs queued per frame
+
+// One rasterised size/colour of the engine's font
+typedef struct {
+    int ptsize;
+    SDL_Color color;
+    SDL_Surface* atlas;
+    SDL_Rect glyphs[GLYPH_COUNT]; // Source rect of each glyph cell in the atlas
+    int advance[GLYPH_COUNT];
+    Sint8 kerning[GLYPH_COUNT][GLYPH_COUNT]; // Extra advance between a pair
+    int height;
+} text_font;
+
+int init_text(const char* font_file); // Reads the TTF into memory once, on the loader when it runs
+int text_ready(void);
+text_font* get_text_font(int ptsize, SDL_Color color); // Builds the atlas on first use, NULL until text_ready
+int text_width(text_font* f, const char* s);
+void queue_text(text_font* f, int x, int y, const char* fmt, ...);
+int text_batch_bounds(SDL_Rect* r); // Area the queued glyphs cover, 0 if none
+void flush_text(compositor* c); // Records this frame's batch and clears it
+void free_text(void);
+
+#endif
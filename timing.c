@@ -0,0 +1,92 @@
+#include "timing.h"
+#include "log.h"
+#include <SDL/SDL.h>
+#include <time.h>
+
+static double sim_seconds = 0;
+static double tick_length = 1.0 / DEFAULT_TICK_RATE;
+
+double clock_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void init_clock(engine_clock *c, int tick_rate, int frame_rate) {
+    c->tick_seconds = 1.0 / (tick_rate > 0 ? tick_rate : DEFAULT_TICK_RATE);
+    c->frame_seconds = frame_rate > 0 ? 1.0 / frame_rate : 0;
+    c->accumulator = 0;
+    c->last_time = clock_now();
+    c->next_frame = c->last_time + c->frame_seconds;
+    c->tick = 0;
+    c->dropped_frames = 0;
+
+    sim_seconds = 0;
+    tick_length = c->tick_seconds;
+    LOG_INFO(LOG_CORE, "Clock: %.1f Hz simulation, %s%.1f Hz frames\n", 1.0 / c->tick_seconds,
+             c->frame_seconds > 0 ? "" : "unpaced, ", c->frame_seconds > 0 ? 1.0 / c->frame_seconds : 0.0);
+}
+
+int clock_begin_frame(engine_clock *c) {
+    double now = clock_now();
+    c->accumulator += now - c->last_time;
+    c->last_time = now;
+
+    int ticks = (int)(c->accumulator / c->tick_seconds);
+    if (ticks > MAX_TICKS_PER_FRAME) {
+        // Too far behind to catch up: let the simulation slow down instead
+        LOG_WARN(LOG_CORE, "Clock: skipping %d ticks after a stall\n", ticks - MAX_TICKS_PER_FRAME);
+        ticks = MAX_TICKS_PER_FRAME;
+        c->accumulator = ticks * c->tick_seconds;
+    }
+    return ticks;
+}
+
+void clock_step(engine_clock *c) {
+    c->accumulator -= c->tick_seconds;
+    c->tick++;
+    sim_seconds = c->tick * c->tick_seconds;
+}
+
+void clock_hold(engine_clock *c) {
+    c->accumulator = 0;
+}
+
+void clock_seek(engine_clock *c, Uint32 tick) {
+    c->tick = tick;
+    sim_seconds = c->tick * c->tick_seconds;
+}
+
+float clock_alpha(const engine_clock *c) {
+    float alpha = (float)(c->accumulator / c->tick_seconds);
+    return alpha < 0 ? 0 : alpha > 1 ? 1 : alpha;
+}
+
+void clock_end_frame(engine_clock *c) {
+    if (c->frame_seconds <= 0) return;
+
+    double now = clock_now();
+    if (now > c->next_frame + c->frame_seconds) {
+        // Missed at least one whole frame: drop it rather than rush to catch up
+        c->dropped_frames += (Uint32)((now - c->next_frame) / c->frame_seconds);
+        c->next_frame = now + c->frame_seconds;
+        return;
+    }
+
+    // Sleep most of the remaining time, then spin for the last millisecond
+    double remaining = c->next_frame - now;
+    if (remaining > 0.002) {
+        SDL_Delay((Uint32)((remaining - 0.001) * 1000));
+    }
+    while (clock_now() < c->next_frame) {
+    }
+    c->next_frame += c->frame_seconds;
+}
+
+Uint32 sim_time_ms(void) {
+    return (Uint32)(sim_seconds * 1000.0 + 0.5);
+}
+
+float sim_dt(void) {
+    return (float)tick_length;
+}
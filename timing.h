@@ -0,0 +1,33 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <SDL/SDL.h>
+
+#define DEFAULT_TICK_RATE 60  // Simulation updates per second
+#define DEFAULT_FRAME_RATE 60 // Render target, 0 for unpaced
+#define MAX_TICKS_PER_FRAME 8 // Catch-up limit after a long stall
+
+typedef struct {
+    double tick_seconds;  // Fixed simulation step
+    double frame_seconds; // Target frame period, 0 when unpaced
+    double accumulator;   // Real time not yet simulated
+    double last_time;
+    double next_frame;    // Deadline of the next frame
+    Uint32 tick;          // Simulation ticks run so far
+    Uint32 dropped_frames;
+} engine_clock;
+
+double clock_now(void); // Monotonic seconds, high resolution
+void init_clock(engine_clock* c, int tick_rate, int frame_rate);
+int clock_begin_frame(engine_clock* c); // Number of ticks to simulate this frame
+void clock_step(engine_clock* c);       // Call once after each simulated tick
+void clock_hold(engine_clock* c); // Forgets ticks owed while the simulation waited on something else
+void clock_seek(engine_clock* c, Uint32 tick); // Rollback: simulation time of another tick, pacing untouched
+float clock_alpha(const engine_clock* c); // How far rendering is between the last two ticks
+void clock_end_frame(engine_clock* c);  // Waits for the next frame deadline
+
+// Simulation time, advanced by clock_step and moved by clock_seek
+Uint32 sim_time_ms(void);
+float sim_dt(void);
+
+#endif
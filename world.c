@@ -0,0 +1,379 @@
+#include "world.h"
+#include "blit.h"
+#include "log.h"
+#include "profile.h"
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void empty_world(world *w, SDL_Surface *target) {
+    memset(w, 0, sizeof(*w));
+    w->width = target->w;
+    w->height = target->h;
+}
+
+// Decodes every chunk once for the collision map, which the simulation needs everywhere
+// and not only where the camera is
+static int read_solid(world *w, FILE *f) {
+    if (init_collision(&w->solid, w->width_chunks * CHUNK_TILES, w->height_chunks * CHUNK_TILES) != 0) return -1;
+    Uint8 runs[CHUNK_RUNS_MAX];
+    Uint8 tiles[CHUNK_TILE_COUNT];
+    for (int cy = 0; cy < w->height_chunks; cy++) {
+        for (int cx = 0; cx < w->width_chunks; cx++) {
+            int index = cy * w->width_chunks + cx;
+            Uint32 size = w->offsets[index + 1] - w->offsets[index];
+            if (w->offsets[index + 1] < w->offsets[index] || size > sizeof(runs) ||
+                fseek(f, w->offsets[index], SEEK_SET) != 0 || fread(runs, 1, size, f) != size ||
+                decode_chunk(runs, size, tiles) != 0) {
+                continue; // Open, like the sky load_chunk shows for it
+            }
+            for (int i = 0; i < CHUNK_TILE_COUNT; i++) {
+                if (TILE_SOLID(tiles[i])) {
+                    set_solid(&w->solid, cx * CHUNK_TILES + i % CHUNK_TILES, cy * CHUNK_TILES + i / CHUNK_TILES);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int load_world(world *w, const char *path, SDL_Surface *target) {
+    empty_world(w, target);
+    if (!path) return 0;
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        LOG_INFO(LOG_CORE, "No %s, the world is the screen\n", path);
+        return -1;
+    }
+    level_header h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, LEVEL_MAGIC, 8) != 0 || h.version != LEVEL_VERSION ||
+        h.tile_size != TILE_SIZE || h.chunk_tiles != CHUNK_TILES || h.width_chunks == 0 || h.height_chunks == 0 ||
+        h.width_chunks > LEVEL_MAX_CHUNKS || h.height_chunks > LEVEL_MAX_CHUNKS) {
+        LOG_WARN(LOG_CORE, "Warning: %s is not a version %d level with %d px tiles, ignoring it\n", path, LEVEL_VERSION,
+                 TILE_SIZE);
+        fclose(f);
+        return -1;
+    }
+    int chunk_count = h.width_chunks * h.height_chunks;
+    w->offsets = malloc((chunk_count + 1) * sizeof(Uint32));
+    w->slots = malloc(chunk_count * sizeof(Sint16));
+    if (!w->offsets || !w->slots || fread(w->offsets, sizeof(Uint32), chunk_count + 1, f) != (size_t)chunk_count + 1) {
+        LOG_WARN(LOG_CORE, "Warning: %s is truncated, ignoring it\n", path);
+        fclose(f);
+        free_world(w);
+        empty_world(w, target);
+        return -1;
+    }
+    memset(w->slots, 0xff, chunk_count * sizeof(Sint16));
+    w->width_chunks = h.width_chunks;
+    w->height_chunks = h.height_chunks;
+    if (read_solid(w, f) != 0) {
+        fclose(f);
+        free_world(w);
+        empty_world(w, target);
+        return -1;
+    }
+
+    SDL_PixelFormat *fmt = target->format;
+    for (int i = 0; i < WORLD_CACHE_CHUNKS; i++) {
+        world_chunk *c = &w->cache[i];
+        c->cx = -1;
+        c->surface = SDL_CreateRGBSurface(SDL_SWSURFACE, CHUNK_SIZE, CHUNK_SIZE, fmt->BitsPerPixel, fmt->Rmask,
+                                          fmt->Gmask, fmt->Bmask, 0);
+        if (!c->surface) {
+            LOG_ERROR(LOG_CORE, "Failed to create chunk surface: %s\n", SDL_GetError());
+            fclose(f);
+            free_world(w);
+            empty_world(w, target);
+            return -1;
+        }
+    }
+    w->file = f;
+    w->width = w->width_chunks * CHUNK_SIZE;
+    w->height = w->height_chunks * CHUNK_SIZE;
+    LOG_INFO(LOG_CORE, "Level %s: %dx%d chunks, %dx%d px, %d chunks cached\n", path, w->width_chunks, w->height_chunks,
+             w->width, w->height, WORLD_CACHE_CHUNKS);
+    return 0;
+}
+
+static Uint32 tile_rgb(SDL_Surface *dst, int r, int g, int b) {
+    return SDL_MapRGB(dst->format, r, g, b);
+}
+
+static void fill(SDL_Surface *dst, int x, int y, int w, int h, Uint32 color) {
+    SDL_Rect r = {x, y, w, h};
+    SDL_FillRect(dst, &r, color);
+}
+
+void paint_tile(SDL_Surface *dst, int x, int y, Uint8 tile, int col, int row) {
+    int s = TILE_SIZE;
+    Uint32 speckle = (Uint32)col * 73856093u ^ (Uint32)row * 19349663u;
+    switch (tile) {
+        case TILE_GRASS:
+            fill(dst, x, y, s, s, tile_rgb(dst, 70, 140, 50));
+            fill(dst, x, y, s, 3, tile_rgb(dst, 120, 200, 80));
+            break;
+        case TILE_DIRT:
+            fill(dst, x, y, s, s, tile_rgb(dst, 110, 75, 45));
+            fill(dst, x + speckle % (s - 3), y + (speckle >> 8) % (s - 3), 3, 2, tile_rgb(dst, 85, 55, 35));
+            break;
+        case TILE_STONE:
+            fill(dst, x, y, s, s, tile_rgb(dst, 105, 105, 115));
+            fill(dst, x, y + s - 1, s, 1, tile_rgb(dst, 70, 70, 80));
+            fill(dst, x + s - 1, y, 1, s, tile_rgb(dst, 70, 70, 80));
+            break;
+        case TILE_BRICK: {
+            // Mortar every half tile, the joints offset on alternate courses
+            Uint32 mortar = tile_rgb(dst, 90, 80, 70);
+            fill(dst, x, y, s, s, tile_rgb(dst, 150, 60, 45));
+            fill(dst, x, y + s / 2 - 1, s, 1, mortar);
+            fill(dst, x, y + s - 1, s, 1, mortar);
+            fill(dst, x + (row % 2 ? s / 2 : 0), y, 1, s / 2, mortar);
+            fill(dst, x + (row % 2 ? 0 : s / 2), y + s / 2, 1, s / 2, mortar);
+            break;
+        }
+        case TILE_HILL:
+            fill(dst, x, y, s, s, tile_rgb(dst, 45, 80, 70));
+            break;
+        default: {
+            // Sky, lighter towards the horizon
+            int shade = row * 3 < 90 ? row * 3 : 90;
+            fill(dst, x, y, s, s, tile_rgb(dst, 30 + shade / 2, 45 + shade / 2, 90 + shade));
+            break;
+        }
+    }
+}
+
+static void render_chunk(world_chunk *c) {
+    for (int i = 0; i < CHUNK_TILE_COUNT; i++) {
+        int tx = i % CHUNK_TILES;
+        int ty = i / CHUNK_TILES;
+        paint_tile(c->surface, tx * TILE_SIZE, ty * TILE_SIZE, c->tiles[i], c->cx * CHUNK_TILES + tx,
+                   c->cy * CHUNK_TILES + ty);
+    }
+}
+
+// Reads, decodes and draws one chunk into the least recently wanted slot. NULL when every
+// slot is wanted this frame.
+static world_chunk *load_chunk(world *w, int cx, int cy) {
+    world_chunk *slot = NULL;
+    for (int i = 0; i < WORLD_CACHE_CHUNKS; i++) {
+        world_chunk *c = &w->cache[i];
+        if (c->cx < 0) {
+            slot = c;
+            break;
+        }
+        if (c->used != w->frame && (!slot || c->used < slot->used)) slot = c;
+    }
+    if (!slot) return NULL;
+    if (slot->cx >= 0) {
+        w->slots[slot->cy * w->width_chunks + slot->cx] = -1;
+        w->evictions++;
+    }
+
+    int index = cy * w->width_chunks + cx;
+    Uint8 runs[CHUNK_RUNS_MAX];
+    Uint32 size = w->offsets[index + 1] - w->offsets[index];
+    if (w->offsets[index + 1] < w->offsets[index] || size > sizeof(runs) ||
+        fseek(w->file, w->offsets[index], SEEK_SET) != 0 || fread(runs, 1, size, w->file) != size ||
+        decode_chunk(runs, size, slot->tiles) != 0) {
+        // Kept as sky so a bad chunk is reported once, not every frame
+        LOG_WARN(LOG_CORE, "Warning: level chunk %d,%d is malformed\n", cx, cy);
+        memset(slot->tiles, TILE_EMPTY, sizeof(slot->tiles));
+    }
+    slot->cx = cx;
+    slot->cy = cy;
+    slot->used = w->frame;
+    render_chunk(slot);
+    w->slots[index] = (Sint16)(slot - w->cache);
+    w->loads++;
+    PROF_COUNT(PROF_CHUNKS, 1);
+    LOG_TRACE(LOG_RENDER, "World: chunk %d,%d loaded\n", cx, cy);
+    return slot;
+}
+
+// Chunk range [x0, x1) x [y0, y1) covering the view grown by margin chunks, clipped to the level
+static void chunk_range(const world *w, const camera *c, int margin, int *x0, int *y0, int *x1, int *y1) {
+    *x0 = (c->x < 0 ? 0 : c->x / CHUNK_SIZE) - margin;
+    *y0 = (c->y < 0 ? 0 : c->y / CHUNK_SIZE) - margin;
+    *x1 = (c->x + c->w + CHUNK_SIZE - 1) / CHUNK_SIZE + margin;
+    *y1 = (c->y + c->h + CHUNK_SIZE - 1) / CHUNK_SIZE + margin;
+    if (*x0 < 0) *x0 = 0;
+    if (*y0 < 0) *y0 = 0;
+    if (*x1 > w->width_chunks) *x1 = w->width_chunks;
+    if (*y1 > w->height_chunks) *y1 = w->height_chunks;
+}
+
+int stream_world(world *w, const camera *c) {
+    if (!w->file) return 0;
+    w->frame++;
+
+    int x0, y0, x1, y1;
+    int loaded = 0;
+    chunk_range(w, c, 0, &x0, &y0, &x1, &y1);
+    for (int cy = y0; cy < y1; cy++) {
+        for (int cx = x0; cx < x1; cx++) {
+            int slot = w->slots[cy * w->width_chunks + cx];
+            if (slot >= 0) {
+                w->cache[slot].used = w->frame;
+            } else if (load_chunk(w, cx, cy)) {
+                loaded++;
+            }
+        }
+    }
+
+    // Ahead of the camera, a few per frame; the ones already in stay in
+    int budget = WORLD_PREFETCH_PER_FRAME;
+    chunk_range(w, c, WORLD_PREFETCH, &x0, &y0, &x1, &y1);
+    for (int cy = y0; cy < y1; cy++) {
+        for (int cx = x0; cx < x1; cx++) {
+            int slot = w->slots[cy * w->width_chunks + cx];
+            if (slot >= 0) {
+                w->cache[slot].used = w->frame;
+            } else if (budget > 0) {
+                load_chunk(w, cx, cy);
+                budget--;
+            }
+        }
+    }
+    return loaded;
+}
+
+// Part of chunk cx, cy inside the view: src in the chunk, *x, *y on the back buffer
+static void chunk_view(const camera *c, int cx, int cy, SDL_Rect *src, int *x, int *y) {
+    int left = cx * CHUNK_SIZE > c->x ? cx * CHUNK_SIZE : c->x;
+    int top = cy * CHUNK_SIZE > c->y ? cy * CHUNK_SIZE : c->y;
+    int right = (cx + 1) * CHUNK_SIZE < c->x + c->w ? (cx + 1) * CHUNK_SIZE : c->x + c->w;
+    int bottom = (cy + 1) * CHUNK_SIZE < c->y + c->h ? (cy + 1) * CHUNK_SIZE : c->y + c->h;
+    src->x = left - cx * CHUNK_SIZE;
+    src->y = top - cy * CHUNK_SIZE;
+    src->w = right - left;
+    src->h = bottom - top;
+    *x = left - c->x;
+    *y = top - c->y;
+}
+
+// The parts of the view past the level's edges, which no chunk covers; returns how many
+static int outside_level(const world *w, const camera *c, SDL_Rect *out) {
+    int left = c->x < 0 ? -c->x : 0;
+    int top = c->y < 0 ? -c->y : 0;
+    int right = w->width - c->x;
+    int bottom = w->height - c->y;
+    if (left > c->w) left = c->w;
+    if (top > c->h) top = c->h;
+    if (right > c->w) right = c->w;
+    if (bottom > c->h) bottom = c->h;
+    if (right < left) right = left;
+    if (bottom < top) bottom = top;
+
+    // Above, below, then left and right of the level between those two
+    SDL_Rect sides[4] = {{0, 0, c->w, top}, {0, bottom, c->w, c->h - bottom},
+                         {0, top, left, bottom - top}, {right, top, c->w - right, bottom - top}};
+    int n = 0;
+    for (int i = 0; i < 4; i++) {
+        if (sides[i].w > 0 && sides[i].h > 0) out[n++] = sides[i];
+    }
+    return n;
+}
+
+void draw_world(world *w, const camera *c, compositor *out) {
+    Uint32 black = SDL_MapRGB(out->target->format, 0, 0, 0);
+    if (!w->file) {
+        compose_fill(out, NULL, black);
+        return;
+    }
+    SDL_Rect outside[4];
+    int outside_count = outside_level(w, c, outside);
+    for (int i = 0; i < outside_count; i++) {
+        compose_fill(out, &outside[i], black);
+    }
+    int x0, y0, x1, y1;
+    chunk_range(w, c, 0, &x0, &y0, &x1, &y1);
+    for (int cy = y0; cy < y1; cy++) {
+        for (int cx = x0; cx < x1; cx++) {
+            SDL_Rect src;
+            int x, y;
+            chunk_view(c, cx, cy, &src, &x, &y);
+            int slot = w->slots[cy * w->width_chunks + cx];
+            if (slot >= 0) {
+                compose_blit(out, w->cache[slot].surface, &src, x, y);
+            } else {
+                SDL_Rect hole = {x, y, src.w, src.h};
+                compose_fill(out, &hole, black);
+            }
+        }
+    }
+}
+
+void paint_world(world *w, const camera *c, SDL_Surface *dst) {
+    Uint32 black = SDL_MapRGB(dst->format, 0, 0, 0);
+    if (!w->file) {
+        SDL_FillRect(dst, NULL, black);
+        return;
+    }
+    SDL_Rect outside[4];
+    int outside_count = outside_level(w, c, outside);
+    for (int i = 0; i < outside_count; i++) {
+        SDL_FillRect(dst, &outside[i], black);
+    }
+    int x0, y0, x1, y1;
+    int blits = 0;
+    chunk_range(w, c, 0, &x0, &y0, &x1, &y1);
+    for (int cy = y0; cy < y1; cy++) {
+        for (int cx = x0; cx < x1; cx++) {
+            SDL_Rect src;
+            int x, y;
+            chunk_view(c, cx, cy, &src, &x, &y);
+            SDL_Rect to = {x, y, src.w, src.h};
+            int slot = w->slots[cy * w->width_chunks + cx];
+            if (slot < 0) {
+                SDL_FillRect(dst, &to, black);
+            } else if (blit_sprite(w->cache[slot].surface, &src, dst, &to, 0) != 0) {
+                SDL_BlitSurface(w->cache[slot].surface, &src, dst, &to);
+            }
+            blits++;
+        }
+    }
+    PROF_COUNT(PROF_BLITS, blits);
+}
+
+void follow_camera(camera *c, const world *w, const SDL_Rect *targets, int count) {
+    if (count < 1) return;
+    int x0 = targets[0].x, y0 = targets[0].y;
+    int x1 = x0 + targets[0].w, y1 = y0 + targets[0].h;
+    for (int i = 1; i < count; i++) {
+        if (targets[i].x < x0) x0 = targets[i].x;
+        if (targets[i].y < y0) y0 = targets[i].y;
+        if (targets[i].x + targets[i].w > x1) x1 = targets[i].x + targets[i].w;
+        if (targets[i].y + targets[i].h > y1) y1 = targets[i].y + targets[i].h;
+    }
+    // Too far apart to frame together: the first target stays in view
+    if (x1 - x0 > c->w) {
+        x0 = targets[0].x;
+        x1 = x0 + targets[0].w;
+    }
+    if (y1 - y0 > c->h) {
+        y0 = targets[0].y;
+        y1 = y0 + targets[0].h;
+    }
+    // Low in the view, where the ground was when the world was just the screen
+    c->x = (x0 + x1) / 2 - c->w / 2;
+    c->y = (y0 + y1) / 2 - c->h * 5 / 6;
+    if (c->x > w->width - c->w) c->x = w->width - c->w;
+    if (c->y > w->height - c->h) c->y = w->height - c->h;
+    if (c->x < 0) c->x = 0;
+    if (c->y < 0) c->y = 0;
+}
+
+void free_world(world *w) {
+    for (int i = 0; i < WORLD_CACHE_CHUNKS; i++) {
+        if (w->cache[i].surface) SDL_FreeSurface(w->cache[i].surface);
+        w->cache[i].surface = NULL;
+    }
+    free(w->offsets);
+    free(w->slots);
+    free_collision(&w->solid);
+    if (w->file) fclose(w->file);
+    memset(w, 0, sizeof(*w));
+}
@@ -0,0 +1,52 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include "level.h"
+#include "compose.h"
+#include "collide.h"
+
+#define WORLD_CACHE_CHUNKS 48      // Chunks held decoded and drawn; the view touches at most 20
+#define WORLD_PREFETCH 1           // Chunks past each edge of the view read ahead of the camera
+#define WORLD_PREFETCH_PER_FRAME 2 // So scrolling into a new column never reads it all in one frame
+
+typedef struct {
+    int cx, cy;           // Chunk held, cx is -1 while the slot is free
+    Uint32 used;          // Last frame the view or the prefetch wanted it
+    Uint8 tiles[CHUNK_TILE_COUNT];
+    SDL_Surface* surface; // The tiles drawn once, CHUNK_SIZE square in the target's format
+} world_chunk;
+
+// A level streamed from its file a chunk at a time. Only chunks around the camera are
+// decoded, each into a cached surface, so the background is a few large blits per frame.
+typedef struct {
+    FILE* file;           // NULL for the empty world, which is just the screen
+    int width_chunks, height_chunks;
+    int width, height;    // Pixels
+    Uint32* offsets;      // Of each chunk's runs in the file, one more for the end of the last
+    Sint16* slots;        // Cache slot of each chunk, -1 if not loaded
+    collision_map solid;  // The whole level's, read once at load
+    world_chunk cache[WORLD_CACHE_CHUNKS];
+    Uint32 frame;
+    Uint32 loads;         // Chunks read from the file so far
+    Uint32 evictions;
+} world;
+
+// The part of the world shown on the back buffer
+typedef struct {
+    int x, y; // World position of the view's top left
+    int w, h;
+} camera;
+
+// On failure w is still usable: an empty world the size of target, and -1 is returned.
+// A NULL path asks for that empty world.
+int load_world(world* w, const char* path, SDL_Surface* target);
+int stream_world(world* w, const camera* c); // Once per frame; returns chunks in view that just loaded
+void draw_world(world* w, const camera* c, compositor* out); // Records the visible chunks
+void paint_world(world* w, const camera* c, SDL_Surface* dst); // Draws them straight into dst
+void paint_tile(SDL_Surface* dst, int x, int y, Uint8 tile, int col, int row); // col, row in the level
+void follow_camera(camera* c, const world* w, const SDL_Rect* targets, int count); // Frames the targets
+void free_world(world* w);
+
+#endif